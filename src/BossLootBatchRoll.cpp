@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootBatchRoll.h"
+#include "Random.h"
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace BossLoot;
+
+namespace
+{
+    constexpr uint32 LANES = 4;
+
+    uint64 SplitMix64(uint64& state)
+    {
+        uint64 z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64 Rotl(uint64 x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    // Four xoshiro256** generators, one per lane, with each state word stored lane by lane. The
+    // multiplies by 5 and 9 are shifts and adds, so a lane step maps onto 64-bit vector operations.
+    struct BatchRng
+    {
+        alignas(32) uint64 s0[LANES];
+        alignas(32) uint64 s1[LANES];
+        alignas(32) uint64 s2[LANES];
+        alignas(32) uint64 s3[LANES];
+
+        BatchRng()
+        {
+            uint64 seed = (static_cast<uint64>(rand32()) << 32) | rand32();
+
+            for (uint32 lane = 0; lane < LANES; ++lane)
+            {
+                s0[lane] = SplitMix64(seed);
+                s1[lane] = SplitMix64(seed);
+                s2[lane] = SplitMix64(seed);
+                s3[lane] = SplitMix64(seed);
+            }
+        }
+
+        void Next(uint64* values)
+        {
+            for (uint32 lane = 0; lane < LANES; ++lane)
+            {
+                values[lane] = Rotl(s1[lane] * 5, 7) * 9;
+                uint64 const t = s1[lane] << 17;
+
+                s2[lane] ^= s0[lane];
+                s3[lane] ^= s1[lane];
+                s1[lane] ^= s2[lane];
+                s0[lane] ^= s3[lane];
+                s2[lane] ^= t;
+                s3[lane] = Rotl(s3[lane], 45);
+            }
+        }
+    };
+
+    // Map threads roll concurrently, so each keeps its own generator.
+    BatchRng& GetBatchRng()
+    {
+        thread_local BatchRng rng;
+        return rng;
+    }
+
+#if defined(__AVX2__)
+    template <int K>
+    __m256i Rotl256(__m256i x)
+    {
+        return _mm256_or_si256(_mm256_slli_epi64(x, K), _mm256_srli_epi64(x, 64 - K));
+    }
+
+    __m256i MulAdd256(__m256i x, int shift)
+    {
+        return _mm256_add_epi64(_mm256_slli_epi64(x, shift), x);
+    }
+#endif
+}
+
+namespace BossLoot
+{
+    uint64 GetRollBound(uint32 rollThreshold)
+    {
+        // RollThreshold draws floor(r * ROLL_SCALE / 2^32) + 1 from a 32-bit r and hits when that is
+        // <= rollThreshold, i.e. when r < rollThreshold * 2^32 / ROLL_SCALE, rounded up.
+        if (rollThreshold >= ROLL_SCALE)
+            return uint64(1) << 32;
+
+        return ((static_cast<uint64>(rollThreshold) << 32) + ROLL_SCALE - 1) / ROLL_SCALE;
+    }
+
+    void RollBatch::Roll(uint64 const* bounds, uint32 count)
+    {
+        count = std::min(count, MAX_ROLLS);
+        _hits.fill(0);
+
+        BatchRng& rng = GetBatchRng();
+
+#if defined(__AVX2__)
+        __m256i s0 = _mm256_load_si256(reinterpret_cast<__m256i const*>(rng.s0));
+        __m256i s1 = _mm256_load_si256(reinterpret_cast<__m256i const*>(rng.s1));
+        __m256i s2 = _mm256_load_si256(reinterpret_cast<__m256i const*>(rng.s2));
+        __m256i s3 = _mm256_load_si256(reinterpret_cast<__m256i const*>(rng.s3));
+
+        for (uint32 i = 0; i < count; i += LANES)
+        {
+            __m256i const value = MulAdd256(Rotl256<7>(MulAdd256(s1, 2)), 3);
+            __m256i const t = _mm256_slli_epi64(s1, 17);
+
+            s2 = _mm256_xor_si256(s2, s0);
+            s3 = _mm256_xor_si256(s3, s1);
+            s1 = _mm256_xor_si256(s1, s2);
+            s0 = _mm256_xor_si256(s0, s3);
+            s2 = _mm256_xor_si256(s2, t);
+            s3 = Rotl256<45>(s3);
+
+            // Bounds are at most 2^32, so the signed 64-bit compare is exact. Lanes past count
+            // compare against 0 and never hit.
+            __m256i bound;
+            if (i + LANES <= count)
+                bound = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(bounds + i));
+            else
+            {
+                alignas(32) uint64 tail[LANES] = { };
+                std::copy(bounds + i, bounds + count, tail);
+                bound = _mm256_load_si256(reinterpret_cast<__m256i const*>(tail));
+            }
+
+            __m256i const hit = _mm256_cmpgt_epi64(bound, _mm256_srli_epi64(value, 32));
+            _hits[i / 64] |= static_cast<uint64>(_mm256_movemask_pd(_mm256_castsi256_pd(hit))) << (i % 64);
+        }
+
+        _mm256_store_si256(reinterpret_cast<__m256i*>(rng.s0), s0);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(rng.s1), s1);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(rng.s2), s2);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(rng.s3), s3);
+#else
+        for (uint32 i = 0; i < count; i += LANES)
+        {
+            alignas(32) uint64 values[LANES];
+            rng.Next(values);
+
+            uint32 const lanes = std::min(LANES, count - i);
+            uint64 hits = 0;
+
+            for (uint32 lane = 0; lane < lanes; ++lane)
+                hits |= static_cast<uint64>((values[lane] >> 32) < bounds[i + lane]) << lane;
+
+            _hits[i / 64] |= hits << (i % 64);
+        }
+#endif
+    }
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_BATCHROLL_H
+#define MOD_BOSSLOOT_BATCHROLL_H
+
+#include "BossLootRules.h"
+#include "Define.h"
+
+#include <array>
+
+namespace BossLoot
+{
+    // Roll threshold rescaled for RollBatch: a roll hits when the high 32 bits of a uniform 64-bit
+    // value are below it. The bound is rounded to a multiple of 2^-32, so a hit has the same
+    // probability as RollThreshold(rollThreshold) to within 2^-32 per rule. The random streams
+    // differ, so the two never agree roll for roll.
+    uint64 GetRollBound(uint32 rollThreshold);
+
+    // Every roll of one kill in a single pass. Random values come from four interleaved xoshiro256**
+    // generators per thread, so the generator and the compare vectorize: with AVX2 as explicit
+    // intrinsics, otherwise as plain loops the compiler is free to vectorize for SSE2.
+    class RollBatch
+    {
+    public:
+        static constexpr uint32 MAX_ROLLS = MAX_RULES;
+
+        // Rolls count bounds from GetRollBound; more than MAX_ROLLS is cut to MAX_ROLLS.
+        void Roll(uint64 const* bounds, uint32 count);
+
+        bool Hit(uint32 index) const { return (_hits[index / 64] >> (index % 64)) & 1; }
+
+        // The hits of the first 64 rolls as one word, so they can be kept until the kill; see PreRollStore.
+        uint64 FirstWord() const { return _hits[0]; }
+        void AssignFirstWord(uint64 hits)
+        {
+            _hits.fill(0);
+            _hits[0] = hits;
+        }
+
+    private:
+        std::array<uint64, MAX_ROLLS / 64> _hits{};
+    };
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_EVALUATOR_H
+#define MOD_BOSSLOOT_EVALUATOR_H
+
+#include "BossLootBatchRoll.h"
+#include "BossLootMetrics.h"
+#include "BossLootRules.h"
+#include "BossLootState.h"
+
+namespace BossLoot
+{
+    // The kill loop, shared by the kill hook and the load test. What it touches outside the rule
+    // set goes through a Context, which provides:
+    //
+    //   uint32 MapId() const;
+    //   BossLootRuleStats& Stats(BossLootRule const& rule);
+    //   bool HasCorpseItem(uint32 itemEntry);            gathers the corpse loot on first use
+    //   void SkippedDuplicate(BossLootRule const& rule, uint32 itemEntry);
+    //   bool IsOnceDropped(BossLootRule const& rule);
+    //   bool ReserveOnce(BossLootRule const& rule, uint32 itemEntry); always followed by Inject
+    //   bool RollPity(BossLootRule const& rule);            must not move the counter
+    //   void RecordPityResult(BossLootRule const& rule, bool dropped);
+    //   void Inject(BossLootRule const& rule, uint32 itemEntry);
+    //
+    // Every variant's roll is made up front in one RollBatch; pity rules roll their own instead.
+    //
+    // Variants run in config order, since PreventDuplicate and shared once keys depend on which
+    // rule goes first. Rolls come from the caller, for kills whose rolls were made ahead of time.
+    template <typename Context>
+    void EvaluateRules(Context& context, RuleSet const& ruleSet, RuleVariantList const& list, RollBatch const& rolls)
+    {
+        for (uint32 i = 0; i < list.size(); ++i)
+        {
+            BossLootRule const& rule = ruleSet.rules[list.variants[i].ruleId];
+
+            // Maps cannot be folded into the entry index, so they stay a per-rule check.
+            if (!rule.maps.empty() && !InRanges(rule.maps, context.MapId()))
+                continue;
+
+            BossLootRuleStats& stats = context.Stats(rule);
+            BumpStat(stats.evaluated);
+
+            // Pool rules only know their item after the roll, so they are checked below instead.
+            if (rule.preventDuplicate && !rule.IsPool() && context.HasCorpseItem(rule.itemEntry))
+            {
+                BumpStat(stats.skippedDuplicate);
+                context.SkippedDuplicate(rule, rule.itemEntry);
+                continue;
+            }
+
+            if (!rule.allowRepeat && context.IsOnceDropped(rule))
+            {
+                BumpStat(stats.blockedOnce);
+                continue;
+            }
+
+            // An empty bucket skips the roll, so pity counters do not climb while the quota is spent.
+            if (rule.quotaBucket && !rule.quotaBucket->HasToken())
+            {
+                BumpStat(stats.blockedQuota);
+                continue;
+            }
+
+            BumpStat(stats.rolled);
+
+            bool const hit = rule.HasPity() ? context.RollPity(rule) : rolls.Hit(i);
+            if (!hit)
+            {
+                if (rule.HasPity())
+                    context.RecordPityResult(rule, false);
+
+                continue;
+            }
+
+            uint32 const itemEntry = rule.IsPool() ? rule.pool.Pick() : rule.itemEntry;
+
+            if (rule.preventDuplicate && rule.IsPool() && context.HasCorpseItem(itemEntry))
+            {
+                BumpStat(stats.skippedDuplicate);
+                context.SkippedDuplicate(rule, itemEntry);
+                continue;
+            }
+
+            // One atomic decrement; another kill may have taken the last token since the check above.
+            if (rule.quotaBucket && !rule.quotaBucket->TryTake())
+            {
+                BumpStat(stats.blockedQuota);
+                continue;
+            }
+
+            // Reserve before adding to loot so two simultaneous kills cannot both win the same once rule.
+            if (!rule.allowRepeat && !context.ReserveOnce(rule, itemEntry))
+            {
+                if (rule.quotaBucket)
+                    rule.quotaBucket->Give();
+
+                BumpStat(stats.blockedOnce);
+                continue;
+            }
+
+            BumpStat(stats.hits);
+            context.Inject(rule, itemEntry);
+
+            // Only now is the drop certain; a hit blocked above leaves the counter where it was.
+            if (rule.HasPity())
+                context.RecordPityResult(rule, true);
+        }
+    }
+
+    template <typename Context>
+    void EvaluateRules(Context& context, RuleSet const& ruleSet, RuleVariantList const& list)
+    {
+        RollBatch rolls;
+        rolls.Roll(list.rollBounds.data(), list.size());
+
+        EvaluateRules(context, ruleSet, list, rolls);
+    }
+}
+
+#endif
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootLifecycle.h"
+#include "BossLootMetrics.h"
+#include "BossLootPersistence.h"
+#include "BossLootSharedOnce.h"
+#include "BossLootTemplate.h"
+#include "Chat.h"
+#include "Creature.h"
+#include "GameObject.h"
+#include "Log.h"
+#include "ObjectAccessor.h"
+#include "Player.h"
+#include "WorldSessionMgr.h"
+
+#include <thread>
+
+using namespace BossLoot;
+
+namespace
+{
+    std::string GetLootSourceName(Player* player, ObjectGuid lootGuid, uint32 fallbackNpcEntry)
+    {
+        if (player)
+        {
+            if (lootGuid.IsCreature())
+            {
+                if (Creature* creature = ObjectAccessor::GetCreature(*player, lootGuid))
+                    return creature->GetName();
+            }
+            else if (lootGuid.IsGameObject())
+            {
+                if (GameObject* gameObject = ObjectAccessor::GetGameObject(*player, lootGuid))
+                    return gameObject->GetName();
+            }
+        }
+
+        return GetCreatureName(fallbackNpcEntry);
+    }
+
+    void AnnounceDrop(BossLootRule const& rule, PendingInjectedDrop const& pending, ObjectGuid looterGuid, std::string const& looterName, uint32 count)
+    {
+        ScopedLatencyTimer latency(TIMER_ANNOUNCE);
+
+        // Map threads are idle while the world update runs, so the looter and corpse can be read here.
+        Player* looter = ObjectAccessor::FindConnectedPlayer(looterGuid);
+
+        std::string playerName = looterName.empty() ? std::string("Someone") : looterName;
+        std::string bossName = GetLootSourceName(looter, pending.lootGuid, pending.npcEntry);
+        std::string itemName = GetItemName(pending.itemEntry);
+
+        AnnounceContext context;
+        context.player = playerName;
+        context.boss = bossName;
+        context.item = itemName;
+        context.itemEntry = pending.itemEntry;
+        context.npcEntry = pending.npcEntry;
+        context.count = count;
+
+        std::string const message = RenderAnnounceMessage(rule.announceMessage, context);
+
+        WorldPacket data;
+        ChatHandler::BuildChatPacket(
+            data,
+            CHAT_MSG_SYSTEM,
+            LANG_UNIVERSAL,
+            nullptr,
+            nullptr,
+            message
+        );
+
+        sWorldSessionMgr->SendGlobalMessage(&data);
+        BumpStat(GetRuleStats(rule.index).announced);
+    }
+}
+
+namespace BossLoot
+{
+    bool HasKillStages(BossLootRule const& rule)
+    {
+        return rule.IsOnce(OnceScope::Server) && !IsSharedOnceStateEnabled();
+    }
+
+    bool HasLootStages(BossLootRule const& rule)
+    {
+        return rule.announce || rule.IsOnce(OnceScope::Server);
+    }
+
+    DropLifecycle* DropLifecycle::instance()
+    {
+        static DropLifecycle instance;
+        return &instance;
+    }
+
+    void DropLifecycle::Post(DropEvent event)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+        _events.push_back(std::move(event));
+    }
+
+    void DropLifecycle::Update()
+    {
+        _writes.ProcessReadyCallbacks();
+
+        {
+            std::lock_guard<ContentionMutex> guard(_mutex);
+            _running.swap(_events);
+        }
+
+        for (DropEvent& event : _running)
+            Dispatch(event);
+
+        _running.clear();
+    }
+
+    void DropLifecycle::Drain(std::chrono::milliseconds timeout)
+    {
+        auto const deadline = std::chrono::steady_clock::now() + timeout;
+
+        Update();
+        while (!_tasks.empty() && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            Update();
+        }
+
+        if (!_tasks.empty())
+            LOG_ERROR("module", "[BossLoot] {} once-per-server drop writes were still in flight at shutdown.", _tasks.size());
+    }
+
+    void DropLifecycle::Dispatch(DropEvent& event)
+    {
+        BossLootRule const* rule = event.ruleSet ? event.ruleSet->GetRule(event.drop.ruleId) : nullptr;
+        if (!rule)
+            return;
+
+        switch (event.type)
+        {
+            case DropEventType::Injected:
+            {
+                Task task;
+                task.stage = Stage::PersistingKill;
+                task.drop = event.drop;
+                task.ruleSet = std::move(event.ruleSet);
+                task.playerName = std::move(event.playerName);
+                Resume(std::move(task));
+                break;
+            }
+            case DropEventType::Looted:
+            {
+                // Looted before its kill phase write finished; OnWriteDone picks it up from here.
+                auto itr = _tasks.find(KeyOf(event.drop));
+                if (itr != _tasks.end() && itr->second.stage == Stage::PersistingKill)
+                {
+                    Task& task = itr->second;
+                    task.looted = true;
+                    task.playerGuid = event.playerGuid;
+                    task.playerName = std::move(event.playerName);
+                    task.count = event.count;
+                    break;
+                }
+
+                Task task;
+                task.stage = Stage::Announcing;
+                task.drop = event.drop;
+                task.ruleSet = std::move(event.ruleSet);
+                task.looted = true;
+                task.playerGuid = event.playerGuid;
+                task.playerName = std::move(event.playerName);
+                task.count = event.count;
+                Resume(std::move(task));
+                break;
+            }
+            case DropEventType::Expired:
+                // The corpse is long gone. A once-per-server key stays dropped, as the item did drop.
+                LOG_DEBUG(LOG_FILTER_DROPS, "[BossLoot] Rule {} item {} from {} was never looted; its pending drop expired.",
+                    rule->index, event.drop.itemEntry, event.drop.lootGuid.ToString());
+                break;
+        }
+    }
+
+    void DropLifecycle::Resume(Task task)
+    {
+        TaskKey const key = KeyOf(task.drop);
+
+        for (;;)
+        {
+            BossLootRule const& rule = task.Rule();
+
+            switch (task.stage)
+            {
+                case Stage::PersistingKill:
+                case Stage::PersistingLoot:
+                {
+                    bool const killPhase = task.stage == Stage::PersistingKill;
+                    BossLootTimer const timer = killPhase ? TIMER_DB_KILL_PHASE : TIMER_DB_LOOT_PHASE;
+                    auto const start = std::chrono::steady_clock::now();
+
+                    TransactionCallback callback = killPhase
+                        ? PersistDroppedKillPhase(rule, task.drop, task.playerName)
+                        : PersistDroppedLootPhase(rule, task.drop, task.playerName);
+
+                    // Timed from submit to commit, so the histogram shows how far the database lags.
+                    _writes.AddCallback(std::move(callback)).AfterComplete([this, key, timer, start](bool success)
+                    {
+                        auto const elapsed = std::chrono::steady_clock::now() - start;
+                        RecordLatency(timer, static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+                        OnWriteDone(key, success);
+                    });
+
+                    _tasks[key] = std::move(task);
+                    return;
+                }
+                case Stage::Announcing:
+                    if (rule.announce)
+                        AnnounceDrop(rule, task.drop, task.playerGuid, task.playerName, task.count);
+
+                    task.stage = rule.IsOnce(OnceScope::Server) ? Stage::PersistingLoot : Stage::Done;
+                    break;
+                case Stage::Done:
+                    return;
+            }
+        }
+    }
+
+    void DropLifecycle::OnWriteDone(TaskKey key, bool success)
+    {
+        auto itr = _tasks.find(key);
+        if (itr == _tasks.end())
+            return;
+
+        Task task = std::move(itr->second);
+        _tasks.erase(itr);
+
+        if (!success)
+        {
+            BossLootRule const& rule = task.Rule();
+            LOG_ERROR("module", "[BossLoot] Rule {} once-key '{}': the {} phase write to the world database failed.",
+                rule.index, rule.onceKey, task.stage == Stage::PersistingKill ? "kill" : "loot");
+        }
+
+        // Not looted yet: the drop waits in PendingDropStore for its Looted or Expired event.
+        if (task.stage != Stage::PersistingKill || !task.looted)
+            return;
+
+        task.stage = Stage::Announcing;
+        Resume(std::move(task));
+    }
+}
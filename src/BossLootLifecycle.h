@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_LIFECYCLE_H
+#define MOD_BOSSLOOT_LIFECYCLE_H
+
+#include "AsyncCallbackProcessor.h"
+#include "BossLootMutex.h"
+#include "BossLootRules.h"
+#include "BossLootState.h"
+#include "DatabaseEnv.h"
+#include "ObjectGuid.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace BossLoot
+{
+    enum class DropEventType : uint8
+    {
+        Injected,   // kill hook: the drop is in the corpse
+        Looted,     // loot hook: its pending record was taken
+        Expired     // world update: nobody looted it within BossLoot.PendingDrop.ExpireTime
+    };
+
+    // Carries the rule snapshot the drop was made with, so a reload in between cannot point ruleId
+    // at another rule. Only drops with work left after the kill post events; see HasKillStages and
+    // HasLootStages.
+    struct DropEvent
+    {
+        DropEventType type = DropEventType::Injected;
+        PendingInjectedDrop drop;
+        std::shared_ptr<RuleSet const> ruleSet;
+        ObjectGuid playerGuid;      // killer or looter
+        std::string playerName;     // kept, since the player may be gone by the time the event runs
+        uint32 count = 0;           // stack size looted
+    };
+
+    // Once-per-server rules write the kill phase, unless shared once-state claims write it instead.
+    bool HasKillStages(BossLootRule const& rule);
+
+    // Announcing rules announce and once-per-server rules write the loot phase.
+    bool HasLootStages(BossLootRule const& rule);
+
+    // The life of an injected drop after the kill, as a state machine resumed by events:
+    //
+    //   Injected -> kill phase write -> waits in PendingDropStore -+- Looted -> announce -> loot phase write -> done
+    //                                                              +- Expired -> done
+    //
+    // Hooks only post an event; Update runs the stages on the world thread, and a database write is
+    // committed asynchronously and resumes its drop from the commit callback, so no hook waits on the
+    // database. A drop looted while its kill phase write is still in flight waits for it, so the two
+    // writes to its row cannot be reordered by the database workers. Drops between events are the
+    // plain records in PendingDropStore; only drops waiting on a write are kept here.
+    //
+    // A new stage is a new Stage value and a case in Resume.
+    class DropLifecycle
+    {
+    public:
+        static DropLifecycle* instance();
+
+        // Any thread. One lock and a push into a buffer whose capacity is kept between updates.
+        void Post(DropEvent event);
+
+        // World thread. Resumes drops whose writes have finished, then runs the events posted since.
+        void Update();
+
+        // Shutdown. Keeps updating until every write has finished or the timeout passes.
+        void Drain(std::chrono::milliseconds timeout);
+
+        LockContention GetContention() const { return _mutex.GetContention("gLifecycleMutex"); }
+
+    private:
+        enum class Stage : uint8
+        {
+            PersistingKill,     // kill phase write in flight
+            Announcing,         // looted; announce runs next
+            PersistingLoot,     // loot phase write in flight
+            Done
+        };
+
+        struct Task
+        {
+            Stage stage = Stage::PersistingKill;
+            PendingInjectedDrop drop;
+            std::shared_ptr<RuleSet const> ruleSet;
+            bool looted = false;
+            ObjectGuid playerGuid;      // the killer, then the looter once looted
+            std::string playerName;
+            uint32 count = 0;
+
+            BossLootRule const& Rule() const { return ruleSet->rules[drop.ruleId]; }
+        };
+
+        // A rule injects at most once per corpse, so the corpse and rule name a drop.
+        struct TaskKey
+        {
+            uint64 lootGuid = 0;
+            uint32 ruleId = 0;
+
+            bool operator==(TaskKey const& other) const { return lootGuid == other.lootGuid && ruleId == other.ruleId; }
+        };
+
+        struct TaskKeyHash
+        {
+            std::size_t operator()(TaskKey const& key) const { return std::hash<uint64>()(key.lootGuid * 31 + key.ruleId); }
+        };
+
+        static TaskKey KeyOf(PendingInjectedDrop const& drop) { return { drop.lootGuid.GetRawValue(), drop.ruleId }; }
+
+        void Dispatch(DropEvent& event);
+
+        // Runs stages until the task waits on a write or is done; a waiting task is kept in _tasks.
+        void Resume(Task task);
+        void OnWriteDone(TaskKey key, bool success);
+
+        mutable ContentionMutex _mutex;
+        std::vector<DropEvent> _events;
+
+        // World thread only.
+        std::vector<DropEvent> _running;
+        std::unordered_map<TaskKey, Task, TaskKeyHash> _tasks;
+        AsyncCallbackProcessor<TransactionCallback> _writes;
+    };
+}
+
+#define sBossLootDropLifecycle BossLoot::DropLifecycle::instance()
+
+#endif
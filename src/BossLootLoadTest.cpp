@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootLoadTest.h"
+#include "BossLootEvaluator.h"
+#include "BossLootMetrics.h"
+#include "BossLootRules.h"
+#include "BossLootState.h"
+#include "Log.h"
+#include "ObjectGuid.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace BossLoot;
+
+namespace
+{
+    // Synthetic entries well above anything in a 3.3.5 world database.
+    static constexpr uint32 LOADTEST_BOSS_ENTRY_BASE = 9000000;
+    static constexpr uint32 LOADTEST_TRASH_ENTRY = 9100000;
+    static constexpr uint32 LOADTEST_ITEM_ENTRY_BASE = 9200000;
+    static constexpr uint32 LOADTEST_OTHER_ITEM_ENTRY_BASE = 9300000;
+
+    static std::atomic<bool> gLoadTestRunning{ false };
+    static std::atomic<bool> gLoadTestAbort{ false };
+    static std::thread gLoadTestThread;
+
+    struct LoadTestContext
+    {
+        RuleSetHolder rules;
+        OnceStateStore onceState;
+        PendingDropStore pendingDrops;
+        EvaluatedCorpseSet evaluatedCorpses;
+        std::array<BossLootRuleStats, MAX_RULES + 1> stats; // by rule index, never read
+        std::atomic<bool> go{ false };
+    };
+
+    // EvaluateRules context for a synthetic kill. Rule counters, the once state and the pending
+    // drops are the test's own.
+    class SyntheticKill
+    {
+    public:
+        SyntheticKill(LoadTestContext& context, ObjectGuid corpseGuid, CorpseItemSet& corpseItems)
+            : _context(context), _corpseGuid(corpseGuid), _corpseItems(corpseItems) { }
+
+        uint32 MapId() const { return 0; }
+        BossLootRuleStats& Stats(BossLootRule const& rule) { return _context.stats[rule.index]; }
+        bool HasCorpseItem(uint32 itemEntry) { return _corpseItems.Contains(itemEntry); }
+        void SkippedDuplicate(BossLootRule const& /*rule*/, uint32 /*itemEntry*/) { }
+        bool IsOnceDropped(BossLootRule const& rule) { return _context.onceState.IsDropped(rule.onceKey); }
+        bool ReserveOnce(BossLootRule const& rule, uint32 /*itemEntry*/) { return _context.onceState.Reserve(rule.onceKey); }
+
+        // No characters here, so every kill rolls the first step of the curve.
+        bool RollPity(BossLootRule const& rule) { return RollThreshold(GetPityThreshold(rule.pityCurve[REGULAR_DIFFICULTY], 0)); }
+        void RecordPityResult(BossLootRule const& /*rule*/, bool /*dropped*/) { }
+
+        void Inject(BossLootRule const& rule, uint32 itemEntry)
+        {
+            _corpseItems.Insert(itemEntry);
+
+            PendingInjectedDrop pending;
+            pending.lootGuid = _corpseGuid;
+            pending.ruleId = rule.ruleId;
+            pending.npcEntry = rule.npcEntry;
+            pending.itemEntry = itemEntry;
+            _context.pendingDrops.Remember(pending);
+        }
+
+    private:
+        LoadTestContext& _context;
+        ObjectGuid _corpseGuid;
+        CorpseItemSet& _corpseItems;
+    };
+
+    struct LoadTestWorkerResult
+    {
+        LatencyRecorder killLatency;
+        LatencyRecorder lootLatency;
+        uint64 kills = 0;
+        uint64 loots = 0;
+        uint64 injected = 0;
+    };
+
+    uint32 BossEntryCount(uint32 ruleCount)
+    {
+        return std::max<uint32>(1, ruleCount / 4);
+    }
+
+    // About four rules per boss, chances between 0.5% and 20%, every fifth rule once-per-server
+    // and every other rule with PreventDuplicate, so all branches of the kill loop are exercised.
+    std::vector<BossLootRule> MakeSyntheticRules(uint32 ruleCount)
+    {
+        uint32 const bossCount = BossEntryCount(ruleCount);
+
+        std::vector<BossLootRule> rules;
+        rules.reserve(ruleCount);
+
+        for (uint32 i = 0; i < ruleCount; ++i)
+        {
+            BossLootRule rule;
+            rule.index = i + 1;
+            rule.npcEntry = LOADTEST_BOSS_ENTRY_BASE + i % bossCount;
+            rule.itemEntry = LOADTEST_ITEM_ENTRY_BASE + i;
+            rule.chancePct = 0.5 + static_cast<double>((i * 7) % 196) / 10.0;
+            rule.allowRepeat = (i % 5) != 0;
+            rule.preventDuplicate = (i % 2) == 0;
+
+            if (!rule.allowRepeat)
+                rule.onceKey = Acore::StringFormat("loadtest_rule{}", rule.index);
+
+            rules.push_back(std::move(rule));
+        }
+
+        return rules;
+    }
+
+    uint64 ElapsedNs(std::chrono::steady_clock::time_point start)
+    {
+        return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    // Mirrors OnPlayerCreatureKill and OnPlayerLootItem, minus the database and the announcement.
+    // Synthetic corpses start empty, so the corpse item set needs no gathering.
+    void RunLoadTestWorker(LoadTestContext& context, LoadTestOptions const& options, uint32 threadIndex, LoadTestWorkerResult& result)
+    {
+        uint32 const bossCount = BossEntryCount(options.ruleCount);
+        uint32 lowGuid = threadIndex * options.killsPerThread + 1;
+
+        CorpseItemSet corpseItems;
+
+        while (!context.go.load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+        for (uint32 kill = 0; kill < options.killsPerThread; ++kill)
+        {
+            if (gLoadTestAbort.load(std::memory_order_relaxed))
+                return;
+
+            bool const boss = urand(1, 100) <= options.bossKillPct;
+            uint32 const entry = boss ? LOADTEST_BOSS_ENTRY_BASE + urand(0, bossCount - 1) : LOADTEST_TRASH_ENTRY;
+            ObjectGuid const corpseGuid(HighGuid::Unit, entry, lowGuid++);
+
+            corpseItems.Clear();
+
+            auto const killStart = std::chrono::steady_clock::now();
+
+            std::shared_ptr<RuleSet const> ruleSet = context.rules.Get();
+            RuleVariantList const* variants = ruleSet->FindRules(entry, REGULAR_DIFFICULTY);
+            if (variants && context.evaluatedCorpses.TryMark(corpseGuid))
+            {
+                SyntheticKill killContext(context, corpseGuid, corpseItems);
+                EvaluateRules(killContext, *ruleSet, *variants);
+            }
+
+            result.killLatency.Record(ElapsedNs(killStart));
+            ++result.kills;
+            result.injected += corpseItems.Size();
+
+            // Loot everything the module injected, plus the corpse's ordinary items.
+            PendingInjectedDrop taken;
+            for (uint32 itemEntry : corpseItems)
+            {
+                auto const lootStart = std::chrono::steady_clock::now();
+                if (context.rules.IsEnabled())
+                    context.pendingDrops.Take(corpseGuid, itemEntry, taken);
+
+                result.lootLatency.Record(ElapsedNs(lootStart));
+                ++result.loots;
+            }
+
+            for (uint32 i = 0; i < options.lootsPerKill; ++i)
+            {
+                auto const lootStart = std::chrono::steady_clock::now();
+                if (context.rules.IsEnabled())
+                    context.pendingDrops.Take(corpseGuid, LOADTEST_OTHER_ITEM_ENTRY_BASE + i, taken);
+
+                result.lootLatency.Record(ElapsedNs(lootStart));
+                ++result.loots;
+            }
+        }
+    }
+
+    void LogLatency(uint32 threads, char const* name, LatencySummary const& summary)
+    {
+        auto micros = [](uint64 ns) { return static_cast<double>(ns) / 1000.0; };
+
+        LOG_INFO("module", "[BossLoot] Load test Threads={} {} Count={} p50={:.2f}us p99={:.2f}us p999={:.2f}us max={:.2f}us",
+            threads, name, summary.count, micros(summary.p50Ns), micros(summary.p99Ns), micros(summary.p999Ns), micros(summary.maxNs));
+    }
+
+    void RunLoadTestStep(std::shared_ptr<RuleSet const> const& ruleSet, LoadTestOptions const& options, uint32 threads)
+    {
+        LoadTestContext context;
+        context.rules.Publish(ruleSet);
+        context.evaluatedCorpses.SetWindow(30 * IN_MILLISECONDS);
+
+        std::vector<LoadTestWorkerResult> results(threads);
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+
+        for (uint32 i = 0; i < threads; ++i)
+            workers.emplace_back(RunLoadTestWorker, std::ref(context), std::cref(options), i, std::ref(results[i]));
+
+        auto const start = std::chrono::steady_clock::now();
+        context.go.store(true, std::memory_order_release);
+
+        for (std::thread& worker : workers)
+            worker.join();
+
+        double const elapsedSec = static_cast<double>(ElapsedNs(start)) / 1e9;
+
+        LoadTestWorkerResult total;
+        for (LoadTestWorkerResult const& result : results)
+        {
+            total.killLatency.Merge(result.killLatency);
+            total.lootLatency.Merge(result.lootLatency);
+            total.kills += result.kills;
+            total.loots += result.loots;
+            total.injected += result.injected;
+        }
+
+        double const events = static_cast<double>(total.kills + total.loots);
+
+        LOG_INFO("module", "[BossLoot] Load test Threads={} Kills={} LootEvents={} Injected={} Elapsed={:.3f}s Throughput={:.0f} events/s",
+            threads, total.kills, total.loots, total.injected, elapsedSec, elapsedSec > 0.0 ? events / elapsedSec : 0.0);
+
+        LogLatency(threads, "Kill", total.killLatency.Summarize());
+        LogLatency(threads, "Loot", total.lootLatency.Summarize());
+
+        for (LockContention const& lock : { context.rules.GetContention(), context.onceState.GetContention(), context.pendingDrops.GetContention(),
+            context.evaluatedCorpses.GetContention() })
+        {
+            double const contendedPct = lock.acquired ? (static_cast<double>(lock.contended) * 100.0 / static_cast<double>(lock.acquired)) : 0.0;
+            LOG_INFO("module", "[BossLoot] Load test Threads={} Lock {} Acquired={} Contended={} ({:.3f}%)",
+                threads, lock.name, lock.acquired, lock.contended, contendedPct);
+        }
+    }
+
+    void RunLoadTest(LoadTestOptions options)
+    {
+        std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, MakeSyntheticRules(options.ruleCount), std::time(nullptr));
+
+        LOG_INFO("module", "[BossLoot] Load test started: MaxThreads={} KillsPerThread={} Rules={} Bosses={} BossKillPct={} LootsPerKill={}",
+            options.maxThreads, options.killsPerThread, options.ruleCount, BossEntryCount(options.ruleCount), options.bossKillPct, options.lootsPerKill);
+
+        for (uint32 threads = 1; !gLoadTestAbort.load(std::memory_order_relaxed); threads = std::min(threads * 2, options.maxThreads))
+        {
+            RunLoadTestStep(ruleSet, options, threads);
+
+            if (threads >= options.maxThreads)
+                break;
+        }
+
+        LOG_INFO("module", "[BossLoot] Load test finished{}.", gLoadTestAbort.load(std::memory_order_relaxed) ? " (aborted)" : "");
+        gLoadTestRunning.store(false, std::memory_order_release);
+    }
+}
+
+namespace BossLoot
+{
+    bool StartLoadTest(LoadTestOptions const& options)
+    {
+        bool expected = false;
+        if (!gLoadTestRunning.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+            return false;
+
+        // The previous run has finished (gLoadTestRunning was false), so this join returns at once.
+        if (gLoadTestThread.joinable())
+            gLoadTestThread.join();
+
+        LoadTestOptions sanitized = options;
+        sanitized.maxThreads = std::clamp<uint32>(sanitized.maxThreads, 1, 256);
+        sanitized.killsPerThread = std::max<uint32>(sanitized.killsPerThread, 1);
+        sanitized.ruleCount = std::clamp<uint32>(sanitized.ruleCount, 1, MAX_RULES);
+        sanitized.bossKillPct = std::min<uint32>(sanitized.bossKillPct, 100);
+
+        gLoadTestAbort.store(false, std::memory_order_relaxed);
+        gLoadTestThread = std::thread(RunLoadTest, sanitized);
+        return true;
+    }
+
+    void StopLoadTest()
+    {
+        gLoadTestAbort.store(true, std::memory_order_relaxed);
+
+        if (gLoadTestThread.joinable())
+            gLoadTestThread.join();
+    }
+}
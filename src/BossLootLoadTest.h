@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_LOADTEST_H
+#define MOD_BOSSLOOT_LOADTEST_H
+
+#include "Define.h"
+
+namespace BossLoot
+{
+    // Replays a synthetic kill and loot stream against private copies of the rule snapshot, the
+    // once-state store and the pending drop store, from 1, 2, 4 ... maxThreads threads. Each step
+    // logs throughput, lock contention and kill/loot latency. No database writes are made and the
+    // live module state is never touched.
+    struct LoadTestOptions
+    {
+        uint32 maxThreads = 4;
+        uint32 killsPerThread = 100000;
+        uint32 ruleCount = 32;
+        uint32 bossKillPct = 5;   // share of kills on a creature that has rules, the rest is trash
+        uint32 lootsPerKill = 4;  // extra loot events per kill for items the module did not inject
+    };
+
+    // Runs on a background thread. Returns false if a run is already in progress.
+    bool StartLoadTest(LoadTestOptions const& options);
+
+    // Aborts a running load test and waits for it. Called on shutdown.
+    void StopLoadTest();
+}
+
+#endif
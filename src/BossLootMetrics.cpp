@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootMetrics.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
+#include <mutex>
+
+using namespace BossLoot;
+
+namespace
+{
+    static std::array<BossLootRuleStats, MAX_RULES + 1> gRuleStats;
+
+    static constexpr char const* TIMER_NAMES[MAX_BOSSLOOT_TIMERS] =
+    {
+        "OnPlayerCreatureKill",
+        "OnPlayerLootItem",
+        "AnnounceDrop",
+        "PersistDroppedKillPhase",
+        "PersistDroppedLootPhase",
+        "OnAfterConfigLoad",
+        "FlushScopedOnceWrites",
+        "WritePityCounters",
+        "WriteQuotaStates"
+    };
+
+    // HDR-style log-linear buckets: values below 16ns get one bucket each, every power of two above
+    // that is split into 16 sub-buckets (about 6% resolution). The last bucket absorbs everything
+    // from 2^40ns (roughly 18 minutes) upwards.
+    static constexpr uint32 LATENCY_SUB_BUCKET_BITS = 4;
+    static constexpr uint32 LATENCY_SUB_BUCKETS = 1 << LATENCY_SUB_BUCKET_BITS;
+    static constexpr uint32 LATENCY_MAX_EXPONENT = 40;
+    static constexpr uint32 LATENCY_BUCKETS = (LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS;
+
+    // Only the owning thread writes a histogram, so a relaxed load/store pair is enough to count.
+    // Readers merging from another thread may see a sample or two late, which is fine for a report.
+    struct LatencyHistogram
+    {
+        std::array<std::atomic<uint64>, LATENCY_BUCKETS> buckets{};
+        std::atomic<uint64> sumNs{ 0 };
+        std::atomic<uint64> maxNs{ 0 };
+    };
+
+    struct alignas(64) ThreadLatencyHistograms
+    {
+        std::array<LatencyHistogram, MAX_BOSSLOOT_TIMERS> timers;
+    };
+
+    // Owns one entry per thread that ever ran an instrumented section. Map update threads live as
+    // long as the worldserver, so entries are never released.
+    static std::mutex gLatencyRegistryMutex;
+    static std::vector<std::unique_ptr<ThreadLatencyHistograms>> gLatencyRegistry;
+
+    uint32 LatencyBucketIndex(uint64 ns)
+    {
+        if (ns < LATENCY_SUB_BUCKETS)
+            return static_cast<uint32>(ns);
+
+        uint32 const exponent = 63 - static_cast<uint32>(std::countl_zero(ns));
+        if (exponent >= LATENCY_MAX_EXPONENT)
+            return LATENCY_BUCKETS - 1;
+
+        uint32 const shift = exponent - LATENCY_SUB_BUCKET_BITS;
+        uint32 const subBucket = static_cast<uint32>(ns >> shift) & (LATENCY_SUB_BUCKETS - 1);
+        return (shift + 1) * LATENCY_SUB_BUCKETS + subBucket;
+    }
+
+    uint64 LatencyBucketUpperBound(uint32 index)
+    {
+        if (index < LATENCY_SUB_BUCKETS)
+            return index;
+
+        uint32 const shift = index / LATENCY_SUB_BUCKETS - 1;
+        uint64 const lower = static_cast<uint64>(LATENCY_SUB_BUCKETS + index % LATENCY_SUB_BUCKETS) << shift;
+        return lower + (uint64(1) << shift) - 1;
+    }
+
+    ThreadLatencyHistograms& GetThreadLatencyHistograms()
+    {
+        thread_local ThreadLatencyHistograms* histograms = nullptr;
+
+        if (!histograms)
+        {
+            std::unique_ptr<ThreadLatencyHistograms> owned = std::make_unique<ThreadLatencyHistograms>();
+            histograms = owned.get();
+
+            std::lock_guard<std::mutex> guard(gLatencyRegistryMutex);
+            gLatencyRegistry.push_back(std::move(owned));
+        }
+
+        return *histograms;
+    }
+
+    // Walks merged bucket counts in order and picks the bucket holding each quantile's rank.
+    LatencySummary SummarizeBuckets(uint64 const* merged, uint64 sumNs, uint64 maxNs)
+    {
+        LatencySummary summary;
+        summary.sumNs = sumNs;
+        summary.maxNs = maxNs;
+
+        for (uint32 i = 0; i < LATENCY_BUCKETS; ++i)
+            summary.count += merged[i];
+
+        if (!summary.count)
+            return summary;
+
+        // Ranks are 1-based: p50 of 10 samples is the 5th sample.
+        auto rankFor = [&summary](double quantile)
+        {
+            return std::max<uint64>(1, static_cast<uint64>(quantile * static_cast<double>(summary.count) + 0.5));
+        };
+
+        uint64 const p50Rank = rankFor(0.50);
+        uint64 const p99Rank = rankFor(0.99);
+        uint64 const p999Rank = rankFor(0.999);
+
+        uint64 seen = 0;
+        for (uint32 i = 0; i < LATENCY_BUCKETS; ++i)
+        {
+            if (!merged[i])
+                continue;
+
+            uint64 const before = seen;
+            seen += merged[i];
+            uint64 const value = std::min(LatencyBucketUpperBound(i), summary.maxNs);
+
+            if (before < p50Rank && seen >= p50Rank)
+                summary.p50Ns = value;
+
+            if (before < p99Rank && seen >= p99Rank)
+                summary.p99Ns = value;
+
+            if (before < p999Rank && seen >= p999Rank)
+                summary.p999Ns = value;
+        }
+
+        return summary;
+    }
+}
+
+namespace BossLoot
+{
+    void RecordLatency(BossLootTimer timer, uint64 ns)
+    {
+        LatencyHistogram& histogram = GetThreadLatencyHistograms().timers[timer];
+
+        std::atomic<uint64>& bucket = histogram.buckets[LatencyBucketIndex(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        histogram.sumNs.store(histogram.sumNs.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+
+        if (ns > histogram.maxNs.load(std::memory_order_relaxed))
+            histogram.maxNs.store(ns, std::memory_order_relaxed);
+    }
+
+    LatencySummary SummarizeLatency(BossLootTimer timer)
+    {
+        std::array<uint64, LATENCY_BUCKETS> merged{};
+        uint64 sumNs = 0;
+        uint64 maxNs = 0;
+
+        {
+            std::lock_guard<std::mutex> guard(gLatencyRegistryMutex);
+
+            for (std::unique_ptr<ThreadLatencyHistograms> const& thread : gLatencyRegistry)
+            {
+                LatencyHistogram const& histogram = thread->timers[timer];
+
+                for (uint32 i = 0; i < LATENCY_BUCKETS; ++i)
+                    merged[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+
+                sumNs += histogram.sumNs.load(std::memory_order_relaxed);
+                maxNs = std::max(maxNs, histogram.maxNs.load(std::memory_order_relaxed));
+            }
+        }
+
+        return SummarizeBuckets(merged.data(), sumNs, maxNs);
+    }
+
+    void ResetLatency()
+    {
+        std::lock_guard<std::mutex> guard(gLatencyRegistryMutex);
+
+        for (std::unique_ptr<ThreadLatencyHistograms> const& thread : gLatencyRegistry)
+        {
+            for (LatencyHistogram& histogram : thread->timers)
+            {
+                for (std::atomic<uint64>& bucket : histogram.buckets)
+                    bucket.store(0, std::memory_order_relaxed);
+
+                histogram.sumNs.store(0, std::memory_order_relaxed);
+                histogram.maxNs.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    LatencyRecorder::LatencyRecorder() : _buckets(LATENCY_BUCKETS, 0) { }
+
+    void LatencyRecorder::Record(uint64 ns)
+    {
+        ++_buckets[LatencyBucketIndex(ns)];
+        _sumNs += ns;
+        _maxNs = std::max(_maxNs, ns);
+    }
+
+    void LatencyRecorder::Merge(LatencyRecorder const& other)
+    {
+        for (uint32 i = 0; i < LATENCY_BUCKETS; ++i)
+            _buckets[i] += other._buckets[i];
+
+        _sumNs += other._sumNs;
+        _maxNs = std::max(_maxNs, other._maxNs);
+    }
+
+    LatencySummary LatencyRecorder::Summarize() const
+    {
+        return SummarizeBuckets(_buckets.data(), _sumNs, _maxNs);
+    }
+
+    BossLootRuleStats& GetRuleStats(uint32 ruleIndex)
+    {
+        return gRuleStats[std::min(ruleIndex, MAX_RULES)];
+    }
+
+    void ResetRuleStats()
+    {
+        for (BossLootRuleStats& stats : gRuleStats)
+        {
+            stats.evaluated.store(0, std::memory_order_relaxed);
+            stats.skippedDuplicate.store(0, std::memory_order_relaxed);
+            stats.blockedOnce.store(0, std::memory_order_relaxed);
+            stats.blockedQuota.store(0, std::memory_order_relaxed);
+            stats.rolled.store(0, std::memory_order_relaxed);
+            stats.hits.store(0, std::memory_order_relaxed);
+            stats.announced.store(0, std::memory_order_relaxed);
+            stats.revoked.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    char const* GetTimerName(BossLootTimer timer)
+    {
+        return TIMER_NAMES[timer];
+    }
+
+    std::vector<std::string> BuildLatencySummary()
+    {
+        std::vector<std::string> lines;
+        lines.reserve(MAX_BOSSLOOT_TIMERS);
+
+        auto micros = [](uint64 ns) { return static_cast<double>(ns) / 1000.0; };
+
+        for (uint8 timer = 0; timer < MAX_BOSSLOOT_TIMERS; ++timer)
+        {
+            LatencySummary const summary = SummarizeLatency(BossLootTimer(timer));
+
+            lines.push_back(Acore::StringFormat(
+                "[BossLoot] Latency {} Count={} p50={:.1f}us p99={:.1f}us p999={:.1f}us max={:.1f}us",
+                TIMER_NAMES[timer],
+                summary.count,
+                micros(summary.p50Ns),
+                micros(summary.p99Ns),
+                micros(summary.p999Ns),
+                micros(summary.maxNs)));
+        }
+
+        return lines;
+    }
+}
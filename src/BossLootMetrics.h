@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_METRICS_H
+#define MOD_BOSSLOOT_METRICS_H
+
+#include "BossLootRules.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace BossLoot
+{
+    // Counters are bumped from the map update threads. Relaxed atomics are enough because nobody
+    // synchronizes on them, and one cache line per rule keeps busy rules from sharing lines.
+    struct alignas(64) BossLootRuleStats
+    {
+        std::atomic<uint64> evaluated{ 0 };
+        std::atomic<uint64> skippedDuplicate{ 0 };
+        std::atomic<uint64> blockedOnce{ 0 };
+        std::atomic<uint64> blockedQuota{ 0 };
+        std::atomic<uint64> rolled{ 0 };
+        std::atomic<uint64> hits{ 0 };
+        std::atomic<uint64> announced{ 0 };
+        std::atomic<uint64> revoked{ 0 };
+    };
+
+    inline void BumpStat(std::atomic<uint64>& counter)
+    {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Indexed by BossLootRule::index, which is 1-based and capped at MAX_RULES.
+    BossLootRuleStats& GetRuleStats(uint32 ruleIndex);
+    void ResetRuleStats();
+
+    enum BossLootTimer : uint8
+    {
+        TIMER_KILL_HOOK = 0,
+        TIMER_LOOT_HOOK,
+        TIMER_ANNOUNCE,
+        TIMER_DB_KILL_PHASE,
+        TIMER_DB_LOOT_PHASE,
+        TIMER_CONFIG_LOAD,
+        TIMER_DB_SCOPED_FLUSH,
+        TIMER_DB_PITY_FLUSH,
+        TIMER_DB_QUOTA_FLUSH,
+        MAX_BOSSLOOT_TIMERS
+    };
+
+    void RecordLatency(BossLootTimer timer, uint64 ns);
+
+    // The hook or function a timer measures, as shown in reports.
+    char const* GetTimerName(BossLootTimer timer);
+
+    class ScopedLatencyTimer
+    {
+    public:
+        explicit ScopedLatencyTimer(BossLootTimer timer) : _timer(timer), _start(std::chrono::steady_clock::now()) { }
+
+        ~ScopedLatencyTimer()
+        {
+            auto const elapsed = std::chrono::steady_clock::now() - _start;
+            RecordLatency(_timer, static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+
+        ScopedLatencyTimer(ScopedLatencyTimer const&) = delete;
+        ScopedLatencyTimer& operator=(ScopedLatencyTimer const&) = delete;
+
+    private:
+        BossLootTimer _timer;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    struct LatencySummary
+    {
+        uint64 count = 0;
+        uint64 sumNs = 0;
+        uint64 p50Ns = 0;
+        uint64 p99Ns = 0;
+        uint64 p999Ns = 0;
+        uint64 maxNs = 0;
+    };
+
+    LatencySummary SummarizeLatency(BossLootTimer timer);
+    void ResetLatency();
+
+    // Same buckets as the hook timers, but owned by a single thread and not registered anywhere.
+    // Used by tools that measure their own loops, such as the load test.
+    class LatencyRecorder
+    {
+    public:
+        LatencyRecorder();
+
+        void Record(uint64 ns);
+        void Merge(LatencyRecorder const& other);
+        LatencySummary Summarize() const;
+
+    private:
+        std::vector<uint64> _buckets;
+        uint64 _sumNs = 0;
+        uint64 _maxNs = 0;
+    };
+
+    std::vector<std::string> BuildLatencySummary();
+}
+
+#endif
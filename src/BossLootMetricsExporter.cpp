@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootMetricsExporter.h"
+#include "BossLootLifecycle.h"
+#include "BossLootMetrics.h"
+#include "BossLootPersistence.h"
+#include "BossLootState.h"
+#include "DatabaseEnv.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace BossLoot;
+
+namespace
+{
+    // Metrics exporter. The exporter thread reads only atomics, the latency registry and its own copy
+    // of the rule labels, so it never waits on the mutexes the kill and loot hooks use.
+    struct MetricsRuleLabel
+    {
+        uint32 index = 0;
+        uint32 npcEntry = 0;
+        uint32 itemEntry = 0;
+    };
+
+    static std::mutex gMetricsLabelMutex;
+    static std::vector<MetricsRuleLabel> gMetricsRuleLabels;
+
+    static std::mutex gExporterMutex;
+    static std::condition_variable gExporterCondition;
+    static std::thread gExporterThread;
+    static bool gExporterStop = false;
+
+    std::string BuildPrometheusExposition()
+    {
+        std::vector<MetricsRuleLabel> labels;
+        {
+            std::lock_guard<std::mutex> guard(gMetricsLabelMutex);
+            labels = gMetricsRuleLabels;
+        }
+
+        std::string out;
+        out.reserve(4096 + labels.size() * 1024);
+
+        auto appendRuleCounter = [&](char const* name, char const* help, std::atomic<uint64> BossLootRuleStats::* counter)
+        {
+            out += Acore::StringFormat("# HELP {} {}\n# TYPE {} counter\n", name, help, name);
+
+            for (MetricsRuleLabel const& label : labels)
+            {
+                out += Acore::StringFormat("{}{{rule=\"{}\",npc=\"{}\",item=\"{}\"}} {}\n",
+                    name, label.index, label.npcEntry, label.itemEntry,
+                    (GetRuleStats(label.index).*counter).load(std::memory_order_relaxed));
+            }
+        };
+
+        appendRuleCounter("bossloot_rule_evaluations_total", "Kills of a matching creature that evaluated the rule.", &BossLootRuleStats::evaluated);
+        appendRuleCounter("bossloot_rule_skipped_duplicate_total", "Evaluations skipped because the corpse already had the item.", &BossLootRuleStats::skippedDuplicate);
+        appendRuleCounter("bossloot_rule_blocked_once_total", "Evaluations blocked by once-per-server, -character or -account state.", &BossLootRuleStats::blockedOnce);
+        appendRuleCounter("bossloot_rule_blocked_quota_total", "Evaluations blocked by an empty quota bucket.", &BossLootRuleStats::blockedQuota);
+        appendRuleCounter("bossloot_rule_rolls_total", "Drop chance rolls.", &BossLootRuleStats::rolled);
+        appendRuleCounter("bossloot_rule_hits_total", "Items injected into corpse loot.", &BossLootRuleStats::hits);
+        appendRuleCounter("bossloot_rule_announcements_total", "Global loot announcements sent.", &BossLootRuleStats::announced);
+        appendRuleCounter("bossloot_rule_revoked_total", "Injected items revoked because another worldserver claimed the once-key first.", &BossLootRuleStats::revoked);
+
+        out += Acore::StringFormat("# HELP bossloot_pending_drops Injected items waiting to be looted.\n"
+            "# TYPE bossloot_pending_drops gauge\nbossloot_pending_drops {}\n",
+            sBossLootPendingDrops->Size());
+
+        out += Acore::StringFormat("# HELP bossloot_prerolls Creatures whose rolls were made ahead of their kill.\n"
+            "# TYPE bossloot_prerolls gauge\nbossloot_prerolls {}\n",
+            sBossLootPreRolls->Size());
+
+        out += Acore::StringFormat("# HELP bossloot_scoped_once_characters Online characters with once-per-character and -account state loaded.\n"
+            "# TYPE bossloot_scoped_once_characters gauge\nbossloot_scoped_once_characters {}\n",
+            sBossLootScopedOnce->LoadedCharacters());
+
+        out += Acore::StringFormat("# HELP bossloot_pity_characters Online characters with pity counters loaded.\n"
+            "# TYPE bossloot_pity_characters gauge\nbossloot_pity_characters {}\n",
+            sBossLootPity->LoadedCharacters());
+
+        out += Acore::StringFormat("# HELP bossloot_world_db_async_queue_depth Queued asynchronous world database operations.\n"
+            "# TYPE bossloot_world_db_async_queue_depth gauge\nbossloot_world_db_async_queue_depth {}\n",
+            uint64(WorldDatabase.QueueSize()));
+
+        std::vector<LockContention> const locks = GetLockContention();
+
+        out += "# HELP bossloot_lock_acquisitions_total Acquisitions of the module-wide locks.\n"
+            "# TYPE bossloot_lock_acquisitions_total counter\n";
+
+        for (LockContention const& lock : locks)
+            out += Acore::StringFormat("bossloot_lock_acquisitions_total{{lock=\"{}\"}} {}\n", lock.name, lock.acquired);
+
+        out += "# HELP bossloot_lock_contended_total Acquisitions that found the lock already held.\n"
+            "# TYPE bossloot_lock_contended_total counter\n";
+
+        for (LockContention const& lock : locks)
+            out += Acore::StringFormat("bossloot_lock_contended_total{{lock=\"{}\"}} {}\n", lock.name, lock.contended);
+
+        out += "# HELP bossloot_latency_seconds Time spent in module hooks, persistence and config loading.\n"
+            "# TYPE bossloot_latency_seconds summary\n";
+
+        for (uint8 timer = 0; timer < MAX_BOSSLOOT_TIMERS; ++timer)
+        {
+            LatencySummary const summary = SummarizeLatency(BossLootTimer(timer));
+            auto seconds = [](uint64 ns) { return static_cast<double>(ns) / 1e9; };
+
+            out += Acore::StringFormat("bossloot_latency_seconds{{section=\"{}\",quantile=\"0.5\"}} {:.9f}\n", GetTimerName(BossLootTimer(timer)), seconds(summary.p50Ns));
+            out += Acore::StringFormat("bossloot_latency_seconds{{section=\"{}\",quantile=\"0.99\"}} {:.9f}\n", GetTimerName(BossLootTimer(timer)), seconds(summary.p99Ns));
+            out += Acore::StringFormat("bossloot_latency_seconds{{section=\"{}\",quantile=\"0.999\"}} {:.9f}\n", GetTimerName(BossLootTimer(timer)), seconds(summary.p999Ns));
+            out += Acore::StringFormat("bossloot_latency_seconds{{section=\"{}\",quantile=\"1\"}} {:.9f}\n", GetTimerName(BossLootTimer(timer)), seconds(summary.maxNs));
+            out += Acore::StringFormat("bossloot_latency_seconds_sum{{section=\"{}\"}} {:.9f}\n", GetTimerName(BossLootTimer(timer)), seconds(summary.sumNs));
+            out += Acore::StringFormat("bossloot_latency_seconds_count{{section=\"{}\"}} {}\n", GetTimerName(BossLootTimer(timer)), summary.count);
+        }
+
+        return out;
+    }
+
+    bool WriteMetricsFile(std::string const& path)
+    {
+        // Write next to the target and rename, so the collector never reads a half-written file.
+        std::string const tmpPath = path + ".tmp";
+
+        {
+            std::ofstream file(tmpPath, std::ios::out | std::ios::trunc);
+            if (!file)
+                return false;
+
+            file << BuildPrometheusExposition();
+            if (!file)
+                return false;
+        }
+
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+}
+
+namespace BossLoot
+{
+    std::vector<LockContention> GetLockContention()
+    {
+        return
+        {
+            GetRuleSetHolder().GetContention(),
+            sBossLootOnceState->GetContention(),
+            sBossLootPendingDrops->GetContention(),
+            sBossLootPreRolls->GetContention(),
+            sBossLootEvaluatedCorpses->GetContention(),
+            sBossLootScopedOnce->GetContention(),
+            sBossLootPity->GetContention(),
+            sBossLootQuota->GetContention(),
+            sBossLootDropLifecycle->GetContention(),
+            GetDbLockContention()
+        };
+    }
+
+    std::vector<std::string> BuildStatsSummary()
+    {
+        std::shared_ptr<RuleSet const> ruleSet = GetRuleSet();
+
+        std::vector<std::string> lines;
+        lines.reserve(ruleSet->rules.size() + 1);
+        lines.push_back(Acore::StringFormat("[BossLoot] Stats: Enable={} Rules={}", uint32(ruleSet->enabled), uint32(ruleSet->rules.size())));
+
+        for (BossLootRule const& rule : ruleSet->rules)
+        {
+            BossLootRuleStats const& stats = GetRuleStats(rule.index);
+            uint64 const rolled = stats.rolled.load(std::memory_order_relaxed);
+            uint64 const hits = stats.hits.load(std::memory_order_relaxed);
+            double const observedPct = rolled ? (static_cast<double>(hits) * 100.0 / static_cast<double>(rolled)) : 0.0;
+
+            lines.push_back(Acore::StringFormat(
+                "[BossLoot] Rule {} NPC={} Item={} Chance={:.4f}% Evaluated={} SkippedDuplicate={} BlockedOnce={} BlockedQuota={} Rolled={} Hits={} Observed={:.4f}% Announced={} Revoked={}",
+                rule.index,
+                rule.npcEntry,
+                rule.itemEntry,
+                rule.chancePct,
+                stats.evaluated.load(std::memory_order_relaxed),
+                stats.skippedDuplicate.load(std::memory_order_relaxed),
+                stats.blockedOnce.load(std::memory_order_relaxed),
+                stats.blockedQuota.load(std::memory_order_relaxed),
+                rolled,
+                hits,
+                observedPct,
+                stats.announced.load(std::memory_order_relaxed),
+                stats.revoked.load(std::memory_order_relaxed)));
+        }
+
+        for (LockContention const& lock : GetLockContention())
+        {
+            double const contendedPct = lock.acquired ? (static_cast<double>(lock.contended) * 100.0 / static_cast<double>(lock.acquired)) : 0.0;
+            lines.push_back(Acore::StringFormat("[BossLoot] Lock {} Acquired={} Contended={} ({:.3f}%)",
+                lock.name, lock.acquired, lock.contended, contendedPct));
+        }
+
+        return lines;
+    }
+
+    void SetMetricsRuleLabels(std::vector<BossLootRule> const& rules)
+    {
+        std::vector<MetricsRuleLabel> labels;
+        labels.reserve(rules.size());
+
+        for (BossLootRule const& rule : rules)
+            labels.push_back({ rule.index, rule.npcEntry, rule.itemEntry });
+
+        std::lock_guard<std::mutex> guard(gMetricsLabelMutex);
+        gMetricsRuleLabels = std::move(labels);
+    }
+
+    void StopMetricsExporter()
+    {
+        {
+            std::lock_guard<std::mutex> guard(gExporterMutex);
+            gExporterStop = true;
+        }
+
+        gExporterCondition.notify_all();
+
+        if (gExporterThread.joinable())
+            gExporterThread.join();
+    }
+
+    void StartMetricsExporter(std::string const& path, uint32 intervalSeconds)
+    {
+        StopMetricsExporter();
+
+        if (path.empty())
+            return;
+
+        {
+            std::lock_guard<std::mutex> guard(gExporterMutex);
+            gExporterStop = false;
+        }
+
+        std::chrono::seconds const interval(std::max<uint32>(intervalSeconds, 1));
+
+        gExporterThread = std::thread([path, interval]()
+        {
+            bool lastWriteFailed = false;
+
+            std::unique_lock<std::mutex> lock(gExporterMutex);
+            while (!gExporterStop)
+            {
+                lock.unlock();
+                bool const written = WriteMetricsFile(path);
+                lock.lock();
+
+                // Log the first failure only, a bad path would otherwise flood the log every interval.
+                if (!written && !lastWriteFailed)
+                    LOG_ERROR("module", "[BossLoot] Could not write metrics file '{}'.", path);
+
+                lastWriteFailed = !written;
+                gExporterCondition.wait_for(lock, interval, []() { return gExporterStop; });
+            }
+        });
+
+        LOG_INFO("module", "[BossLoot] Writing metrics to '{}' every {}s.", path, uint32(interval.count()));
+    }
+}
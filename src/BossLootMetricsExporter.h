@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_METRICSEXPORTER_H
+#define MOD_BOSSLOOT_METRICSEXPORTER_H
+
+#include "BossLootMutex.h"
+#include "BossLootRules.h"
+
+#include <string>
+#include <vector>
+
+namespace BossLoot
+{
+    // Reports over the whole module. Kept out of BossLootMetrics, which the kill loop uses, since
+    // these also read the drop lifecycle and the database queue.
+
+    // Contention counters of every module-wide lock.
+    std::vector<LockContention> GetLockContention();
+
+    std::vector<std::string> BuildStatsSummary();
+
+    void SetMetricsRuleLabels(std::vector<BossLootRule> const& rules);
+    void StartMetricsExporter(std::string const& path, uint32 intervalSeconds);
+    void StopMetricsExporter();
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_MUTEX_H
+#define MOD_BOSSLOOT_MUTEX_H
+
+#include "Define.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace BossLoot
+{
+    struct LockContention
+    {
+        char const* name = "";
+        uint64 acquired = 0;
+        uint64 contended = 0;
+    };
+
+    // std::mutex that counts how often lock() found it already held. The uncontended path adds one
+    // try_lock and a store to a line the mutex has just pulled in, so it is cheap enough to leave on.
+    class ContentionMutex
+    {
+    public:
+        void lock()
+        {
+            if (!_mutex.try_lock())
+            {
+                _contended.fetch_add(1, std::memory_order_relaxed);
+                _mutex.lock();
+            }
+
+            // Only the lock holder writes this counter.
+            _acquired.store(_acquired.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        void unlock() { _mutex.unlock(); }
+
+        LockContention GetContention(char const* name) const
+        {
+            return { name, _acquired.load(std::memory_order_relaxed), _contended.load(std::memory_order_relaxed) };
+        }
+
+    private:
+        std::mutex _mutex;
+        std::atomic<uint64> _acquired{ 0 };
+        std::atomic<uint64> _contended{ 0 };
+    };
+}
+
+#endif
@@ -0,0 +1,548 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootPersistence.h"
+#include "BossLootMetrics.h"
+#include "BossLootMutex.h"
+#include "BossLootTemplate.h"
+#include "DatabaseEnv.h"
+#include "Log.h"
+#include "Player.h"
+#include "Timer.h"
+#include "WorldSession.h"
+
+#include <ctime>
+
+using namespace BossLoot;
+
+namespace
+{
+    static constexpr char const* TABLE_NAME = "mod_configurable_boss_loot_once";
+    static constexpr char const* LEGACY_TABLE_NAME = "mod_geddon_once_drop";
+    static constexpr char const* CHARACTER_TABLE_NAME = "mod_configurable_boss_loot_once_character";
+    static constexpr char const* ACCOUNT_TABLE_NAME = "mod_configurable_boss_loot_once_account";
+    static constexpr char const* PITY_TABLE_NAME = "mod_configurable_boss_loot_pity";
+    static constexpr char const* QUOTA_TABLE_NAME = "mod_configurable_boss_loot_quota";
+
+    // Downtime longer than this is not scanned minute by minute; the bucket is simply refilled.
+    static constexpr std::time_t QUOTA_CATCH_UP_LIMIT = 35 * DAY;
+
+    static ContentionMutex gDbMutex;
+
+    // Kill and loot phase writes are committed asynchronously; the drop lifecycle resumes the drop
+    // from the returned callback. Queueing takes no gDbMutex: the lock would not order the writes,
+    // and the lifecycle already waits for a row's kill phase callback before its loot phase write.
+    TransactionCallback CommitDropWrite(std::string const& sql)
+    {
+        WorldDatabaseTransaction trans = WorldDatabase.BeginTransaction();
+        trans->Append(sql.c_str());
+        return WorldDatabase.AsyncCommitTransaction(trans);
+    }
+
+    // Refills that came due while the server was down.
+    uint32 RefillsDueSince(CronSchedule const& schedule, std::time_t lastRefill, std::time_t now)
+    {
+        if (!lastRefill || now - lastRefill > QUOTA_CATCH_UP_LIMIT)
+            return 1;
+
+        return schedule.CountMatches(lastRefill, now);
+    }
+}
+
+namespace BossLoot
+{
+    void EnsureTable()
+    {
+        std::lock_guard<ContentionMutex> guard(gDbMutex);
+
+        WorldDatabase.DirectExecute(
+            "CREATE TABLE IF NOT EXISTS `mod_configurable_boss_loot_once` ("
+            "  `keyname`        VARCHAR(191)     NOT NULL,"
+            "  `dropped`        TINYINT(1)       NOT NULL DEFAULT 0,"
+            "  `last_drop_time` BIGINT UNSIGNED  NOT NULL DEFAULT 0,"
+            "  `last_killer`    VARCHAR(64)               DEFAULT NULL,"
+            "  `last_looter`    VARCHAR(64)               DEFAULT NULL,"
+            "  `npc_entry`      INT UNSIGNED     NOT NULL DEFAULT 0,"
+            "  `item_entry`     INT UNSIGNED     NOT NULL DEFAULT 0,"
+            "  `claim_token`    VARCHAR(64)               DEFAULT NULL,"
+            "  PRIMARY KEY (`keyname`)"
+            ") ENGINE=InnoDB DEFAULT CHARSET=utf8"
+        );
+
+        // Tables created before shared once-state have no claim column.
+        if (!WorldDatabase.Query(Acore::StringFormat("SHOW COLUMNS FROM `{}` LIKE 'claim_token'", TABLE_NAME).c_str()))
+            WorldDatabase.DirectExecute(
+                Acore::StringFormat("ALTER TABLE `{}` ADD COLUMN `claim_token` VARCHAR(64) DEFAULT NULL", TABLE_NAME).c_str());
+    }
+
+    void EnsureRowsForRules(std::vector<BossLootRule> const& rules)
+    {
+        std::lock_guard<ContentionMutex> guard(gDbMutex);
+
+        for (BossLootRule const& rule : rules)
+        {
+            if (!rule.enable || !rule.IsOnce(OnceScope::Server))
+                continue;
+
+            std::string const key = SqlSafe(rule.onceKey, 191);
+
+            WorldDatabase.DirectExecute(
+                Acore::StringFormat(
+                    "INSERT IGNORE INTO `{}` (`keyname`, `dropped`, `last_drop_time`, `last_killer`, `last_looter`, `npc_entry`, `item_entry`) "
+                    "VALUES ('{}', 0, 0, NULL, NULL, {}, {})",
+                    TABLE_NAME, key, rule.npcEntry, rule.itemEntry
+                ).c_str()
+            );
+
+            // A pool rule has no fixed item; keep whichever item the kill phase recorded.
+            if (rule.IsPool())
+            {
+                WorldDatabase.DirectExecute(
+                    Acore::StringFormat(
+                        "UPDATE `{}` SET `npc_entry`={} WHERE `keyname`='{}'",
+                        TABLE_NAME, rule.npcEntry, key
+                    ).c_str()
+                );
+                continue;
+            }
+
+            WorldDatabase.DirectExecute(
+                Acore::StringFormat(
+                    "UPDATE `{}` SET `npc_entry`={}, `item_entry`={} WHERE `keyname`='{}'",
+                    TABLE_NAME, rule.npcEntry, rule.itemEntry, key
+                ).c_str()
+            );
+        }
+    }
+
+    void ResetStatesForRules(std::vector<BossLootRule> const& rules, bool resetAll)
+    {
+        std::lock_guard<ContentionMutex> guard(gDbMutex);
+
+        for (BossLootRule const& rule : rules)
+        {
+            if (!rule.enable || !rule.IsOnce(OnceScope::Server))
+                continue;
+
+            if (!resetAll && !rule.resetOnStart)
+                continue;
+
+            std::string const key = SqlSafe(rule.onceKey, 191);
+
+            WorldDatabase.DirectExecute(
+                Acore::StringFormat(
+                    "UPDATE `{}` SET `dropped`=0, `last_drop_time`=0, `last_killer`=NULL, `last_looter`=NULL, `claim_token`=NULL WHERE `keyname`='{}'",
+                    TABLE_NAME, key
+                ).c_str()
+            );
+
+            sBossLootOnceState->Set(rule.onceKey, false);
+
+            LOG_INFO("module", "[BossLoot] ResetOnStartup cleared once-drop state for key '{}'.", rule.onceKey);
+        }
+    }
+
+    void MigrateLegacyGeddonStateIfNeeded(std::vector<BossLootRule> const& rules)
+    {
+        bool hasLegacyKeyRule = false;
+        for (BossLootRule const& rule : rules)
+        {
+            if (rule.enable && !rule.allowRepeat && rule.onceKey == LEGACY_KEY_NAME)
+            {
+                hasLegacyKeyRule = true;
+                break;
+            }
+        }
+
+        if (!hasLegacyKeyRule)
+            return;
+
+        QueryResult tableExists = WorldDatabase.Query(Acore::StringFormat("SHOW TABLES LIKE '{}'", LEGACY_TABLE_NAME).c_str());
+        if (!tableExists)
+            return;
+
+        QueryResult legacyState = WorldDatabase.Query(
+            Acore::StringFormat("SELECT `dropped`, `last_drop_time`, `last_killer` FROM `{}` WHERE `keyname`='{}' LIMIT 1", LEGACY_TABLE_NAME, LEGACY_KEY_NAME).c_str());
+
+        if (!legacyState)
+            return;
+
+        Field* fields = legacyState->Fetch();
+        bool const dropped = fields[0].Get<uint8>() != 0;
+        if (!dropped)
+            return;
+
+        uint64 const lastDropTime = fields[1].Get<uint64>();
+        std::string lastKiller;
+        if (!fields[2].IsNull())
+            lastKiller = SqlSafe(fields[2].Get<std::string>(), 64);
+
+        std::lock_guard<ContentionMutex> guard(gDbMutex);
+
+        if (lastKiller.empty())
+        {
+            WorldDatabase.DirectExecute(
+                Acore::StringFormat(
+                    "UPDATE `{}` SET `dropped`=1, `last_drop_time`={} WHERE `keyname`='{}' AND `dropped`=0",
+                    TABLE_NAME, lastDropTime, LEGACY_KEY_NAME
+                ).c_str()
+            );
+        }
+        else
+        {
+            WorldDatabase.DirectExecute(
+                Acore::StringFormat(
+                    "UPDATE `{}` SET `dropped`=1, `last_drop_time`={}, `last_killer`='{}' WHERE `keyname`='{}' AND `dropped`=0",
+                    TABLE_NAME, lastDropTime, lastKiller, LEGACY_KEY_NAME
+                ).c_str()
+            );
+        }
+    }
+
+    std::unordered_map<std::string, bool> LoadDroppedStatesForRules(std::vector<BossLootRule> const& rules)
+    {
+        std::unordered_map<std::string, bool> states;
+
+        std::lock_guard<ContentionMutex> guard(gDbMutex);
+
+        for (BossLootRule const& rule : rules)
+        {
+            if (!rule.enable || !rule.IsOnce(OnceScope::Server))
+                continue;
+
+            std::string const key = SqlSafe(rule.onceKey, 191);
+            bool dropped = false;
+
+            if (QueryResult result = WorldDatabase.Query(
+                Acore::StringFormat("SELECT `dropped` FROM `{}` WHERE `keyname`='{}' LIMIT 1", TABLE_NAME, key).c_str()))
+            {
+                Field* fields = result->Fetch();
+                dropped = fields[0].Get<uint8>() != 0;
+            }
+
+            states[rule.onceKey] = dropped;
+        }
+
+        return states;
+    }
+
+    TransactionCallback PersistDroppedKillPhase(BossLootRule const& rule, PendingInjectedDrop const& pending, std::string const& killerName)
+    {
+        uint64 const now = static_cast<uint64>(std::time(nullptr));
+        std::string const killer = SqlSafe(killerName, 64);
+        std::string const key = SqlSafe(rule.onceKey, 191);
+
+        if (killer.empty())
+        {
+            return CommitDropWrite(
+                Acore::StringFormat(
+                    "UPDATE `{}` SET `dropped`=1, `last_drop_time`={}, `last_killer`=NULL, `npc_entry`={}, `item_entry`={} WHERE `keyname`='{}'",
+                    TABLE_NAME, now, pending.npcEntry, pending.itemEntry, key
+                )
+            );
+        }
+
+        return CommitDropWrite(
+            Acore::StringFormat(
+                "UPDATE `{}` SET `dropped`=1, `last_drop_time`={}, `last_killer`='{}', `npc_entry`={}, `item_entry`={} WHERE `keyname`='{}'",
+                TABLE_NAME, now, killer, pending.npcEntry, pending.itemEntry, key
+            )
+        );
+    }
+
+    LockContention GetDbLockContention()
+    {
+        return gDbMutex.GetContention("gDbMutex");
+    }
+
+    TransactionCallback PersistDroppedLootPhase(BossLootRule const& rule, PendingInjectedDrop const& pending, std::string const& looterName)
+    {
+        uint64 const now = static_cast<uint64>(std::time(nullptr));
+        std::string const looter = SqlSafe(looterName, 64);
+        std::string const key = SqlSafe(rule.onceKey, 191);
+
+        return CommitDropWrite(
+            Acore::StringFormat(
+                "UPDATE `{}` SET `last_drop_time`={}, `last_looter`='{}', `npc_entry`={}, `item_entry`={} WHERE `keyname`='{}'",
+                TABLE_NAME, now, looter, pending.npcEntry, pending.itemEntry, key
+            )
+        );
+    }
+
+    void EnsureScopedOnceTables()
+    {
+        std::lock_guard<ContentionMutex> guard(gDbMutex);
+
+        CharacterDatabase.DirectExecute(
+            "CREATE TABLE IF NOT EXISTS `mod_configurable_boss_loot_once_character` ("
+            "  `guid`           INT UNSIGNED     NOT NULL,"
+            "  `keyname`        VARCHAR(191)     NOT NULL,"
+            "  `drop_time`      BIGINT UNSIGNED  NOT NULL DEFAULT 0,"
+            "  PRIMARY KEY (`guid`, `keyname`)"
+            ") ENGINE=InnoDB DEFAULT CHARSET=utf8"
+        );
+
+        CharacterDatabase.DirectExecute(
+            "CREATE TABLE IF NOT EXISTS `mod_configurable_boss_loot_once_account` ("
+            "  `account`        INT UNSIGNED     NOT NULL,"
+            "  `keyname`        VARCHAR(191)     NOT NULL,"
+            "  `drop_time`      BIGINT UNSIGNED  NOT NULL DEFAULT 0,"
+            "  PRIMARY KEY (`account`, `keyname`)"
+            ") ENGINE=InnoDB DEFAULT CHARSET=utf8"
+        );
+    }
+
+    void ResetScopedOnceForRules(std::vector<BossLootRule> const& rules, bool resetAll)
+    {
+        std::lock_guard<ContentionMutex> guard(gDbMutex);
+
+        for (BossLootRule const& rule : rules)
+        {
+            if (!rule.enable || !(rule.IsOnce(OnceScope::Character) || rule.IsOnce(OnceScope::Account)))
+                continue;
+
+            if (!resetAll && !rule.resetOnStart)
+                continue;
+
+            std::string const key = SqlSafe(rule.onceKey, 191);
+            char const* table = rule.onceScope == OnceScope::Character ? CHARACTER_TABLE_NAME : ACCOUNT_TABLE_NAME;
+
+            CharacterDatabase.DirectExecute(
+                Acore::StringFormat("DELETE FROM `{}` WHERE `keyname`='{}'", table, key).c_str());
+
+            LOG_INFO("module", "[BossLoot] ResetOnStartup cleared every {} once-drop for key '{}'.",
+                rule.onceScope == OnceScope::Character ? "character" : "account", rule.onceKey);
+        }
+    }
+
+    void LoadScopedOnceAsync(Player* player)
+    {
+        WorldSession* session = player->GetSession();
+        uint32 const characterId = player->GetGUID().GetCounter();
+        uint32 const accountId = session->GetAccountId();
+
+        sBossLootScopedOnce->BeginLoad(characterId, accountId);
+
+        session->GetQueryProcessor().AddCallback(CharacterDatabase.AsyncQuery(
+            Acore::StringFormat(
+                "SELECT 0, `keyname` FROM `{}` WHERE `guid`={} "
+                "UNION ALL SELECT 1, `keyname` FROM `{}` WHERE `account`={}",
+                CHARACTER_TABLE_NAME, characterId, ACCOUNT_TABLE_NAME, accountId
+            )).WithCallback([characterId](QueryResult result)
+            {
+                std::vector<std::string> characterKeys;
+                std::vector<std::string> accountKeys;
+
+                if (result)
+                {
+                    do
+                    {
+                        Field* fields = result->Fetch();
+                        (fields[0].Get<uint8>() ? accountKeys : characterKeys).push_back(fields[1].Get<std::string>());
+                    } while (result->NextRow());
+                }
+
+                sBossLootScopedOnce->Load(characterId, characterKeys, accountKeys);
+            }));
+    }
+
+    void FlushScopedOnceWrites(bool direct)
+    {
+        std::vector<ScopedOnceWrite> const writes = sBossLootScopedOnce->TakeWrites();
+        if (writes.empty())
+            return;
+
+        uint64 const now = static_cast<uint64>(std::time(nullptr));
+
+        // One multi-row INSERT per table; a row that already exists is an earlier drop, so keep it.
+        std::string characterValues;
+        std::string accountValues;
+
+        for (ScopedOnceWrite const& write : writes)
+        {
+            std::string& values = write.scope == OnceScope::Character ? characterValues : accountValues;
+            if (!values.empty())
+                values += ", ";
+
+            values += Acore::StringFormat("({}, '{}', {})", write.ownerId, SqlSafe(write.onceKey, 191), now);
+        }
+
+        CharacterDatabaseTransaction trans = CharacterDatabase.BeginTransaction();
+
+        if (!characterValues.empty())
+            trans->Append(Acore::StringFormat("INSERT IGNORE INTO `{}` (`guid`, `keyname`, `drop_time`) VALUES {}",
+                CHARACTER_TABLE_NAME, characterValues).c_str());
+
+        if (!accountValues.empty())
+            trans->Append(Acore::StringFormat("INSERT IGNORE INTO `{}` (`account`, `keyname`, `drop_time`) VALUES {}",
+                ACCOUNT_TABLE_NAME, accountValues).c_str());
+
+        ScopedLatencyTimer latency(TIMER_DB_SCOPED_FLUSH);
+
+        if (direct)
+            CharacterDatabase.DirectCommitTransaction(trans);
+        else
+            CharacterDatabase.CommitTransaction(trans);
+    }
+
+    void EnsurePityTable()
+    {
+        std::lock_guard<ContentionMutex> guard(gDbMutex);
+
+        CharacterDatabase.DirectExecute(
+            "CREATE TABLE IF NOT EXISTS `mod_configurable_boss_loot_pity` ("
+            "  `guid`           INT UNSIGNED     NOT NULL,"
+            "  `keyname`        VARCHAR(191)     NOT NULL,"
+            "  `misses`         INT UNSIGNED     NOT NULL DEFAULT 0,"
+            "  PRIMARY KEY (`guid`, `keyname`)"
+            ") ENGINE=InnoDB DEFAULT CHARSET=utf8"
+        );
+    }
+
+    void LoadPityAsync(Player* player)
+    {
+        uint32 const characterId = player->GetGUID().GetCounter();
+
+        sBossLootPity->BeginLoad(characterId);
+
+        player->GetSession()->GetQueryProcessor().AddCallback(CharacterDatabase.AsyncQuery(
+            Acore::StringFormat("SELECT `keyname`, `misses` FROM `{}` WHERE `guid`={}", PITY_TABLE_NAME, characterId)
+            ).WithCallback([characterId](QueryResult result)
+            {
+                std::vector<std::pair<std::string, uint32>> counters;
+
+                if (result)
+                {
+                    do
+                    {
+                        Field* fields = result->Fetch();
+                        counters.emplace_back(fields[0].Get<std::string>(), fields[1].Get<uint32>());
+                    } while (result->NextRow());
+                }
+
+                sBossLootPity->Load(characterId, counters);
+            }));
+    }
+
+    void WritePityCounters(std::vector<PityWrite> const& writes, bool direct)
+    {
+        if (writes.empty())
+            return;
+
+        std::string upserts;
+        std::string deletes;
+
+        for (PityWrite const& write : writes)
+        {
+            std::string const key = SqlSafe(write.pityKey, 191);
+            std::string& values = write.misses ? upserts : deletes;
+            if (!values.empty())
+                values += ", ";
+
+            if (write.misses)
+                values += Acore::StringFormat("({}, '{}', {})", write.characterId, key, write.misses);
+            else
+                values += Acore::StringFormat("({}, '{}')", write.characterId, key);
+        }
+
+        CharacterDatabaseTransaction trans = CharacterDatabase.BeginTransaction();
+
+        if (!upserts.empty())
+            trans->Append(Acore::StringFormat("INSERT INTO `{}` (`guid`, `keyname`, `misses`) VALUES {} "
+                "ON DUPLICATE KEY UPDATE `misses`=VALUES(`misses`)", PITY_TABLE_NAME, upserts).c_str());
+
+        if (!deletes.empty())
+            trans->Append(Acore::StringFormat("DELETE FROM `{}` WHERE (`guid`, `keyname`) IN ({})",
+                PITY_TABLE_NAME, deletes).c_str());
+
+        ScopedLatencyTimer latency(TIMER_DB_PITY_FLUSH);
+
+        if (direct)
+            CharacterDatabase.DirectCommitTransaction(trans);
+        else
+            CharacterDatabase.CommitTransaction(trans);
+    }
+
+    void EnsureQuotaTable()
+    {
+        std::lock_guard<ContentionMutex> guard(gDbMutex);
+
+        WorldDatabase.DirectExecute(
+            "CREATE TABLE IF NOT EXISTS `mod_configurable_boss_loot_quota` ("
+            "  `keyname`        VARCHAR(191)     NOT NULL,"
+            "  `tokens`         INT UNSIGNED     NOT NULL DEFAULT 0,"
+            "  `capacity`       INT UNSIGNED     NOT NULL DEFAULT 0,"
+            "  `last_refill`    BIGINT UNSIGNED  NOT NULL DEFAULT 0,"
+            "  PRIMARY KEY (`keyname`)"
+            ") ENGINE=InnoDB DEFAULT CHARSET=utf8"
+        );
+    }
+
+    void LoadQuotaBuckets(std::vector<BossLootRule>& rules, std::time_t now)
+    {
+        for (BossLootRule& rule : rules)
+        {
+            if (!rule.enable || !rule.HasQuota())
+                continue;
+
+            rule.quotaBucket = sBossLootQuota->Bind(rule.quotaKey, rule.quota);
+
+            // A reload keeps the live bucket; memory is newer than the last batch written.
+            if (rule.quotaBucket->loaded)
+                continue;
+
+            int32 tokens = int32(rule.quota);
+            std::time_t lastRefill = 0;
+
+            {
+                std::lock_guard<ContentionMutex> guard(gDbMutex);
+
+                if (QueryResult result = WorldDatabase.Query(
+                    Acore::StringFormat("SELECT `tokens`, `last_refill` FROM `{}` WHERE `keyname`='{}' LIMIT 1",
+                        QUOTA_TABLE_NAME, SqlSafe(rule.quotaKey, 191)).c_str()))
+                {
+                    Field* fields = result->Fetch();
+                    tokens = static_cast<int32>(fields[0].Get<uint32>());
+                    lastRefill = static_cast<std::time_t>(fields[1].Get<uint64>());
+                }
+            }
+
+            sBossLootQuota->Restore(*rule.quotaBucket, tokens, lastRefill);
+
+            if (uint32 const periods = RefillsDueSince(rule.quotaRefill, lastRefill, now))
+            {
+                sBossLootQuota->Refill(*rule.quotaBucket, now);
+                LOG_INFO("module", "[BossLoot] Quota '{}' refilled to {} at load ({} refills due).", rule.quotaKey, rule.quota, periods);
+            }
+        }
+    }
+
+    void WriteQuotaStates(std::vector<QuotaWrite> const& writes, bool direct)
+    {
+        if (writes.empty())
+            return;
+
+        std::string values;
+        for (QuotaWrite const& write : writes)
+        {
+            if (!values.empty())
+                values += ", ";
+
+            values += Acore::StringFormat("('{}', {}, {}, {})",
+                SqlSafe(write.quotaKey, 191), write.tokens, write.capacity, static_cast<uint64>(write.lastRefill));
+        }
+
+        WorldDatabaseTransaction trans = WorldDatabase.BeginTransaction();
+        trans->Append(Acore::StringFormat("REPLACE INTO `{}` (`keyname`, `tokens`, `capacity`, `last_refill`) VALUES {}",
+            QUOTA_TABLE_NAME, values).c_str());
+
+        ScopedLatencyTimer latency(TIMER_DB_QUOTA_FLUSH);
+
+        if (direct)
+            WorldDatabase.DirectCommitTransaction(trans);
+        else
+            WorldDatabase.CommitTransaction(trans);
+    }
+}
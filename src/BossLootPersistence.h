@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_PERSISTENCE_H
+#define MOD_BOSSLOOT_PERSISTENCE_H
+
+#include "BossLootMutex.h"
+#include "BossLootRules.h"
+#include "BossLootState.h"
+#include "DatabaseEnvFwd.h"
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Player;
+
+namespace BossLoot
+{
+    // World database persistence for once-per-server drops. Only rules with AllowRepeat = 0 and a
+    // OnceKey are written.
+    void EnsureTable();
+    void EnsureRowsForRules(std::vector<BossLootRule> const& rules);
+    void ResetStatesForRules(std::vector<BossLootRule> const& rules, bool resetAll);
+    void MigrateLegacyGeddonStateIfNeeded(std::vector<BossLootRule> const& rules);
+    std::unordered_map<std::string, bool> LoadDroppedStatesForRules(std::vector<BossLootRule> const& rules);
+
+    // Kill and loot phase writes of a once-per-server drop, committed asynchronously. The caller
+    // decides whether the rule needs them; the callback reports when the transaction is done.
+    TransactionCallback PersistDroppedKillPhase(BossLootRule const& rule, PendingInjectedDrop const& pending, std::string const& killerName);
+    TransactionCallback PersistDroppedLootPhase(BossLootRule const& rule, PendingInjectedDrop const& pending, std::string const& looterName);
+
+    // Character database persistence for once-per-character and once-per-account drops. Rows are
+    // loaded asynchronously through the player's session at login and written in batches.
+    void EnsureScopedOnceTables();
+    void ResetScopedOnceForRules(std::vector<BossLootRule> const& rules, bool resetAll);
+    void LoadScopedOnceAsync(Player* player);
+
+    // Writes every drop reserved since the last flush in one transaction. Direct blocks until it is
+    // committed, for shutdown.
+    void FlushScopedOnceWrites(bool direct = false);
+
+    // Character database persistence for pity counters. A counter of zero deletes its row.
+    void EnsurePityTable();
+    void LoadPityAsync(Player* player);
+    void WritePityCounters(std::vector<PityWrite> const& writes, bool direct = false);
+
+    // World database persistence for Quota buckets. Binds every quota rule to its bucket, reads the
+    // buckets seen for the first time from the database, and refills any whose QuotaRefill came
+    // round while the server was down.
+    void EnsureQuotaTable();
+    void LoadQuotaBuckets(std::vector<BossLootRule>& rules, std::time_t now);
+    void WriteQuotaStates(std::vector<QuotaWrite> const& writes, bool direct = false);
+
+    LockContention GetDbLockContention();
+}
+
+#endif
@@ -0,0 +1,714 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootRules.h"
+#include "BossLootBatchRoll.h"
+#include "BossLootTemplate.h"
+#include "Config.h"
+#include "Log.h"
+#include "LootMgr.h"
+#include "ObjectMgr.h"
+#include "Random.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include <mutex>
+
+using namespace BossLoot;
+
+namespace
+{
+    // Original module defaults
+    static constexpr uint32 NPC_BARON_GEDDON = 12056;
+    static constexpr uint32 ITEM_TALISMAN = 17782;
+
+    static constexpr char const* CONF_ENABLE = "BossLoot.Enable";
+    static constexpr char const* CONF_RULE_COUNT = "BossLoot.RuleCount";
+    static constexpr char const* CONF_RESET_ALL_ON_STARTUP = "BossLoot.ResetOnStartup";
+
+    static constexpr char const* DEFAULT_QUOTA_REFILL = "0 0 * * *";
+
+    static constexpr char const* LEGACY_CONF_ENABLE = "GeddonShard.Enable";
+    static constexpr char const* LEGACY_CONF_NPC_ENTRY = "GeddonShard.NpcEntry";
+    static constexpr char const* LEGACY_CONF_CHANCE = "GeddonShard.Chance";
+    static constexpr char const* LEGACY_CONF_ALLOW_REPEAT = "GeddonShard.AllowRepeat";
+    static constexpr char const* LEGACY_CONF_RESET = "GeddonShard.ResetOnStartup";
+
+    std::string ConfigKey(uint32 index, char const* leaf)
+    {
+        return Acore::StringFormat("BossLoot.Rule.{}.{}", index, leaf);
+    }
+
+    std::string MakeAutoOnceKey(uint32 ruleIndex, uint32 npcEntry, uint32 itemEntry)
+    {
+        if (!itemEntry)
+            return Acore::StringFormat("bossloot_rule{}_npc{}_pool", ruleIndex, npcEntry);
+
+        return Acore::StringFormat("bossloot_rule{}_npc{}_item{}", ruleIndex, npcEntry, itemEntry);
+    }
+
+    BossLootRule LoadConfiguredRule(uint32 index)
+    {
+        BossLootRule rule;
+        rule.index = index;
+        rule.enable = sConfigMgr->GetOption<bool>(ConfigKey(index, "Enable"), true);
+        std::string const npcKey = ConfigKey(index, "NpcEntry");
+        rule.npcEntries = ParseEntryRanges(sConfigMgr->GetOption<std::string>(npcKey, ""), npcKey);
+        std::erase_if(rule.npcEntries, [](auto const& range) { return range.second == 0; });
+        rule.npcEntry = rule.npcEntries.empty() ? 0 : std::max<uint32>(rule.npcEntries.front().first, 1);
+
+        std::string const rankKey = ConfigKey(index, "Rank");
+        std::string const familyKey = ConfigKey(index, "Family");
+        std::string const mapKey = ConfigKey(index, "Map");
+        rule.ranks = ParseEntryRanges(sConfigMgr->GetOption<std::string>(rankKey, "", false), rankKey);
+        rule.families = ParseEntryRanges(sConfigMgr->GetOption<std::string>(familyKey, "", false), familyKey);
+        rule.maps = ParseEntryRanges(sConfigMgr->GetOption<std::string>(mapKey, "", false), mapKey);
+
+        rule.itemEntry = sConfigMgr->GetOption<uint32>(ConfigKey(index, "ItemEntry"), 0);
+        rule.chancePct = ClampChance(sConfigMgr->GetOption<float>(ConfigKey(index, "Chance"), 0.0f));
+
+        // Difficulty ids are per map type: dungeons 0 normal, 1 heroic; raids 0 10N, 1 25N, 2 10H, 3 25H.
+        std::string const difficultyKey = ConfigKey(index, "Difficulty");
+        EntryRanges const difficulties = ParseEntryRanges(sConfigMgr->GetOption<std::string>(difficultyKey, "", false), difficultyKey);
+        if (!difficulties.empty())
+        {
+            rule.difficultyMask = 0;
+            for (uint32 difficulty = 0; difficulty < MAX_DIFFICULTY; ++difficulty)
+            {
+                if (InRanges(difficulties, difficulty))
+                    rule.difficultyMask |= 1 << difficulty;
+            }
+        }
+
+        for (uint32 difficulty = 0; difficulty < MAX_DIFFICULTY; ++difficulty)
+        {
+            float const chance = sConfigMgr->GetOption<float>(Acore::StringFormat("BossLoot.Rule.{}.Chance.{}", index, difficulty), -1.0f, false);
+            if (chance >= 0.0f)
+                rule.difficultyChancePct[difficulty] = ClampChance(chance);
+        }
+        rule.minCount = sConfigMgr->GetOption<uint32>(ConfigKey(index, "MinCount"), 1);
+        rule.maxCount = sConfigMgr->GetOption<uint32>(ConfigKey(index, "MaxCount"), 1);
+        rule.allowRepeat = sConfigMgr->GetOption<bool>(ConfigKey(index, "AllowRepeat"), true);
+        rule.preventDuplicate = sConfigMgr->GetOption<bool>(ConfigKey(index, "PreventDuplicate"), true);
+        rule.resetOnStart = sConfigMgr->GetOption<bool>(ConfigKey(index, "ResetOnStartup"), false);
+        rule.announce = sConfigMgr->GetOption<bool>(ConfigKey(index, "Announce"), false);
+        rule.onceKey = Trim(sConfigMgr->GetOption<std::string>(ConfigKey(index, "OnceKey"), ""));
+
+        std::string const scopeKey = ConfigKey(index, "OnceScope");
+        std::string scope = Trim(sConfigMgr->GetOption<std::string>(scopeKey, "server", false));
+        std::transform(scope.begin(), scope.end(), scope.begin(), [](unsigned char ch) { return std::tolower(ch); });
+
+        if (scope == "character")
+            rule.onceScope = OnceScope::Character;
+        else if (scope == "account")
+            rule.onceScope = OnceScope::Account;
+        else if (scope != "server" && !scope.empty())
+            LOG_ERROR("module", "[BossLoot] {}: unknown scope '{}', expected Server, Character or Account. Using Server.", scopeKey, scope);
+
+        rule.announceMessage = sConfigMgr->GetOption<std::string>(ConfigKey(index, "AnnounceMessage"), DEFAULT_ANNOUNCE_MESSAGE);
+
+        rule.pityStepPct = ClampChance(sConfigMgr->GetOption<float>(ConfigKey(index, "PityStep"), 0.0f, false));
+        rule.pityGuarantee = std::min(sConfigMgr->GetOption<uint32>(ConfigKey(index, "PityGuarantee"), 0, false), MAX_PITY_STEPS);
+
+        std::string const fromKey = ConfigKey(index, "ActiveFrom");
+        std::string const untilKey = ConfigKey(index, "ActiveUntil");
+        std::string const scheduleKey = ConfigKey(index, "Schedule");
+        std::string const from = sConfigMgr->GetOption<std::string>(fromKey, "", false);
+        std::string const until = sConfigMgr->GetOption<std::string>(untilKey, "", false);
+        std::string const schedule = Trim(sConfigMgr->GetOption<std::string>(scheduleKey, "", false));
+
+        rule.activeFrom = ParseLocalDateTime(from);
+        rule.activeUntil = ParseLocalDateTime(until);
+
+        if (!rule.activeFrom && !Trim(from).empty())
+            LOG_ERROR("module", "[BossLoot] {}: '{}' is not a date, expected YYYY-MM-DD or YYYY-MM-DD HH:MM. Ignored.", fromKey, from);
+
+        if (!rule.activeUntil && !Trim(until).empty())
+            LOG_ERROR("module", "[BossLoot] {}: '{}' is not a date, expected YYYY-MM-DD or YYYY-MM-DD HH:MM. Ignored.", untilKey, until);
+
+        if (!schedule.empty())
+        {
+            rule.hasSchedule = rule.schedule.Parse(schedule);
+            if (!rule.hasSchedule)
+                LOG_ERROR("module", "[BossLoot] {}: '{}' is not a five-field cron expression. Ignored.", scheduleKey, schedule);
+        }
+
+        // A pool replaces ItemEntry: the rule rolls once, then picks one item by weight.
+        std::string const poolKey = ConfigKey(index, "Pool");
+        rule.pool = BuildItemPool(ParseEntryPairs(sConfigMgr->GetOption<std::string>(poolKey, "", false), poolKey));
+        if (rule.IsPool())
+            rule.itemEntry = 0;
+
+        if (rule.minCount == 0)
+            rule.minCount = 1;
+
+        if (rule.maxCount == 0)
+            rule.maxCount = 1;
+
+        if (rule.maxCount < rule.minCount)
+            std::swap(rule.minCount, rule.maxCount);
+
+        if (!rule.allowRepeat && rule.onceKey.empty())
+            rule.onceKey = MakeAutoOnceKey(index, rule.npcEntry, rule.itemEntry);
+
+        // Counters follow OnceKey when there is one, so a reordered config keeps everyone's progress.
+        if (rule.HasPity())
+            rule.pityKey = rule.onceKey.empty() ? MakeAutoOnceKey(index, rule.npcEntry, rule.itemEntry) : rule.onceKey;
+
+        rule.quota = sConfigMgr->GetOption<uint32>(ConfigKey(index, "Quota"), 0, false);
+        if (rule.HasQuota())
+        {
+            rule.quotaKey = rule.onceKey.empty() ? MakeAutoOnceKey(index, rule.npcEntry, rule.itemEntry) : rule.onceKey;
+
+            std::string const refillKey = ConfigKey(index, "QuotaRefill");
+            std::string const refill = Trim(sConfigMgr->GetOption<std::string>(refillKey, DEFAULT_QUOTA_REFILL, false));
+            if (!rule.quotaRefill.Parse(refill))
+            {
+                LOG_ERROR("module", "[BossLoot] {}: '{}' is not a five-field cron expression. Using '{}'.", refillKey, refill, DEFAULT_QUOTA_REFILL);
+                rule.quotaRefill.Parse(DEFAULT_QUOTA_REFILL);
+            }
+        }
+
+        return rule;
+    }
+
+    BossLootRule LoadLegacyRule()
+    {
+        BossLootRule rule;
+        rule.index = 1;
+        rule.enable = sConfigMgr->GetOption<bool>(LEGACY_CONF_ENABLE, true);
+        rule.npcEntry = sConfigMgr->GetOption<uint32>(LEGACY_CONF_NPC_ENTRY, NPC_BARON_GEDDON);
+        rule.itemEntry = ITEM_TALISMAN;
+        rule.chancePct = ClampChance(sConfigMgr->GetOption<float>(LEGACY_CONF_CHANCE, 1.0f));
+        rule.minCount = 1;
+        rule.maxCount = 1;
+        rule.allowRepeat = sConfigMgr->GetOption<bool>(LEGACY_CONF_ALLOW_REPEAT, false);
+        rule.preventDuplicate = true;
+        rule.resetOnStart = sConfigMgr->GetOption<bool>(LEGACY_CONF_RESET, false);
+        rule.announce = true;
+        rule.onceKey = LEGACY_KEY_NAME;
+        rule.announceMessage = "{player} has looted the legendary {item} from {boss}!";
+
+        if (rule.npcEntry == 0)
+            rule.npcEntry = NPC_BARON_GEDDON;
+
+        return rule;
+    }
+
+    bool MatchesCreatureFilters(BossLootRule const& rule, CreatureTemplate const& creature)
+    {
+        return (rule.ranks.empty() || InRanges(rule.ranks, creature.rank))
+            && (rule.families.empty() || InRanges(rule.families, creature.family));
+    }
+
+    // Every creature entry the rule applies to, sorted. Plain entries without a rank or family
+    // filter are taken as written; ranges and filters are resolved against creature_template.
+    std::vector<uint32> ExpandNpcEntries(BossLootRule const& rule)
+    {
+        std::vector<uint32> entries;
+        bool const filtered = !rule.ranks.empty() || !rule.families.empty();
+        bool scan = rule.npcEntries.empty() && filtered;
+
+        if (rule.npcEntries.empty() && !filtered && rule.npcEntry)
+            entries.push_back(rule.npcEntry);
+
+        for (auto const& [low, high] : rule.npcEntries)
+        {
+            if (low == high && !filtered)
+                entries.push_back(low);
+            else
+                scan = true;
+        }
+
+        if (scan)
+        {
+            if (CreatureTemplateContainer const* creatures = sObjectMgr->GetCreatureTemplates())
+            {
+                for (auto const& [entry, creature] : *creatures)
+                {
+                    if ((rule.npcEntries.empty() || InRanges(rule.npcEntries, entry)) && MatchesCreatureFilters(rule, creature))
+                        entries.push_back(entry);
+                }
+            }
+        }
+
+        std::sort(entries.begin(), entries.end());
+        entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+        return entries;
+    }
+
+    LootStoreItem MakeLootStoreItem(uint32 itemId, uint32 minCount, uint32 maxCount)
+    {
+        return LootStoreItem(itemId,
+            /*reference*/0,
+            /*chance*/100.0f,
+            /*needs_quest*/false,
+            /*lootmode*/LOOT_MODE_DEFAULT,
+            /*groupid*/0,
+            /*mincount*/minCount,
+            /*maxcount*/maxCount);
+    }
+}
+
+namespace BossLoot
+{
+    bool BossLootRule::IsActiveAt(std::time_t now, std::tm const& localTime) const
+    {
+        if (activeFrom && now < activeFrom)
+            return false;
+
+        if (activeUntil && now >= activeUntil)
+            return false;
+
+        return !hasSchedule || schedule.Matches(localTime);
+    }
+
+    double BossLootRule::GetChance(uint32 difficulty) const
+    {
+        if (difficulty < MAX_DIFFICULTY && difficultyChancePct[difficulty] >= 0.0)
+            return difficultyChancePct[difficulty];
+
+        return chancePct;
+    }
+
+    RuleVariantList const* RuleSet::FindRules(uint32 npcEntry, uint32 difficulty) const
+    {
+        if (difficulty >= MAX_DIFFICULTY)
+            return nullptr;
+
+        auto itr = rulesByEntry.find(npcEntry);
+        if (itr == rulesByEntry.end() || itr->second[difficulty].empty())
+            return nullptr;
+
+        return &itr->second[difficulty];
+    }
+
+    std::vector<BossLootRule> LoadRulesFromConfig(bool& enabled, bool& resetAllOnStartup)
+    {
+        enabled = sConfigMgr->GetOption<bool>(CONF_ENABLE, true);
+        resetAllOnStartup = sConfigMgr->GetOption<bool>(CONF_RESET_ALL_ON_STARTUP, false);
+
+        uint32 ruleCount = sConfigMgr->GetOption<uint32>(CONF_RULE_COUNT, 0);
+        std::vector<BossLootRule> rules;
+
+        if (ruleCount == 0)
+        {
+            // Backward compatible mode: if the owner has not opted into BossLoot.Rule.*,
+            // the old GeddonShard.* config still behaves like before.
+            enabled = sConfigMgr->GetOption<bool>(LEGACY_CONF_ENABLE, true);
+            rules.push_back(LoadLegacyRule());
+            return rules;
+        }
+
+        // Hard cap prevents an accidental silly config from making startup unpleasant.
+        if (ruleCount > MAX_RULES)
+        {
+            LOG_WARN("module", "[BossLoot] BossLoot.RuleCount={} is excessive. Clamping to {} rules.", ruleCount, MAX_RULES);
+            ruleCount = MAX_RULES;
+        }
+
+        rules.reserve(ruleCount);
+
+        for (uint32 i = 1; i <= ruleCount; ++i)
+        {
+            BossLootRule rule = LoadConfiguredRule(i);
+
+            bool const hasCreatures = !rule.npcEntries.empty() || !rule.ranks.empty() || !rule.families.empty();
+            if (rule.enable && (!hasCreatures || (rule.itemEntry == 0 && !rule.IsPool())))
+            {
+                LOG_WARN("module", "[BossLoot] Skipping active rule {} because it has no NpcEntry/Rank/Family, or no ItemEntry/Pool.", i);
+                continue;
+            }
+
+            rules.push_back(rule);
+        }
+
+        return rules;
+    }
+
+    double ClampChance(double value)
+    {
+        if (value < 0.0)
+            return 0.0;
+
+        if (value > 100.0)
+            return 100.0;
+
+        return value;
+    }
+
+    uint32 GetRollThreshold(double chancePct)
+    {
+        chancePct = ClampChance(chancePct);
+
+        if (chancePct <= 0.0)
+            return 0;
+
+        if (chancePct >= 100.0)
+            return ROLL_SCALE;
+
+        return static_cast<uint32>((chancePct / 100.0) * static_cast<double>(ROLL_SCALE) + 0.5);
+    }
+
+    std::vector<uint32> BuildPityCurve(double chancePct, double stepPct, uint32 guarantee)
+    {
+        // The curve ends at the guarantee, or at the first step that reaches 100%, or at
+        // MAX_PITY_STEPS; GetPityThreshold clamps every later kill to its last entry.
+        uint32 length = MAX_PITY_STEPS;
+        if (guarantee)
+            length = std::min(length, guarantee);
+
+        if (stepPct > 0.0)
+            length = std::min<uint32>(length, static_cast<uint32>(std::ceil(std::max(0.0, 100.0 - chancePct) / stepPct)) + 1);
+        else if (!guarantee)
+            length = 1;
+
+        std::vector<uint32> curve;
+        curve.reserve(length);
+
+        for (uint32 misses = 0; misses < length; ++misses)
+        {
+            if (guarantee && misses + 1 >= guarantee)
+            {
+                curve.push_back(ROLL_SCALE);
+                break;
+            }
+
+            curve.push_back(GetRollThreshold(chancePct + stepPct * misses));
+            if (curve.back() >= ROLL_SCALE)
+                break;
+        }
+
+        return curve;
+    }
+
+    uint32 GetPityThreshold(std::vector<uint32> const& curve, uint32 misses)
+    {
+        return curve[std::min<std::size_t>(misses, curve.size() - 1)];
+    }
+
+    bool RollDrop(double chancePct)
+    {
+        return RollThreshold(GetRollThreshold(chancePct));
+    }
+
+    bool RollThreshold(uint32 need)
+    {
+        if (need == 0)
+            return false;
+
+        if (need >= ROLL_SCALE)
+            return true;
+
+        return urand(1, ROLL_SCALE) <= need;
+    }
+
+    bool InRanges(EntryRanges const& ranges, uint32 value)
+    {
+        for (auto const& [low, high] : ranges)
+        {
+            if (value >= low && value <= high)
+                return true;
+        }
+
+        return false;
+    }
+
+    uint32 ItemPool::Pick() const
+    {
+        uint32 const column = items.size() > 1 ? urand(0, static_cast<uint32>(items.size()) - 1) : 0;
+        return rand32() < keep[column] ? items[column] : items[alias[column]];
+    }
+
+    ItemPool BuildItemPool(std::vector<std::pair<uint32, uint32>> const& weightedItems)
+    {
+        ItemPool pool;
+        double totalWeight = 0.0;
+
+        for (auto const& [itemEntry, weight] : weightedItems)
+        {
+            if (!itemEntry || !weight)
+                continue;
+
+            pool.items.push_back(itemEntry);
+            pool.weights.push_back(weight);
+            totalWeight += weight;
+        }
+
+        uint32 const count = static_cast<uint32>(pool.items.size());
+        if (!count)
+            return pool;
+
+        // Scale every weight so the average column holds exactly 1.0, then let each under-full column
+        // borrow the rest of its probability from an over-full one.
+        std::vector<double> scaled(count);
+        std::vector<uint32> small;
+        std::vector<uint32> large;
+
+        for (uint32 i = 0; i < count; ++i)
+        {
+            scaled[i] = pool.weights[i] * count / totalWeight;
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+        }
+
+        std::vector<double> keep(count, 1.0);
+        pool.alias.assign(count, 0);
+
+        while (!small.empty() && !large.empty())
+        {
+            uint32 const less = small.back();
+            small.pop_back();
+            uint32 const more = large.back();
+            large.pop_back();
+
+            keep[less] = scaled[less];
+            pool.alias[less] = more;
+
+            scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+            (scaled[more] < 1.0 ? small : large).push_back(more);
+        }
+
+        // Whatever is left is 1.0 up to rounding.
+        double constexpr coinScale = 4294967296.0;
+        pool.keep.resize(count);
+        for (uint32 i = 0; i < count; ++i)
+            pool.keep[i] = static_cast<uint64>(std::min(keep[i], 1.0) * coinScale + 0.5);
+
+        return pool;
+    }
+
+    void AddItemToLoot(Loot* loot, uint32 itemId, uint32 minCount, uint32 maxCount)
+    {
+        if (!loot)
+            return;
+
+        loot->AddItem(MakeLootStoreItem(itemId, minCount, maxCount));
+    }
+
+    bool RemoveItemFromLoot(Loot* loot, uint32 itemId)
+    {
+        if (!loot)
+            return false;
+
+        for (bool const questItems : { false, true })
+        {
+            std::vector<LootItem>& items = questItems ? loot->quest_items : loot->items;
+            for (uint32 index = 0; index < items.size(); ++index)
+            {
+                LootItem& lootItem = items[index];
+                if (lootItem.itemid != itemId || lootItem.is_looted)
+                    continue;
+
+                lootItem.is_looted = true;
+                if (loot->unlootedCount)
+                    --loot->unlootedCount;
+
+                // Anyone with the loot window open would otherwise still see the item and get an
+                // error when they click it.
+                if (questItems)
+                    loot->NotifyQuestItemRemoved(static_cast<uint8>(index));
+                else
+                    loot->NotifyItemRemoved(static_cast<uint8>(index));
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void CorpseItemSet::Clear()
+    {
+        _heap.clear();
+        _size = 0;
+    }
+
+    void CorpseItemSet::Append(uint32 itemId)
+    {
+        if (_heap.empty() && _size == INLINE_CAPACITY)
+        {
+            _heap.reserve(INLINE_CAPACITY * 2);
+            _heap.assign(_inline.begin(), _inline.end());
+        }
+
+        if (_heap.empty())
+            _inline[_size] = itemId;
+        else
+            _heap.push_back(itemId);
+
+        ++_size;
+    }
+
+    void CorpseItemSet::Gather(Loot const* loot)
+    {
+        Clear();
+
+        if (!loot)
+            return;
+
+        for (auto const& lootItem : loot->items)
+            Append(lootItem.itemid);
+
+        for (auto const& lootItem : loot->quest_items)
+            Append(lootItem.itemid);
+
+        uint32* data = Data();
+        std::sort(data, data + _size);
+        _size = static_cast<uint32>(std::unique(data, data + _size) - data);
+
+        if (!_heap.empty())
+            _heap.resize(_size);
+    }
+
+    void CorpseItemSet::Insert(uint32 itemId)
+    {
+        if (Contains(itemId))
+            return;
+
+        Append(itemId);
+
+        // Shift the new last element down into place.
+        uint32* data = Data();
+        std::rotate(std::upper_bound(data, data + _size - 1, itemId), data + _size - 1, data + _size);
+    }
+
+    bool CorpseItemSet::Contains(uint32 itemId) const
+    {
+        return std::binary_search(begin(), end(), itemId);
+    }
+
+    std::shared_ptr<RuleSet const> CompileRuleSet(bool enabled, std::vector<BossLootRule> rules, std::time_t now)
+    {
+        static std::atomic<uint32> lastGeneration{ 0 };
+
+        std::shared_ptr<RuleSet> ruleSet = std::make_shared<RuleSet>();
+        ruleSet->enabled = enabled;
+        ruleSet->generation = lastGeneration.fetch_add(1, std::memory_order_relaxed) + 1;
+        ruleSet->rules = std::move(rules);
+        ruleSet->active.assign(ruleSet->rules.size(), true);
+
+        std::tm const localTime = Acore::Time::TimeBreakdown(now);
+
+        for (uint32 i = 0; i < ruleSet->rules.size(); ++i)
+        {
+            BossLootRule& rule = ruleSet->rules[i];
+            rule.ruleId = i;
+
+            if (!rule.enable)
+                continue;
+
+            if (rule.IsTimed())
+            {
+                ruleSet->timed = true;
+                ruleSet->active[i] = rule.IsActiveAt(now, localTime);
+            }
+
+            if (!ruleSet->active[i])
+                continue;
+
+            if (rule.HasPity())
+            {
+                for (uint32 difficulty = 0; difficulty < MAX_DIFFICULTY; ++difficulty)
+                {
+                    if (rule.AllowsDifficulty(difficulty))
+                        rule.pityCurve[difficulty] = BuildPityCurve(rule.GetChance(difficulty), rule.pityStepPct, rule.pityGuarantee);
+                }
+            }
+
+            bool const rollsAtKill = !rule.allowRepeat || rule.HasPity();
+            std::vector<uint32> const entries = ExpandNpcEntries(rule);
+            rule.matchedEntries = static_cast<uint32>(entries.size());
+
+            for (uint32 entry : entries)
+            {
+                auto& byDifficulty = ruleSet->rulesByEntry[entry];
+                for (uint32 difficulty = 0; difficulty < MAX_DIFFICULTY; ++difficulty)
+                {
+                    if (!rule.AllowsDifficulty(difficulty))
+                        continue;
+
+                    RuleVariantList& list = byDifficulty[difficulty];
+                    if (list.size() < 64 && rollsAtKill)
+                        list.killRollMask |= uint64(1) << list.size();
+
+                    list.variants.push_back({ i });
+                    list.rollBounds.push_back(GetRollBound(GetRollThreshold(rule.GetChance(difficulty))));
+                }
+            }
+        }
+
+        return ruleSet;
+    }
+
+    RuleSetHolder::RuleSetHolder() : _ruleSet(std::make_shared<RuleSet const>()) { }
+
+    void RuleSetHolder::Publish(std::shared_ptr<RuleSet const> ruleSet)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+        _enabled.store(ruleSet->enabled, std::memory_order_relaxed);
+        _ruleSet = std::move(ruleSet);
+    }
+
+    std::shared_ptr<RuleSet const> RuleSetHolder::Get() const
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+        return _ruleSet;
+    }
+
+    bool RuleSetHolder::IsEnabled() const
+    {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    RuleSetHolder& GetRuleSetHolder()
+    {
+        static RuleSetHolder holder;
+        return holder;
+    }
+
+    void PublishRuleSet(std::shared_ptr<RuleSet const> ruleSet)
+    {
+        GetRuleSetHolder().Publish(std::move(ruleSet));
+    }
+
+    std::shared_ptr<RuleSet const> GetRuleSet()
+    {
+        return GetRuleSetHolder().Get();
+    }
+
+    bool IsModuleEnabled()
+    {
+        return GetRuleSetHolder().IsEnabled();
+    }
+
+    void RefreshTimedRules(std::time_t now)
+    {
+        std::shared_ptr<RuleSet const> current = GetRuleSet();
+        if (!current->timed)
+            return;
+
+        std::tm const localTime = Acore::Time::TimeBreakdown(now);
+        bool changed = false;
+
+        for (uint32 i = 0; i < current->rules.size(); ++i)
+        {
+            BossLootRule const& rule = current->rules[i];
+            if (!rule.enable || !rule.IsTimed())
+                continue;
+
+            bool const active = rule.IsActiveAt(now, localTime);
+            if (active == current->active[i])
+                continue;
+
+            LOG_INFO("module", "[BossLoot] Rule {} is now {}.", rule.index, active ? "active" : "inactive");
+            changed = true;
+        }
+
+        if (changed)
+            PublishRuleSet(CompileRuleSet(current->enabled, current->rules, now));
+    }
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_RULES_H
+#define MOD_BOSSLOOT_RULES_H
+
+#include "BossLootMutex.h"
+#include "BossLootSchedule.h"
+#include "DBCEnums.h"
+#include "Define.h"
+
+#include <array>
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct Loot;
+
+namespace BossLoot
+{
+    struct QuotaBucket;
+
+    constexpr uint32 MAX_RULES = 256;
+
+    // Longest pity escalation curve, and the highest PityGuarantee. Each rule keeps one curve per
+    // difficulty, so this bounds them at 4 KB each; counters saturate at the last step.
+    constexpr uint32 MAX_PITY_STEPS = 1024;
+
+    // Per-drop events go to their own logger so they can be silenced, or sent to a separate
+    // appender, without touching the rest of the "module" output. Unconfigured, it inherits "module".
+    constexpr char const* LOG_FILTER_DROPS = "module.bossloot";
+
+    constexpr char const* LEGACY_KEY_NAME = "geddon_17782_once";
+
+    // Who a rule with AllowRepeat = 0 drops once for.
+    enum class OnceScope : uint8
+    {
+        Server,
+        Character,
+        Account
+    };
+
+    // Inclusive [low, high] ranges, as configured in NpcEntry, Rank, Family and Map.
+    using EntryRanges = std::vector<std::pair<uint32, uint32>>;
+
+    bool InRanges(EntryRanges const& ranges, uint32 value);
+
+    // Weighted item list of a Pool rule. Sampled with Vose's alias method: one uniform column and one
+    // biased coin per pick, so the cost does not depend on the pool size.
+    struct ItemPool
+    {
+        std::vector<uint32> items;
+        std::vector<uint32> weights;
+
+        // Column i keeps items[i] when rand32() < keep[i] (scaled to 2^32), otherwise yields items[alias[i]].
+        std::vector<uint64> keep;
+        std::vector<uint32> alias;
+
+        bool empty() const { return items.empty(); }
+        uint32 Pick() const;
+    };
+
+    // Zero weights are dropped. Returns an empty pool when nothing is left.
+    ItemPool BuildItemPool(std::vector<std::pair<uint32, uint32>> const& weightedItems);
+
+    struct BossLootRule
+    {
+        uint32 index = 0;
+        uint32 ruleId = 0;      // position in RuleSet::rules, set by CompileRuleSet
+        bool enable = true;
+        uint32 npcEntry = 0;    // first configured entry; labels the rule in stats and the database
+        EntryRanges npcEntries; // every configured entry and range, empty for synthetic and legacy rules
+        EntryRanges ranks;      // creature_template rank filter, empty = any
+        EntryRanges families;   // creature_template family filter, empty = any
+        EntryRanges maps;       // map id filter, checked per kill, empty = any
+        uint32 matchedEntries = 0; // creature entries indexed by CompileRuleSet
+        uint32 itemEntry = 0;   // 0 for pool rules; the picked item is decided per drop
+        ItemPool pool;
+        double chancePct = 0.0;
+        uint32 difficultyMask = (1 << MAX_DIFFICULTY) - 1;
+        std::array<double, MAX_DIFFICULTY> difficultyChancePct{ -1.0, -1.0, -1.0, -1.0 }; // < 0 = use chancePct
+        uint32 minCount = 1;
+        uint32 maxCount = 1;
+        bool allowRepeat = true;
+        bool preventDuplicate = true;
+        bool resetOnStart = false;
+        bool announce = false;
+        OnceScope onceScope = OnceScope::Server;
+        uint32 onceBit = 0;     // interned onceKey for the Character and Account scopes
+        std::atomic<uint32>* onceFlag = nullptr; // the Server scope onceKey's shared memory flag, resolved when the config is loaded
+        std::string onceKey;
+        std::string announceMessage;
+
+        // Bad-luck protection: each failed roll by the killer adds pityStepPct to the chance, and the
+        // pityGuarantee-th kill always drops (0 = no guarantee). Counters are kept per character under pityKey.
+        double pityStepPct = 0.0;
+        uint32 pityGuarantee = 0;
+        std::string pityKey;
+        uint32 pityId = 0;      // interned pityKey
+        std::array<std::vector<uint32>, MAX_DIFFICULTY> pityCurve; // failed kills -> roll threshold, built by CompileRuleSet
+
+        // Server-wide economy cap: at most quota drops under quotaKey between two refills, and the
+        // bucket is topped back up whenever quotaRefill matches. 0 = no cap.
+        uint32 quota = 0;
+        std::string quotaKey;
+        CronSchedule quotaRefill;
+        QuotaBucket* quotaBucket = nullptr; // owned by QuotaStore, bound when the config is loaded
+
+        // Activation window [activeFrom, activeUntil), 0 = open-ended, and an optional cron schedule.
+        std::time_t activeFrom = 0;
+        std::time_t activeUntil = 0;
+        bool hasSchedule = false;
+        CronSchedule schedule;
+
+        bool IsPool() const { return !pool.empty(); }
+        bool HasPity() const { return pityStepPct > 0.0 || pityGuarantee; }
+        bool HasQuota() const { return quota > 0; }
+        bool IsOnce(OnceScope scope) const { return !allowRepeat && onceScope == scope && !onceKey.empty(); }
+        bool IsTimed() const { return activeFrom || activeUntil || hasSchedule; }
+        bool IsActiveAt(std::time_t now, std::tm const& localTime) const;
+        bool AllowsDifficulty(uint32 difficulty) const { return difficulty < MAX_DIFFICULTY && (difficultyMask & (1 << difficulty)); }
+        double GetChance(uint32 difficulty) const;
+    };
+
+    // One rule as it applies to one difficulty. Its chance, already turned into a roll bound, is kept
+    // next to it in RuleVariantList::rollBounds.
+    struct RuleVariant
+    {
+        uint32 ruleId = 0;  // position in RuleSet::rules
+    };
+
+    // The variants of one creature entry and difficulty. Their RollBatch bounds are kept in a
+    // separate array, so a kill rolls all of them in one contiguous pass.
+    struct RuleVariantList
+    {
+        std::vector<RuleVariant> variants;
+        std::vector<uint64> rollBounds;
+
+        // Variants among the first 64 that roll at the kill even when BossLoot.PreRoll rolled the
+        // rest ahead of it: once and pity rules, whose outcome must not be settled before the kill.
+        uint64 killRollMask = 0;
+
+        bool empty() const { return variants.empty(); }
+        uint32 size() const { return static_cast<uint32>(variants.size()); }
+    };
+
+    // Immutable rule snapshot shared by every hook call. A (re)load builds a new one and swaps the
+    // pointer, so the kill path copies one shared_ptr instead of the whole rule list.
+    struct RuleSet
+    {
+        bool enabled = true;
+        std::vector<BossLootRule> rules;
+
+        // Different for every compiled set, so state derived from one set can tell it is stale.
+        uint32 generation = 0;
+
+        // Whether each rule was inside its activation window when the set was compiled. Inactive
+        // rules are left out of the index, so the kill path never looks at the clock.
+        std::vector<bool> active;
+        bool timed = false;
+
+        // creature entry -> positions in rules, enabled rules only, in config order. Lists, ranges and
+        // rank/family filters are already expanded, so a kill is one lookup however broad the rule.
+        // Each entry holds one variant list per map difficulty, so the kill path never looks at
+        // DifficultyMask or per-difficulty chances.
+        std::unordered_map<uint32, std::array<RuleVariantList, MAX_DIFFICULTY>> rulesByEntry;
+
+        RuleVariantList const* FindRules(uint32 npcEntry, uint32 difficulty) const;
+
+        // nullptr if ruleId is out of range.
+        BossLootRule const* GetRule(uint32 ruleId) const { return ruleId < rules.size() ? &rules[ruleId] : nullptr; }
+    };
+
+    // Holds the live snapshot. Readers copy the shared_ptr under the lock and then work lock-free.
+    class RuleSetHolder
+    {
+    public:
+        RuleSetHolder();
+
+        void Publish(std::shared_ptr<RuleSet const> ruleSet);
+        std::shared_ptr<RuleSet const> Get() const;
+        bool IsEnabled() const;
+
+        LockContention GetContention() const { return _mutex.GetContention("gConfigMutex"); }
+
+    private:
+        mutable ContentionMutex _mutex;
+        std::shared_ptr<RuleSet const> _ruleSet;
+        std::atomic<bool> _enabled{ true }; // mirrors _ruleSet->enabled, so IsEnabled takes no lock
+    };
+
+    std::vector<BossLootRule> LoadRulesFromConfig(bool& enabled, bool& resetAllOnStartup);
+    std::shared_ptr<RuleSet const> CompileRuleSet(bool enabled, std::vector<BossLootRule> rules, std::time_t now);
+
+    // The module-wide holder used by the hooks.
+    RuleSetHolder& GetRuleSetHolder();
+    void PublishRuleSet(std::shared_ptr<RuleSet const> ruleSet);
+    std::shared_ptr<RuleSet const> GetRuleSet();
+    bool IsModuleEnabled();
+
+    // Recompiles and republishes the live set if a timed rule has entered or left its window since
+    // it was compiled. Called from the world update loop once a minute; pending drops are untouched.
+    void RefreshTimedRules(std::time_t now);
+
+    // Rolls are uniform in [1, ROLL_SCALE]; 100.0000% precision keeps tiny legendary rates sane
+    // without floating point comparisons. A roll hits when it is <= GetRollThreshold(chance).
+    constexpr uint32 ROLL_SCALE = 1000000;
+
+    double ClampChance(double value);
+    uint32 GetRollThreshold(double chancePct);
+
+    // Roll threshold after 0, 1, 2 ... failed kills, up to the first step that always drops or
+    // MAX_PITY_STEPS. Later kills use the last step.
+    std::vector<uint32> BuildPityCurve(double chancePct, double stepPct, uint32 guarantee);
+    uint32 GetPityThreshold(std::vector<uint32> const& curve, uint32 misses);
+    bool RollThreshold(uint32 rollThreshold);
+    bool RollDrop(double chancePct);
+
+    void AddItemToLoot(Loot* loot, uint32 itemId, uint32 minCount, uint32 maxCount);
+
+    // Marks the first unlooted copy of the item as looted and takes it out of every open loot window.
+    // Returns false if there was none left.
+    bool RemoveItemFromLoot(Loot* loot, uint32 itemId);
+
+    // Sorted item entries of one corpse's loot and quest loot. Gathered once per kill so every
+    // PreventDuplicate rule of the creature is a binary search instead of a loot scan. Small
+    // corpses stay in the inline buffer; larger ones spill to the heap.
+    class CorpseItemSet
+    {
+    public:
+        static constexpr uint32 INLINE_CAPACITY = 32;
+
+        void Clear();
+        void Gather(Loot const* loot);
+        void Insert(uint32 itemId);
+        bool Contains(uint32 itemId) const;
+
+        uint32 Size() const { return _size; }
+        uint32 const* begin() const { return Data(); }
+        uint32 const* end() const { return Data() + _size; }
+
+    private:
+        uint32* Data() { return _heap.empty() ? _inline.data() : _heap.data(); }
+        uint32 const* Data() const { return _heap.empty() ? _inline.data() : _heap.data(); }
+        void Append(uint32 itemId);
+
+        std::array<uint32, INLINE_CAPACITY> _inline{};
+        std::vector<uint32> _heap;
+        uint32 _size = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootSchedule.h"
+#include "BossLootTemplate.h"
+#include "StringConvert.h"
+#include "Timer.h"
+#include "Tokenize.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    // Sets every value a single cron field selects in [min, max] into bits. Returns false if malformed.
+    template<std::size_t N>
+    bool ParseCronField(std::string_view field, uint32 min, uint32 max, std::bitset<N>& bits, bool& restricted)
+    {
+        restricted = field != "*";
+
+        for (std::string_view part : Acore::Tokenize(field, ',', false))
+        {
+            uint32 step = 1;
+            std::size_t const slash = part.find('/');
+            if (slash != std::string_view::npos)
+            {
+                Optional<uint32> parsedStep = Acore::StringTo<uint32>(part.substr(slash + 1));
+                if (!parsedStep || !*parsedStep)
+                    return false;
+
+                step = *parsedStep;
+                part = part.substr(0, slash);
+            }
+
+            uint32 low = min;
+            uint32 high = max;
+
+            if (part != "*")
+            {
+                std::size_t const dash = part.find('-');
+                Optional<uint32> first = Acore::StringTo<uint32>(part.substr(0, dash));
+                Optional<uint32> last = dash != std::string_view::npos ? Acore::StringTo<uint32>(part.substr(dash + 1)) : first;
+
+                if (!first || !last || *first > *last || *first < min || *last > max)
+                    return false;
+
+                low = *first;
+                // "5/15" means every 15th value starting at 5.
+                high = (dash == std::string_view::npos && slash != std::string_view::npos) ? max : *last;
+            }
+
+            for (uint32 value = low; value <= high; value += step)
+                bits.set(value % N);
+        }
+
+        return true;
+    }
+}
+
+namespace BossLoot
+{
+    bool CronSchedule::Parse(std::string const& expression)
+    {
+        std::vector<std::string_view> const fields = Acore::Tokenize(expression, ' ', false);
+        if (fields.size() != 5)
+            return false;
+
+        CronSchedule parsed;
+        bool minutesRestricted = false;
+        bool hoursRestricted = false;
+        bool monthsRestricted = false;
+
+        // Day-of-week accepts 7 for Sunday; bit 7 wraps onto bit 0 through the modulo above.
+        if (!ParseCronField(fields[0], 0, 59, parsed._minutes, minutesRestricted)
+            || !ParseCronField(fields[1], 0, 23, parsed._hours, hoursRestricted)
+            || !ParseCronField(fields[2], 1, 31, parsed._daysOfMonth, parsed._dayOfMonthRestricted)
+            || !ParseCronField(fields[3], 1, 12, parsed._months, monthsRestricted)
+            || !ParseCronField(fields[4], 0, 7, parsed._daysOfWeek, parsed._dayOfWeekRestricted))
+            return false;
+
+        *this = parsed;
+        return true;
+    }
+
+    bool CronSchedule::Matches(std::tm const& localTime) const
+    {
+        if (!_minutes.test(localTime.tm_min) || !_hours.test(localTime.tm_hour) || !_months.test(localTime.tm_mon + 1))
+            return false;
+
+        bool const dayOfMonth = _daysOfMonth.test(localTime.tm_mday);
+        bool const dayOfWeek = _daysOfWeek.test(localTime.tm_wday);
+
+        if (_dayOfMonthRestricted && _dayOfWeekRestricted)
+            return dayOfMonth || dayOfWeek;
+
+        return dayOfMonth && dayOfWeek;
+    }
+
+    uint32 CronSchedule::CountMatches(std::time_t after, std::time_t until) const
+    {
+        uint32 count = 0;
+        for (std::time_t minute = (after / MINUTE + 1) * MINUTE; minute <= until; minute += MINUTE)
+        {
+            if (Matches(Acore::Time::TimeBreakdown(minute)))
+                ++count;
+        }
+
+        return count;
+    }
+
+    std::time_t ParseLocalDateTime(std::string const& text)
+    {
+        std::string const trimmed = Trim(text);
+        if (trimmed.empty())
+            return 0;
+
+        std::tm time{};
+        int hour = 0;
+        int minute = 0;
+
+        int const fields = std::sscanf(trimmed.c_str(), "%d-%d-%d %d:%d", &time.tm_year, &time.tm_mon, &time.tm_mday, &hour, &minute);
+        if (fields != 3 && fields != 5)
+            return 0;
+
+        time.tm_year -= 1900;
+        time.tm_mon -= 1;
+        time.tm_hour = hour;
+        time.tm_min = minute;
+        time.tm_isdst = -1;
+
+        std::time_t const result = std::mktime(&time);
+        return result == static_cast<std::time_t>(-1) ? 0 : result;
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_SCHEDULE_H
+#define MOD_BOSSLOOT_SCHEDULE_H
+
+#include "Define.h"
+
+#include <bitset>
+#include <ctime>
+#include <string>
+
+namespace BossLoot
+{
+    // Five-field cron expression, "minute hour day-of-month month day-of-week", in server local time.
+    // Fields take *, values, a-b ranges, comma lists and /step. Day-of-week 0 and 7 are Sunday. As in
+    // cron, when both day fields are restricted a time matches if either of them does.
+    class CronSchedule
+    {
+    public:
+        // Returns false, and leaves the schedule untouched, if the expression is malformed.
+        bool Parse(std::string const& expression);
+
+        bool Matches(std::tm const& localTime) const;
+
+        // Number of matching minutes after `after` up to and including `until`.
+        uint32 CountMatches(std::time_t after, std::time_t until) const;
+
+    private:
+        std::bitset<60> _minutes;
+        std::bitset<24> _hours;
+        std::bitset<32> _daysOfMonth;
+        std::bitset<13> _months;
+        std::bitset<7> _daysOfWeek;
+        bool _dayOfMonthRestricted = false;
+        bool _dayOfWeekRestricted = false;
+    };
+
+    // "YYYY-MM-DD" or "YYYY-MM-DD HH:MM" in server local time. Returns 0 if empty or malformed.
+    std::time_t ParseLocalDateTime(std::string const& text);
+}
+
+#endif
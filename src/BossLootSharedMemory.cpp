@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootSharedMemory.h"
+#include "CompilerDefs.h"
+#include "Log.h"
+
+#include <cstring>
+#include <random>
+#include <thread>
+
+#if AC_PLATFORM != AC_PLATFORM_WINDOWS
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    static constexpr uint32 SEGMENT_MAGIC = 0x424C4F33; // "BLO3"
+
+    // Any other state is the session id of the writer copying its key in, so a writer that died
+    // half way can be told from a slow one. Session ids are never either value.
+    enum SlotState : uint32
+    {
+        SLOT_EMPTY = 0,
+        SLOT_READY = 0xFFFFFFFF
+    };
+
+    // How often a reader waiting on a writer checks that the writer is still alive.
+    static constexpr uint32 WRITER_CHECK_SPINS = 1024;
+
+    static_assert(std::atomic<uint32>::is_always_lock_free, "once flags must be lock-free to live in shared memory");
+    static_assert(std::atomic<uint64>::is_always_lock_free, "heartbeats must be lock-free to live in shared memory");
+
+    uint32 HashKey(std::string_view key)
+    {
+        uint32 hash = 2166136261u;
+        for (char ch : key)
+            hash = (hash ^ static_cast<uint8>(ch)) * 16777619u;
+
+        return hash;
+    }
+
+    bool IsWriting(uint32 state)
+    {
+        return state != SLOT_EMPTY && state != SLOT_READY;
+    }
+}
+
+namespace BossLoot
+{
+    struct OnceFlagSegment::Layout
+    {
+        // id 0 is a free entry; heartbeat is unix time, which every container on the host shares.
+        struct Session
+        {
+            std::atomic<uint32> id;
+            std::atomic<uint64> heartbeat;
+        };
+
+        struct Slot
+        {
+            std::atomic<uint32> state;
+            std::atomic<uint32> dropped;
+            char key[MAX_KEY_LENGTH + 1];
+        };
+
+        std::atomic<uint32> magic;
+        Session sessions[MAX_SESSIONS];
+        Slot slots[MAX_KEYS];
+    };
+
+    bool OnceFlagSegment::IsSessionAlive(uint32 sessionId, std::time_t now) const
+    {
+        for (Layout::Session const& session : _layout->sessions)
+        {
+            if (session.id.load(std::memory_order_acquire) != sessionId)
+                continue;
+
+            // A clock stepped back counts as fresh rather than reclaiming a live writer.
+            std::time_t const heartbeat = static_cast<std::time_t>(session.heartbeat.load(std::memory_order_acquire));
+            return now - heartbeat <= SESSION_TIMEOUT;
+        }
+
+        return false;
+    }
+
+    bool OnceFlagSegment::RegisterSession(std::time_t now)
+    {
+        std::random_device random;
+
+        uint32 id = SLOT_EMPTY;
+        while (id == SLOT_EMPTY || id == SLOT_READY || IsSessionAlive(id, now))
+            id = random();
+
+        for (uint32 i = 0; i < MAX_SESSIONS; ++i)
+        {
+            Layout::Session& session = _layout->sessions[i];
+
+            uint32 current = session.id.load(std::memory_order_acquire);
+            if (current != 0 && IsSessionAlive(current, now))
+                continue;
+
+            if (!session.id.compare_exchange_strong(current, id, std::memory_order_acq_rel))
+                continue;
+
+            session.heartbeat.store(static_cast<uint64>(now), std::memory_order_release);
+
+            // Another process may have seen the id with the old heartbeat and taken the entry too.
+            if (session.id.load(std::memory_order_acquire) != id)
+                continue;
+
+            _sessionId = id;
+            _sessionIndex = i;
+            return true;
+        }
+
+        return false;
+    }
+
+    void OnceFlagSegment::Heartbeat(std::time_t now)
+    {
+        Layout::Session& session = _layout->sessions[_sessionIndex];
+
+        if (session.id.load(std::memory_order_relaxed) == _sessionId)
+        {
+            session.heartbeat.store(static_cast<uint64>(now), std::memory_order_release);
+            return;
+        }
+
+        // The world update stalled past SESSION_TIMEOUT and another process took the entry over.
+        LOG_WARN("module", "[BossLoot] Session {} in shared memory segment '{}' timed out; registering a new one.", _sessionId, _name);
+        if (!RegisterSession(now))
+            LOG_ERROR("module", "[BossLoot] Shared memory segment '{}' has no free session; half-written slots of this process cannot be told from dead ones.", _name);
+    }
+
+    std::atomic<uint32>* OnceFlagSegment::Find(std::string_view onceKey)
+    {
+        if (onceKey.empty() || onceKey.size() > MAX_KEY_LENGTH)
+            return nullptr;
+
+        uint32 const start = HashKey(onceKey) % MAX_KEYS;
+
+        for (uint32 probe = 0; probe < MAX_KEYS;)
+        {
+            Layout::Slot& slot = _layout->slots[(start + probe) % MAX_KEYS];
+            uint32 state = slot.state.load(std::memory_order_acquire);
+
+            if (state == SLOT_EMPTY)
+            {
+                if (slot.state.compare_exchange_strong(state, _sessionId, std::memory_order_acq_rel))
+                {
+                    std::memcpy(slot.key, onceKey.data(), onceKey.size());
+                    slot.key[onceKey.size()] = '\0';
+
+                    // Only fails if this process stalled past SESSION_TIMEOUT mid-copy and the slot
+                    // was reclaimed; look at the slot again.
+                    uint32 writing = _sessionId;
+                    if (slot.state.compare_exchange_strong(writing, SLOT_READY, std::memory_order_acq_rel))
+                        return &slot.dropped;
+
+                    continue;
+                }
+
+                // Another process took the slot between the load and the CAS; look at what it wrote.
+            }
+
+            // Keys are a few dozen bytes, so a live writer is only ever a memcpy away from done. A
+            // writer that died mid-copy never returned the flag, so nobody holds it, and no key was
+            // placed past the slot while it was taken: it is emptied and looked at again.
+            for (uint32 spins = 1; IsWriting(state = slot.state.load(std::memory_order_acquire)); ++spins)
+            {
+                if (spins % WRITER_CHECK_SPINS == 0 && !IsSessionAlive(state, std::time(nullptr))
+                    && slot.state.compare_exchange_strong(state, SLOT_EMPTY, std::memory_order_acq_rel))
+                {
+                    LOG_WARN("module", "[BossLoot] Reclaimed a once-key slot in shared memory segment '{}' left half written by session {}.",
+                        _name, state);
+                }
+
+                std::this_thread::yield();
+            }
+
+            if (state == SLOT_EMPTY)
+                continue;
+
+            if (std::string_view(slot.key) == onceKey)
+                return &slot.dropped;
+
+            ++probe;
+        }
+
+        return nullptr;
+    }
+
+#if AC_PLATFORM != AC_PLATFORM_WINDOWS
+
+    std::unique_ptr<OnceFlagSegment> OnceFlagSegment::Open(std::string const& name)
+    {
+        std::string const path = name.front() == '/' ? name : "/" + name;
+
+        int const fd = shm_open(path.c_str(), O_RDWR | O_CREAT, 0600);
+        if (fd < 0)
+        {
+            LOG_ERROR("module", "[BossLoot] Could not open shared memory segment '{}': {}.", path, std::strerror(errno));
+            return nullptr;
+        }
+
+        struct stat info;
+        bool created = false;
+        if (fstat(fd, &info) == 0 && info.st_size == 0)
+        {
+            // A fresh segment. Two processes may both get here; they truncate to the same size.
+            created = ftruncate(fd, sizeof(Layout)) == 0;
+            info.st_size = sizeof(Layout);
+        }
+
+        if (info.st_size != static_cast<off_t>(sizeof(Layout)))
+        {
+            LOG_ERROR("module", "[BossLoot] Shared memory segment '{}' is {} bytes, expected {}. Remove it or pick another name.",
+                path, uint64(info.st_size), uint64(sizeof(Layout)));
+            close(fd);
+            return nullptr;
+        }
+
+        void* address = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (address == MAP_FAILED)
+        {
+            LOG_ERROR("module", "[BossLoot] Could not map shared memory segment '{}': {}.", path, std::strerror(errno));
+            return nullptr;
+        }
+
+        Layout* layout = static_cast<Layout*>(address);
+
+        uint32 magic = 0;
+        if (!layout->magic.compare_exchange_strong(magic, SEGMENT_MAGIC, std::memory_order_acq_rel) && magic != SEGMENT_MAGIC)
+        {
+            LOG_ERROR("module", "[BossLoot] Shared memory segment '{}' has an unknown layout. Remove it or pick another name.", path);
+            munmap(address, sizeof(Layout));
+            return nullptr;
+        }
+
+        std::unique_ptr<OnceFlagSegment> segment(new OnceFlagSegment(path, layout, created));
+        if (!segment->RegisterSession(std::time(nullptr)))
+        {
+            LOG_ERROR("module", "[BossLoot] Shared memory segment '{}' already has {} live sessions.", path, MAX_SESSIONS);
+            return nullptr;
+        }
+
+        return segment;
+    }
+
+    OnceFlagSegment::~OnceFlagSegment()
+    {
+        uint32 sessionId = _sessionId;
+        if (sessionId)
+            _layout->sessions[_sessionIndex].id.compare_exchange_strong(sessionId, 0, std::memory_order_acq_rel);
+
+        munmap(_layout, sizeof(Layout));
+    }
+
+#else
+
+    std::unique_ptr<OnceFlagSegment> OnceFlagSegment::Open(std::string const& name)
+    {
+        LOG_ERROR("module", "[BossLoot] Shared memory segment '{}' requested, but POSIX shared memory is not available on this platform.", name);
+        return nullptr;
+    }
+
+    OnceFlagSegment::~OnceFlagSegment() = default;
+
+#endif
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_SHAREDMEMORY_H
+#define MOD_BOSSLOOT_SHAREDMEMORY_H
+
+#include "Define.h"
+
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace BossLoot
+{
+    // Once-per-server flags in a POSIX shared memory segment, so worldserver processes on one host
+    // share them without a database round trip. The segment is a fixed open-addressed table of
+    // once keys, each with a 32-bit dropped flag; keys are interned and reserved with plain CAS
+    // operations. A process only ever waits for another to finish copying a key into a slot, and a
+    // slot left half written by a process that died is reclaimed. A zero-filled segment is a valid
+    // empty table, which makes concurrent creation safe.
+    //
+    // Writers are told apart by a session: a random id each process registers in the segment when
+    // it maps it, with a heartbeat the process keeps fresh. Process ids would not do, as worldservers
+    // in separate containers can share /dev/shm without sharing a PID namespace. A session whose
+    // heartbeat is older than SESSION_TIMEOUT is dead, and its half-written slots are reclaimed.
+    //
+    // The segment outlives the processes; the world database stays the durable copy.
+    class OnceFlagSegment
+    {
+    public:
+        static constexpr uint32 MAX_KEYS = 4096;
+        static constexpr uint32 MAX_KEY_LENGTH = 191;
+        static constexpr uint32 MAX_SESSIONS = 64;
+        static constexpr std::time_t SESSION_TIMEOUT = 60; // seconds
+
+        // Maps the named segment, creating it if needed, and registers this process's session.
+        // Returns nullptr, after logging why, if it cannot be mapped, has another layout, has no
+        // free session, or the platform has no POSIX shared memory.
+        static std::unique_ptr<OnceFlagSegment> Open(std::string const& name);
+
+        ~OnceFlagSegment();
+
+        OnceFlagSegment(OnceFlagSegment const&) = delete;
+        OnceFlagSegment& operator=(OnceFlagSegment const&) = delete;
+
+        // The dropped flag for the key, claiming a slot the first time any process asks. nullptr if
+        // the key is too long or the table is full.
+        std::atomic<uint32>* Find(std::string_view onceKey);
+
+        // Keeps the session alive. Called from the world update; cheap enough for every tick.
+        void Heartbeat(std::time_t now);
+
+        bool Created() const { return _created; }
+        std::string const& Name() const { return _name; }
+
+    private:
+        struct Layout;
+
+        OnceFlagSegment(std::string name, Layout* layout, bool created) : _name(std::move(name)), _layout(layout), _created(created) { }
+
+        bool RegisterSession(std::time_t now);
+        bool IsSessionAlive(uint32 sessionId, std::time_t now) const;
+
+        std::string _name;
+        Layout* _layout;
+        bool _created;
+        uint32 _sessionId = 0;
+        uint32 _sessionIndex = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootSharedOnce.h"
+#include "BossLootState.h"
+#include "BossLootTemplate.h"
+#include "DatabaseEnv.h"
+#include "Log.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_set>
+
+using namespace BossLoot;
+
+namespace
+{
+    static constexpr char const* TABLE_NAME = "mod_configurable_boss_loot_once";
+
+    static std::mutex gSharedMutex;
+    static std::condition_variable gSharedCondition;
+    static std::thread gSharedThread;
+    static bool gSharedStop = true;
+    static std::atomic<bool> gSharedEnabled{ false };
+
+    // Guarded by gSharedMutex.
+    static std::deque<OnceClaim> gClaims;
+    static std::vector<OnceClaimResult> gResults;
+    static std::vector<std::string> gPollKeys;
+    static std::chrono::seconds gPollInterval{ 0 };
+    static std::string gProcessToken;
+    static uint64 gClaimSequence = 0;
+
+    std::string MakeProcessToken()
+    {
+        std::random_device device;
+        return Acore::StringFormat("{:08x}{:08x}", device(), device());
+    }
+
+    // The UPDATE only matches while the key is free, so exactly one process gets its token stored.
+    // The core does not report affected rows, so the token is read back instead.
+    bool ClaimKey(OnceClaim const& claim, std::string const& token)
+    {
+        std::string const key = SqlSafe(claim.onceKey, 191);
+        std::string const killerName = SqlSafe(claim.killerName, 64);
+        std::string const killer = killerName.empty() ? std::string("NULL") : Acore::StringFormat("'{}'", killerName);
+        uint64 const now = static_cast<uint64>(std::time(nullptr));
+
+        WorldDatabase.DirectExecute(
+            Acore::StringFormat(
+                "UPDATE `{}` SET `dropped`=1, `claim_token`='{}', `last_drop_time`={}, `last_killer`={}, `npc_entry`={}, `item_entry`={} "
+                "WHERE `keyname`='{}' AND `dropped`=0",
+                TABLE_NAME, token, now, killer, claim.npcEntry, claim.itemEntry, key
+            ).c_str()
+        );
+
+        QueryResult result = WorldDatabase.Query(
+            Acore::StringFormat("SELECT `claim_token` FROM `{}` WHERE `keyname`='{}' LIMIT 1", TABLE_NAME, key).c_str());
+
+        if (!result)
+            return false;
+
+        Field* fields = result->Fetch();
+        return !fields[0].IsNull() && fields[0].Get<std::string>() == token;
+    }
+
+    std::unordered_map<std::string, bool> PollKeys(std::vector<std::string> const& keys)
+    {
+        std::unordered_map<std::string, bool> states;
+        if (keys.empty())
+            return states;
+
+        std::string list;
+        for (std::string const& key : keys)
+        {
+            if (!list.empty())
+                list += ", ";
+
+            list += Acore::StringFormat("'{}'", SqlSafe(key, 191));
+        }
+
+        if (QueryResult result = WorldDatabase.Query(
+            Acore::StringFormat("SELECT `keyname`, `dropped` FROM `{}` WHERE `keyname` IN ({})", TABLE_NAME, list).c_str()))
+        {
+            do
+            {
+                Field* fields = result->Fetch();
+                states[fields[0].Get<std::string>()] = fields[1].Get<uint8>() != 0;
+            } while (result->NextRow());
+        }
+
+        return states;
+    }
+
+    void RunSharedOnceWorker()
+    {
+        auto nextPoll = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(gSharedMutex);
+        while (!gSharedStop || !gClaims.empty())
+        {
+            if (!gClaims.empty())
+            {
+                OnceClaim claim = std::move(gClaims.front());
+                gClaims.pop_front();
+                std::string const token = Acore::StringFormat("{}:{}", gProcessToken, ++gClaimSequence);
+
+                lock.unlock();
+                bool const won = ClaimKey(claim, token);
+                lock.lock();
+
+                if (!won)
+                    LOG_WARN("module", "[BossLoot] Once-key '{}' was claimed by another worldserver first.", claim.onceKey);
+
+                gResults.push_back({ std::move(claim), won });
+                continue;
+            }
+
+            if (gPollInterval.count() && std::chrono::steady_clock::now() >= nextPoll)
+            {
+                std::vector<std::string> const keys = gPollKeys;
+
+                lock.unlock();
+                std::unordered_map<std::string, bool> const states = PollKeys(keys);
+                lock.lock();
+
+                // A key claimed while the query ran is decided by its claim, not by this older read.
+                std::unordered_set<std::string> inFlight;
+                for (OnceClaim const& claim : gClaims)
+                    inFlight.insert(claim.onceKey);
+
+                for (auto const& [key, dropped] : states)
+                {
+                    if (!inFlight.count(key))
+                        sBossLootOnceState->Set(key, dropped);
+                }
+
+                nextPoll = std::chrono::steady_clock::now() + gPollInterval;
+                continue;
+            }
+
+            auto const wake = []() { return gSharedStop || !gClaims.empty(); };
+
+            if (gPollInterval.count())
+                gSharedCondition.wait_until(lock, nextPoll, wake);
+            else
+                gSharedCondition.wait(lock, wake);
+        }
+    }
+}
+
+namespace BossLoot
+{
+    void StartSharedOnceState(std::vector<std::string> onceKeys, uint32 pollIntervalSeconds)
+    {
+        {
+            std::lock_guard<std::mutex> guard(gSharedMutex);
+            gPollKeys = std::move(onceKeys);
+            gPollInterval = std::chrono::seconds(pollIntervalSeconds);
+
+            if (gProcessToken.empty())
+                gProcessToken = MakeProcessToken();
+
+            if (!gSharedStop)
+            {
+                gSharedCondition.notify_all();
+                return;
+            }
+
+            gSharedStop = false;
+        }
+
+        if (gSharedThread.joinable())
+            gSharedThread.join();
+
+        gSharedThread = std::thread(RunSharedOnceWorker);
+        gSharedEnabled.store(true, std::memory_order_release);
+
+        LOG_INFO("module", "[BossLoot] Shared once-state enabled, claim token prefix {}, polling every {}s.",
+            gProcessToken, pollIntervalSeconds);
+    }
+
+    void StopSharedOnceState()
+    {
+        gSharedEnabled.store(false, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> guard(gSharedMutex);
+            gSharedStop = true;
+        }
+
+        gSharedCondition.notify_all();
+
+        if (gSharedThread.joinable())
+            gSharedThread.join();
+    }
+
+    bool IsSharedOnceStateEnabled()
+    {
+        return gSharedEnabled.load(std::memory_order_acquire);
+    }
+
+    bool ReserveOnceClaim(BossLootRule const& rule, OnceClaim claim)
+    {
+        {
+            std::lock_guard<std::mutex> guard(gSharedMutex);
+            if (!sBossLootOnceState->Reserve(rule))
+                return false;
+
+            gClaims.push_back(std::move(claim));
+        }
+
+        gSharedCondition.notify_one();
+        return true;
+    }
+
+    std::vector<OnceClaimResult> TakeOnceClaimResults()
+    {
+        std::lock_guard<std::mutex> guard(gSharedMutex);
+
+        std::vector<OnceClaimResult> results;
+        results.swap(gResults);
+        return results;
+    }
+}
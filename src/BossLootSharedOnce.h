@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_SHAREDONCE_H
+#define MOD_BOSSLOOT_SHAREDONCE_H
+
+#include "BossLootRules.h"
+#include "Define.h"
+#include "ObjectGuid.h"
+
+#include <string>
+#include <vector>
+
+namespace BossLoot
+{
+    // A once-per-server drop that was reserved locally and injected into a corpse, waiting for the
+    // shared world database to confirm that no other worldserver got the key first.
+    struct OnceClaim
+    {
+        std::string onceKey;
+        uint32 ruleIndex = 0;
+        ObjectGuid corpseGuid;
+        uint32 mapId = 0;
+        uint32 instanceId = 0;
+        uint32 npcEntry = 0;
+        uint32 itemEntry = 0;
+        uint32 killerId = 0;
+        std::string killerName;
+
+        // What the kill spent on the drop, settled once the claim is decided: a lost claim gives
+        // the quota token back, and the pity counter is only reset by a claim that was won.
+        QuotaBucket* quotaBucket = nullptr;
+        bool pity = false;
+        uint32 pityId = 0;
+    };
+
+    struct OnceClaimResult
+    {
+        OnceClaim claim;
+        bool won = false;
+    };
+
+    // Coordination of once-per-server keys between worldservers sharing one world database. A
+    // background thread claims each reserved key with a conditional UPDATE that only matches while
+    // dropped = 0, tagged with a token unique to this process, and reads the token back: the
+    // process whose token is stored won. It also polls the table so drops made elsewhere are seen.
+    //
+    // Starting again while running replaces the key list and interval. A pollIntervalSeconds of 0
+    // disables polling. Stopping finishes every claim still queued first.
+    void StartSharedOnceState(std::vector<std::string> onceKeys, uint32 pollIntervalSeconds);
+    void StopSharedOnceState();
+    bool IsSharedOnceStateEnabled();
+
+    // Reserves the key in OnceStateStore and queues its claim under the lock the poll updates the
+    // store with, so a poll that read the key before the claim cannot clear the reservation.
+    // Returns false, queueing nothing, if the key is already dropped or reserved.
+    bool ReserveOnceClaim(BossLootRule const& rule, OnceClaim claim);
+
+    // Claims decided since the last call. Taken by the world update loop, which settles each one.
+    std::vector<OnceClaimResult> TakeOnceClaimResults();
+}
+
+#endif
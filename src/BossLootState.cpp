@@ -0,0 +1,724 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootState.h"
+#include "BossLootSharedMemory.h"
+#include "Creature.h"
+
+#include <algorithm>
+#include <bit>
+#include <ctime>
+
+namespace BossLoot
+{
+    PendingInjectedDrop MakePendingDrop(Creature* killed, BossLootRule const& rule, uint32 itemEntry)
+    {
+        PendingInjectedDrop pending;
+        pending.lootGuid = killed->GetGUID();
+        pending.ruleId = rule.ruleId;
+        pending.npcEntry = killed->GetEntry();
+        pending.itemEntry = itemEntry;
+        pending.injectedAt = static_cast<uint32>(std::time(nullptr));
+        return pending;
+    }
+
+    OnceStateStore* OnceStateStore::instance()
+    {
+        static OnceStateStore instance;
+        return &instance;
+    }
+
+    std::atomic<uint32>* OnceStateStore::FindFlag(std::string const& onceKey) const
+    {
+        OnceFlagSegment* segment = _segment.load(std::memory_order_acquire);
+        return segment ? segment->Find(onceKey) : nullptr;
+    }
+
+    bool OnceStateStore::IsDropped(std::string const& onceKey) const
+    {
+        if (std::atomic<uint32>* flag = FindFlag(onceKey))
+            return flag->load(std::memory_order_acquire) != 0;
+
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        auto itr = _dropped.find(onceKey);
+        return itr != _dropped.end() && itr->second;
+    }
+
+    bool OnceStateStore::Reserve(std::string const& onceKey)
+    {
+        if (std::atomic<uint32>* flag = FindFlag(onceKey))
+        {
+            uint32 expected = 0;
+            return flag->compare_exchange_strong(expected, 1, std::memory_order_acq_rel);
+        }
+
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        bool& dropped = _dropped[onceKey];
+        if (dropped)
+            return false;
+
+        dropped = true;
+        return true;
+    }
+
+    bool OnceStateStore::IsDropped(BossLootRule const& rule) const
+    {
+        if (rule.onceFlag)
+            return rule.onceFlag->load(std::memory_order_acquire) != 0;
+
+        return IsDropped(rule.onceKey);
+    }
+
+    bool OnceStateStore::Reserve(BossLootRule const& rule)
+    {
+        if (rule.onceFlag)
+        {
+            uint32 expected = 0;
+            return rule.onceFlag->compare_exchange_strong(expected, 1, std::memory_order_acq_rel);
+        }
+
+        return Reserve(rule.onceKey);
+    }
+
+    void OnceStateStore::Set(std::string const& onceKey, bool dropped)
+    {
+        if (std::atomic<uint32>* flag = FindFlag(onceKey))
+        {
+            flag->store(dropped ? 1 : 0, std::memory_order_release);
+            return;
+        }
+
+        std::lock_guard<ContentionMutex> guard(_mutex);
+        _dropped[onceKey] = dropped;
+    }
+
+    void OnceStateStore::Merge(std::unordered_map<std::string, bool> const& states)
+    {
+        for (auto const& [onceKey, dropped] : states)
+        {
+            if (!dropped)
+                continue;
+
+            if (std::atomic<uint32>* flag = FindFlag(onceKey))
+            {
+                flag->store(1, std::memory_order_release);
+                continue;
+            }
+
+            std::lock_guard<ContentionMutex> guard(_mutex);
+            _dropped[onceKey] = true;
+        }
+    }
+
+    PendingDropStore* PendingDropStore::instance()
+    {
+        static PendingDropStore instance;
+        return &instance;
+    }
+
+    void PendingDropStore::Remember(PendingInjectedDrop const& pending)
+    {
+        Shard& shard = _shards[ShardIndex(pending.lootGuid)];
+        std::lock_guard<ContentionMutex> guard(shard.mutex);
+        shard.drops.push_back(pending);
+
+        uint32 const slot = pending.itemEntry % ITEM_FILTER_SLOTS;
+        if (shard.itemCounts[slot]++ == 0)
+            shard.itemBits[slot / 64].fetch_or(uint64(1) << (slot % 64), std::memory_order_relaxed);
+
+        shard.count.store(shard.drops.size(), std::memory_order_relaxed);
+    }
+
+    bool PendingDropStore::Take(ObjectGuid lootGuid, uint32 itemEntry, PendingInjectedDrop& out)
+    {
+        Shard& shard = _shards[ShardIndex(lootGuid)];
+        if (!shard.MayHold(itemEntry))
+            return false;
+
+        std::lock_guard<ContentionMutex> guard(shard.mutex);
+
+        auto itr = std::find_if(shard.drops.begin(), shard.drops.end(),
+            [&](PendingInjectedDrop const& pending)
+            {
+                return pending.lootGuid == lootGuid && pending.itemEntry == itemEntry;
+            });
+
+        if (itr == shard.drops.end())
+            return false;
+
+        out = *itr;
+        shard.drops.erase(itr);
+
+        uint32 const slot = itemEntry % ITEM_FILTER_SLOTS;
+        if (--shard.itemCounts[slot] == 0)
+            shard.itemBits[slot / 64].fetch_and(~(uint64(1) << (slot % 64)), std::memory_order_relaxed);
+
+        shard.count.store(shard.drops.size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    void PendingDropStore::Clear()
+    {
+        for (Shard& shard : _shards)
+        {
+            std::lock_guard<ContentionMutex> guard(shard.mutex);
+            shard.drops.clear();
+            shard.count.store(0, std::memory_order_relaxed);
+
+            shard.itemCounts.fill(0);
+            for (std::atomic<uint64>& bits : shard.itemBits)
+                bits.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void PendingDropStore::Expire(uint32 cutoff, std::vector<PendingInjectedDrop>& expired)
+    {
+        for (Shard& shard : _shards)
+        {
+            if (!shard.count.load(std::memory_order_relaxed))
+                continue;
+
+            std::lock_guard<ContentionMutex> guard(shard.mutex);
+
+            // Compacted in place, so the drops that stay keep their order and nothing allocates.
+            auto kept = shard.drops.begin();
+            for (PendingInjectedDrop const& pending : shard.drops)
+            {
+                if (pending.injectedAt >= cutoff)
+                {
+                    *kept++ = pending;
+                    continue;
+                }
+
+                uint32 const slot = pending.itemEntry % ITEM_FILTER_SLOTS;
+                if (--shard.itemCounts[slot] == 0)
+                    shard.itemBits[slot / 64].fetch_and(~(uint64(1) << (slot % 64)), std::memory_order_relaxed);
+
+                expired.push_back(pending);
+            }
+
+            shard.drops.erase(kept, shard.drops.end());
+            shard.count.store(shard.drops.size(), std::memory_order_relaxed);
+        }
+    }
+
+    uint64 PendingDropStore::Size() const
+    {
+        uint64 size = 0;
+        for (Shard const& shard : _shards)
+            size += shard.count.load(std::memory_order_relaxed);
+
+        return size;
+    }
+
+    LockContention PendingDropStore::GetContention() const
+    {
+        LockContention total{ "gPendingMutex" };
+        for (Shard const& shard : _shards)
+        {
+            LockContention const contention = shard.mutex.GetContention("gPendingMutex");
+            total.acquired += contention.acquired;
+            total.contended += contention.contended;
+        }
+
+        return total;
+    }
+
+    PreRollStore* PreRollStore::instance()
+    {
+        static PreRollStore instance;
+        return &instance;
+    }
+
+    void PreRollStore::Store(ObjectGuid guid, PreRoll const& preRoll)
+    {
+        Shard& shard = _shards[ShardIndex(guid)];
+        std::lock_guard<ContentionMutex> guard(shard.mutex);
+        shard.rolls[guid.GetRawValue()] = preRoll;
+        shard.count.store(shard.rolls.size(), std::memory_order_relaxed);
+    }
+
+    bool PreRollStore::Take(ObjectGuid guid, PreRoll& out)
+    {
+        Shard& shard = _shards[ShardIndex(guid)];
+        if (!shard.count.load(std::memory_order_relaxed))
+            return false;
+
+        std::lock_guard<ContentionMutex> guard(shard.mutex);
+
+        auto itr = shard.rolls.find(guid.GetRawValue());
+        if (itr == shard.rolls.end())
+            return false;
+
+        out = itr->second;
+        shard.rolls.erase(itr);
+        shard.count.store(shard.rolls.size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    void PreRollStore::Forget(ObjectGuid guid)
+    {
+        PreRoll unused;
+        Take(guid, unused);
+    }
+
+    void PreRollStore::Clear()
+    {
+        for (Shard& shard : _shards)
+        {
+            std::lock_guard<ContentionMutex> guard(shard.mutex);
+            shard.rolls.clear();
+            shard.count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64 PreRollStore::Size() const
+    {
+        uint64 size = 0;
+        for (Shard const& shard : _shards)
+            size += shard.count.load(std::memory_order_relaxed);
+
+        return size;
+    }
+
+    LockContention PreRollStore::GetContention() const
+    {
+        LockContention total{ "gPreRollMutex" };
+        for (Shard const& shard : _shards)
+        {
+            LockContention const contention = shard.mutex.GetContention("gPreRollMutex");
+            total.acquired += contention.acquired;
+            total.contended += contention.contended;
+        }
+
+        return total;
+    }
+
+    ScopedOnceStore* ScopedOnceStore::instance()
+    {
+        static ScopedOnceStore instance;
+        return &instance;
+    }
+
+    bool ScopedOnceStore::TestBit(Bits const& bits, uint32 bit)
+    {
+        return bit / 64 < bits.size() && (bits[bit / 64] & (uint64(1) << (bit % 64)));
+    }
+
+    void ScopedOnceStore::SetBit(Bits& bits, uint32 bit)
+    {
+        if (bit / 64 >= bits.size())
+            bits.resize(bit / 64 + 1, 0);
+
+        bits[bit / 64] |= uint64(1) << (bit % 64);
+    }
+
+    uint32 ScopedOnceStore::InternLocked(std::string const& onceKey)
+    {
+        auto [itr, inserted] = _keyBits.try_emplace(onceKey, static_cast<uint32>(_keyNames.size()));
+        if (inserted)
+            _keyNames.push_back(onceKey);
+
+        return itr->second;
+    }
+
+    uint32 ScopedOnceStore::Intern(std::string const& onceKey)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+        return InternLocked(onceKey);
+    }
+
+    void ScopedOnceStore::BeginLoad(uint32 characterId, uint32 accountId)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        auto [itr, inserted] = _characters.try_emplace(characterId);
+        if (!inserted)
+            return;
+
+        itr->second.accountId = accountId;
+        ++_accounts[accountId].characters;
+    }
+
+    void ScopedOnceStore::Load(uint32 characterId, std::vector<std::string> const& characterKeys, std::vector<std::string> const& accountKeys)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        // Logged out before the query came back.
+        auto itr = _characters.find(characterId);
+        if (itr == _characters.end() || itr->second.loaded)
+            return;
+
+        for (std::string const& key : characterKeys)
+            SetBit(itr->second.bits, InternLocked(key));
+
+        // OR in, so a drop already made by another character of the same account is kept.
+        AccountState& account = _accounts[itr->second.accountId];
+        for (std::string const& key : accountKeys)
+            SetBit(account.bits, InternLocked(key));
+
+        // A quick relog can read the database before the last batch of this owner was written.
+        for (ScopedOnceWrite const& write : _writes)
+        {
+            if (write.scope == OnceScope::Character && write.ownerId == characterId)
+                SetBit(itr->second.bits, InternLocked(write.onceKey));
+            else if (write.scope == OnceScope::Account && write.ownerId == itr->second.accountId)
+                SetBit(account.bits, InternLocked(write.onceKey));
+        }
+
+        itr->second.loaded = true;
+        _loadedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void ScopedOnceStore::Evict(uint32 characterId)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        auto itr = _characters.find(characterId);
+        if (itr == _characters.end())
+            return;
+
+        if (itr->second.loaded)
+            _loadedCount.fetch_sub(1, std::memory_order_relaxed);
+
+        auto account = _accounts.find(itr->second.accountId);
+        if (account != _accounts.end() && --account->second.characters == 0)
+            _accounts.erase(account);
+
+        _characters.erase(itr);
+    }
+
+    ScopedOnceStore::Bits* ScopedOnceStore::FindBits(uint32 characterId, OnceScope scope) const
+    {
+        auto itr = _characters.find(characterId);
+        if (itr == _characters.end() || !itr->second.loaded)
+            return nullptr;
+
+        if (scope == OnceScope::Character)
+            return &itr->second.bits;
+
+        auto account = _accounts.find(itr->second.accountId);
+        return account != _accounts.end() ? &account->second.bits : nullptr;
+    }
+
+    bool ScopedOnceStore::IsDropped(uint32 characterId, OnceScope scope, uint32 bit) const
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        Bits const* bits = FindBits(characterId, scope);
+        return !bits || TestBit(*bits, bit);
+    }
+
+    bool ScopedOnceStore::Reserve(uint32 characterId, OnceScope scope, uint32 bit)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        Bits* bits = FindBits(characterId, scope);
+        if (!bits || TestBit(*bits, bit) || bit >= _keyNames.size())
+            return false;
+
+        SetBit(*bits, bit);
+
+        ScopedOnceWrite write;
+        write.scope = scope;
+        write.ownerId = scope == OnceScope::Character ? characterId : _characters[characterId].accountId;
+        write.onceKey = _keyNames[bit];
+        _writes.push_back(std::move(write));
+        return true;
+    }
+
+    std::vector<ScopedOnceWrite> ScopedOnceStore::TakeWrites()
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        std::vector<ScopedOnceWrite> writes;
+        writes.swap(_writes);
+        return writes;
+    }
+
+    PityStore* PityStore::instance()
+    {
+        static PityStore instance;
+        return &instance;
+    }
+
+    uint32 PityStore::InternLocked(std::string const& pityKey)
+    {
+        auto [itr, inserted] = _keyIds.try_emplace(pityKey, static_cast<uint32>(_keyNames.size()));
+        if (inserted)
+            _keyNames.push_back(pityKey);
+
+        return itr->second;
+    }
+
+    uint32 PityStore::Intern(std::string const& pityKey)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+        return InternLocked(pityKey);
+    }
+
+    void PityStore::BeginLoad(uint32 characterId)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+        _characters.try_emplace(characterId);
+    }
+
+    void PityStore::Load(uint32 characterId, std::vector<std::pair<std::string, uint32>> const& counters)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        auto itr = _characters.find(characterId);
+        if (itr == _characters.end() || itr->second.loaded)
+            return;
+
+        CharacterPity& pity = itr->second;
+        pity.misses.assign(_keyNames.size(), 0);
+
+        for (auto const& [key, misses] : counters)
+        {
+            uint32 const id = InternLocked(key);
+            if (id >= pity.misses.size())
+                pity.misses.resize(id + 1, 0);
+
+            pity.misses[id] = static_cast<uint16>(std::min<uint32>(misses, MAX_PITY_STEPS));
+        }
+
+        pity.dirty.assign((pity.misses.size() + 63) / 64, 0);
+        pity.loaded = true;
+        _loadedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool PityStore::Roll(uint32 characterId, uint32 pityId, std::vector<uint32> const& curve) const
+    {
+        if (curve.empty())
+            return false;
+
+        uint32 misses = 0;
+        {
+            std::lock_guard<ContentionMutex> guard(_mutex);
+
+            auto itr = _characters.find(characterId);
+            if (itr != _characters.end() && itr->second.loaded && pityId < itr->second.misses.size())
+                misses = itr->second.misses[pityId];
+        }
+
+        return RollThreshold(GetPityThreshold(curve, misses));
+    }
+
+    void PityStore::Record(uint32 characterId, uint32 pityId, bool dropped)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        // Not loaded yet: the kill rolled at the first step and there is no counter to move.
+        auto itr = _characters.find(characterId);
+        if (itr == _characters.end() || !itr->second.loaded)
+            return;
+
+        CharacterPity& pity = itr->second;
+        if (pityId >= pity.misses.size())
+        {
+            pity.misses.resize(pityId + 1, 0);
+            pity.dirty.resize((pity.misses.size() + 63) / 64, 0);
+        }
+
+        uint16& misses = pity.misses[pityId];
+
+        // No curve is longer than MAX_PITY_STEPS, so there is no point counting further.
+        uint16 const next = dropped ? 0 : static_cast<uint16>(std::min<uint32>(misses + 1u, MAX_PITY_STEPS));
+        if (next != misses)
+        {
+            misses = next;
+            pity.dirty[pityId / 64] |= uint64(1) << (pityId % 64);
+            _dirtyCharacters.insert(characterId);
+        }
+    }
+
+    void PityStore::AppendWrites(uint32 characterId, CharacterPity& pity, std::vector<PityWrite>& writes)
+    {
+        for (uint32 word = 0; word < pity.dirty.size(); ++word)
+        {
+            for (uint64 bits = pity.dirty[word]; bits; bits &= bits - 1)
+            {
+                uint32 const id = word * 64 + static_cast<uint32>(std::countr_zero(bits));
+
+                PityWrite write;
+                write.characterId = characterId;
+                write.pityKey = _keyNames[id];
+                write.misses = pity.misses[id];
+                writes.push_back(std::move(write));
+            }
+
+            pity.dirty[word] = 0;
+        }
+    }
+
+    std::vector<PityWrite> PityStore::TakeWrites()
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        std::vector<PityWrite> writes;
+        for (uint32 characterId : _dirtyCharacters)
+        {
+            auto itr = _characters.find(characterId);
+            if (itr != _characters.end())
+                AppendWrites(characterId, itr->second, writes);
+        }
+
+        _dirtyCharacters.clear();
+        return writes;
+    }
+
+    std::vector<PityWrite> PityStore::Evict(uint32 characterId)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        std::vector<PityWrite> writes;
+
+        auto itr = _characters.find(characterId);
+        if (itr == _characters.end())
+            return writes;
+
+        if (itr->second.loaded)
+            _loadedCount.fetch_sub(1, std::memory_order_relaxed);
+
+        AppendWrites(characterId, itr->second, writes);
+        _characters.erase(itr);
+        _dirtyCharacters.erase(characterId);
+        return writes;
+    }
+
+    QuotaStore* QuotaStore::instance()
+    {
+        static QuotaStore instance;
+        return &instance;
+    }
+
+    QuotaBucket* QuotaStore::Bind(std::string const& quotaKey, uint32 capacity)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        std::unique_ptr<QuotaBucket>& bucket = _buckets[quotaKey];
+        if (!bucket)
+        {
+            bucket = std::make_unique<QuotaBucket>();
+            bucket->quotaKey = quotaKey;
+        }
+
+        if (bucket->capacity != capacity)
+        {
+            bucket->capacity = capacity;
+
+            if (bucket->tokens.load(std::memory_order_relaxed) > int32(capacity))
+                bucket->tokens.store(int32(capacity), std::memory_order_relaxed);
+
+            bucket->dirty.store(true, std::memory_order_relaxed);
+        }
+
+        return bucket.get();
+    }
+
+    void QuotaStore::Restore(QuotaBucket& bucket, int32 tokens, std::time_t lastRefill)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        if (bucket.loaded)
+            return;
+
+        bucket.tokens.store(std::clamp<int32>(tokens, 0, int32(bucket.capacity)), std::memory_order_relaxed);
+        bucket.lastRefill = lastRefill;
+        bucket.loaded = true;
+    }
+
+    void QuotaStore::Refill(QuotaBucket& bucket, std::time_t now)
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        // Two rules can share a key; the second one in the same minute has nothing to add.
+        if (bucket.lastRefill / MINUTE == now / MINUTE)
+            return;
+
+        bucket.tokens.store(int32(bucket.capacity), std::memory_order_relaxed);
+        bucket.lastRefill = now;
+        bucket.loaded = true;
+        bucket.dirty.store(true, std::memory_order_relaxed);
+    }
+
+    std::vector<QuotaWrite> QuotaStore::TakeWrites()
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        std::vector<QuotaWrite> writes;
+        for (auto const& [key, bucket] : _buckets)
+        {
+            if (!bucket->dirty.exchange(false, std::memory_order_relaxed))
+                continue;
+
+            QuotaWrite write;
+            write.quotaKey = key;
+            write.tokens = std::max<int32>(bucket->tokens.load(std::memory_order_relaxed), 0);
+            write.capacity = bucket->capacity;
+            write.lastRefill = bucket->lastRefill;
+            writes.push_back(std::move(write));
+        }
+
+        return writes;
+    }
+
+    EvaluatedCorpseSet* EvaluatedCorpseSet::instance()
+    {
+        static EvaluatedCorpseSet instance;
+        return &instance;
+    }
+
+    bool EvaluatedCorpseSet::TryMark(ObjectGuid corpseGuid)
+    {
+        if (!_windowMs.load(std::memory_order_relaxed))
+            return true;
+
+        uint64 const rawGuid = corpseGuid.GetRawValue();
+
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        if (_previous.count(rawGuid))
+            return false;
+
+        return _current.insert(rawGuid).second;
+    }
+
+    void EvaluatedCorpseSet::Update(uint32 diff)
+    {
+        uint32 const windowMs = _windowMs.load(std::memory_order_relaxed);
+        if (!windowMs)
+            return;
+
+        std::lock_guard<ContentionMutex> guard(_mutex);
+
+        _elapsedMs += diff;
+        if (_elapsedMs < windowMs)
+            return;
+
+        _elapsedMs = 0;
+        _previous.swap(_current);
+        _current.clear();
+    }
+
+    void EvaluatedCorpseSet::SetWindow(uint32 windowMs)
+    {
+        _windowMs.store(windowMs, std::memory_order_relaxed);
+
+        if (!windowMs)
+            Clear();
+    }
+
+    void EvaluatedCorpseSet::Clear()
+    {
+        std::lock_guard<ContentionMutex> guard(_mutex);
+        _current.clear();
+        _previous.clear();
+        _elapsedMs = 0;
+    }
+}
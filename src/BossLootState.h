@@ -0,0 +1,432 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_STATE_H
+#define MOD_BOSSLOOT_STATE_H
+
+#include "BossLootMutex.h"
+#include "BossLootRules.h"
+#include "Define.h"
+#include "ObjectGuid.h"
+
+#include <array>
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <type_traits>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Creature;
+
+namespace BossLoot
+{
+    // Plain data, so remembering and taking a drop never allocates. The once key, announcement and
+    // other rule settings are read back from the rule snapshot through ruleId when it is looted.
+    struct PendingInjectedDrop
+    {
+        ObjectGuid lootGuid;
+        uint32 ruleId = 0;      // position in RuleSet::rules
+        uint32 npcEntry = 0;    // the creature killed; a rule can cover many
+        uint32 itemEntry = 0;
+        uint32 injectedAt = 0;  // unix time, for expiry
+    };
+
+    static_assert(std::is_trivially_copyable_v<PendingInjectedDrop>, "pending drops are copied as plain data");
+
+    PendingInjectedDrop MakePendingDrop(Creature* killed, BossLootRule const& rule, uint32 itemEntry);
+
+    class OnceFlagSegment;
+
+    // In-memory once-per-server state, onceKey -> dropped. The database is the durable copy. With a
+    // shared memory segment attached, keys live in the segment instead and every call is a lock-free
+    // atomic on it; keys that do not fit in the segment stay in the map.
+    class OnceStateStore
+    {
+    public:
+        static OnceStateStore* instance();
+
+        // Attach once, before the first kill; the segment stays mapped until the process exits.
+        void AttachSegment(OnceFlagSegment* segment) { _segment.store(segment, std::memory_order_release); }
+        bool HasSegment() const { return _segment.load(std::memory_order_acquire) != nullptr; }
+
+        bool IsDropped(std::string const& onceKey) const;
+
+        // Marks the key as dropped. Returns false if it already was, so only one caller wins.
+        bool Reserve(std::string const& onceKey);
+
+        // The kill path: a rule whose flag was resolved is one atomic on it, without a key lookup.
+        bool IsDropped(BossLootRule const& rule) const;
+        bool Reserve(BossLootRule const& rule);
+
+        void Set(std::string const& onceKey, bool dropped);
+
+        // The key's flag in the attached segment, claiming a slot if needed; nullptr without a
+        // segment or if the key does not fit. Flags stay valid while the segment is mapped, so it is
+        // resolved once per rule when the config is loaded.
+        std::atomic<uint32>* FindFlag(std::string const& onceKey) const;
+
+        // Loads the database state. It only ever raises flags: a drop's kill phase write may still
+        // be in flight during a reload, and in the segment another process may hold a reservation
+        // the database does not show yet.
+        void Merge(std::unordered_map<std::string, bool> const& states);
+
+        LockContention GetContention() const { return _mutex.GetContention("gStateMutex"); }
+
+    private:
+        mutable ContentionMutex _mutex;
+        std::unordered_map<std::string, bool> _dropped;
+        std::atomic<OnceFlagSegment*> _segment{ nullptr };
+    };
+
+    // Items injected at kill time that have not been looted yet. The table is split into shards by a
+    // hash of the loot GUID, each with its own lock, records and counters on its own cache lines, so
+    // map threads killing and looting different corpses rarely meet. A shard's records live in a pool
+    // whose capacity survives Take and Clear, so once it has grown to its peak, remembering a drop
+    // does not allocate.
+    //
+    // Every loot event on the realm asks Take, and almost none are for an injected item. Each shard
+    // keeps a bitset over item entries, hashed into ITEM_FILTER_SLOTS, marking the entries it holds a
+    // drop for; a clear bit answers with one relaxed load and no lock. A loot event always comes long
+    // after the kill that set its bit, through the session and map update queues.
+    class PendingDropStore
+    {
+    public:
+        static constexpr uint32 SHARD_BITS = 5;
+        static constexpr uint32 SHARD_COUNT = 1 << SHARD_BITS;
+        static constexpr uint32 INITIAL_SHARD_CAPACITY = 16;
+        static constexpr uint32 ITEM_FILTER_SLOTS = 2048;
+
+        static PendingDropStore* instance();
+
+        void Remember(PendingInjectedDrop const& pending);
+        bool Take(ObjectGuid lootGuid, uint32 itemEntry, PendingInjectedDrop& out);
+        void Clear();
+
+        // Moves every drop injected before cutoff into expired. Each shard is swept under its own lock.
+        void Expire(uint32 cutoff, std::vector<PendingInjectedDrop>& expired);
+
+        bool MayHold(ObjectGuid lootGuid, uint32 itemEntry) const { return _shards[ShardIndex(lootGuid)].MayHold(itemEntry); }
+
+        // Lock-free, for the metrics exporter.
+        uint64 Size() const;
+
+        // Summed over the shards.
+        LockContention GetContention() const;
+
+    private:
+        struct alignas(64) Shard
+        {
+            Shard() { drops.reserve(INITIAL_SHARD_CAPACITY); }
+
+            bool MayHold(uint32 itemEntry) const
+            {
+                uint32 const slot = itemEntry % ITEM_FILTER_SLOTS;
+                return itemBits[slot / 64].load(std::memory_order_relaxed) & (uint64(1) << (slot % 64));
+            }
+
+            mutable ContentionMutex mutex;
+            std::vector<PendingInjectedDrop> drops;
+            std::atomic<uint64> count{ 0 };
+
+            // Drops held per filter slot, guarded by mutex; a slot's bit is set while it is nonzero.
+            std::array<uint32, ITEM_FILTER_SLOTS> itemCounts{};
+            std::array<std::atomic<uint64>, ITEM_FILTER_SLOTS / 64> itemBits{};
+        };
+
+        static uint32 ShardIndex(ObjectGuid lootGuid)
+        {
+            return static_cast<uint32>((lootGuid.GetRawValue() * 0x9E3779B97F4A7C15ULL) >> (64 - SHARD_BITS));
+        }
+
+        std::array<Shard, SHARD_COUNT> _shards;
+    };
+
+    // Rolls made for a creature before it dies, when it spawns or enters combat, so its kill only
+    // confirms once-state and injects. One word of hits covers up to MAX_VARIANTS variants; the
+    // generation ties it to the rule snapshot it was rolled with, and a kill under any other
+    // snapshot rolls afresh. Sharded by GUID like PendingDropStore.
+    struct PreRoll
+    {
+        uint32 generation = 0;  // RuleSet::generation
+        uint64 hits = 0;        // RollBatch hits of the creature's variant list
+    };
+
+    class PreRollStore
+    {
+    public:
+        static constexpr uint32 SHARD_BITS = 5;
+        static constexpr uint32 SHARD_COUNT = 1 << SHARD_BITS;
+        static constexpr uint32 MAX_VARIANTS = 64;
+
+        static PreRollStore* instance();
+
+        // Replaces any earlier roll for the creature.
+        void Store(ObjectGuid guid, PreRoll const& preRoll);
+        bool Take(ObjectGuid guid, PreRoll& out);
+        void Forget(ObjectGuid guid);
+        void Clear();
+
+        // Lock-free, for the metrics exporter.
+        uint64 Size() const;
+
+        LockContention GetContention() const;
+
+    private:
+        struct alignas(64) Shard
+        {
+            mutable ContentionMutex mutex;
+            std::unordered_map<uint64, PreRoll> rolls;
+            std::atomic<uint64> count{ 0 };
+        };
+
+        static uint32 ShardIndex(ObjectGuid guid)
+        {
+            return static_cast<uint32>((guid.GetRawValue() * 0x9E3779B97F4A7C15ULL) >> (64 - SHARD_BITS));
+        }
+
+        std::array<Shard, SHARD_COUNT> _shards;
+    };
+
+    // A once-per-character or once-per-account drop waiting to be written to the character database.
+    struct ScopedOnceWrite
+    {
+        OnceScope scope = OnceScope::Character;
+        uint32 ownerId = 0;     // character guid counter or account id
+        std::string onceKey;
+    };
+
+    // Once-per-character and once-per-account state for online players. Every onceKey is interned to
+    // a bit index that stays stable for the life of the process, and each character and account holds
+    // a bitset over those indices: one bit per key, a few machine words for hundreds of rules.
+    // Characters are loaded asynchronously at login and evicted at logout; until a character is
+    // loaded, every scoped rule counts as already dropped for it.
+    class ScopedOnceStore
+    {
+    public:
+        static ScopedOnceStore* instance();
+
+        uint32 Intern(std::string const& onceKey);
+
+        // Login registers the character (and holds its account); Load fills both in from the database.
+        void BeginLoad(uint32 characterId, uint32 accountId);
+        void Load(uint32 characterId, std::vector<std::string> const& characterKeys, std::vector<std::string> const& accountKeys);
+        void Evict(uint32 characterId);
+
+        bool IsDropped(uint32 characterId, OnceScope scope, uint32 bit) const;
+
+        // Sets the bit and queues the row. Returns false if it was already set or the character is not loaded.
+        bool Reserve(uint32 characterId, OnceScope scope, uint32 bit);
+
+        std::vector<ScopedOnceWrite> TakeWrites();
+
+        // Lock-free, for the metrics exporter.
+        uint64 LoadedCharacters() const { return _loadedCount.load(std::memory_order_relaxed); }
+
+        LockContention GetContention() const { return _mutex.GetContention("gScopedOnceMutex"); }
+
+    private:
+        using Bits = std::vector<uint64>;
+
+        // The bitsets are mutable so FindBits can serve IsDropped and Reserve alike; they are only
+        // ever read or written under _mutex.
+        struct CharacterState
+        {
+            uint32 accountId = 0;
+            bool loaded = false;
+            mutable Bits bits;
+        };
+
+        struct AccountState
+        {
+            uint32 characters = 0;
+            mutable Bits bits;
+        };
+
+        static bool TestBit(Bits const& bits, uint32 bit);
+        static void SetBit(Bits& bits, uint32 bit);
+        uint32 InternLocked(std::string const& onceKey);
+        Bits* FindBits(uint32 characterId, OnceScope scope) const;
+
+        mutable ContentionMutex _mutex;
+        std::unordered_map<std::string, uint32> _keyBits;
+        std::vector<std::string> _keyNames;
+        std::unordered_map<uint32, CharacterState> _characters;
+        std::unordered_map<uint32, AccountState> _accounts;
+        std::vector<ScopedOnceWrite> _writes;
+        std::atomic<uint64> _loadedCount{ 0 };
+    };
+
+    // A pity counter waiting to be written to the character database. Zero means the row can go.
+    struct PityWrite
+    {
+        uint32 characterId = 0;
+        std::string pityKey;
+        uint32 misses = 0;
+    };
+
+    // Failed-kill counters of online characters for rules with PityStep or PityGuarantee. Pity keys
+    // are interned like once keys, and each character holds one uint16 per key, so an update is an
+    // index into a vector. Changed counters are marked dirty and written in batches, and once more
+    // when the character logs out. Characters still loading roll the base chance untracked.
+    class PityStore
+    {
+    public:
+        static PityStore* instance();
+
+        uint32 Intern(std::string const& pityKey);
+
+        void BeginLoad(uint32 characterId);
+        void Load(uint32 characterId, std::vector<std::pair<std::string, uint32>> const& counters);
+
+        // Rolls against the curve at the character's counter without touching it. A hit can still
+        // be blocked by the quota, a duplicate or the once state, so the caller reports what really
+        // happened through Record.
+        bool Roll(uint32 characterId, uint32 pityId, std::vector<uint32> const& curve) const;
+
+        // Resets the counter once the item was injected, or bumps it after a miss. The key is shared
+        // by every difficulty, whose curves differ in length, so the counter runs up to MAX_PITY_STEPS
+        // and Roll clamps it to the curve at hand.
+        void Record(uint32 characterId, uint32 pityId, bool dropped);
+
+        std::vector<PityWrite> TakeWrites();
+
+        // Forgets the character and returns its unwritten counters, for the logout write.
+        std::vector<PityWrite> Evict(uint32 characterId);
+
+        // Lock-free, for the metrics exporter.
+        uint64 LoadedCharacters() const { return _loadedCount.load(std::memory_order_relaxed); }
+
+        LockContention GetContention() const { return _mutex.GetContention("gPityMutex"); }
+
+    private:
+        struct CharacterPity
+        {
+            bool loaded = false;
+            std::vector<uint16> misses;
+            std::vector<uint64> dirty;
+        };
+
+        uint32 InternLocked(std::string const& pityKey);
+        void AppendWrites(uint32 characterId, CharacterPity& pity, std::vector<PityWrite>& writes);
+
+        mutable ContentionMutex _mutex;
+        std::unordered_map<std::string, uint32> _keyIds;
+        std::vector<std::string> _keyNames;
+        std::unordered_map<uint32, CharacterPity> _characters;
+        std::unordered_set<uint32> _dirtyCharacters;
+        std::atomic<uint64> _loadedCount{ 0 };
+    };
+
+    // Token bucket behind a Quota rule. The kill path only touches the atomics, so a drop costs one
+    // decrement; everything else is guarded by the QuotaStore mutex.
+    struct QuotaBucket
+    {
+        std::atomic<int32> tokens{ 0 };
+        std::atomic<bool> dirty{ false };
+
+        std::string quotaKey;
+        uint32 capacity = 0;
+        std::time_t lastRefill = 0;
+        bool loaded = false;
+
+        bool HasToken() const { return tokens.load(std::memory_order_relaxed) > 0; }
+
+        // Takes a token. A kill that finds the bucket empty puts its decrement straight back.
+        bool TryTake()
+        {
+            if (tokens.fetch_sub(1, std::memory_order_acq_rel) > 0)
+            {
+                dirty.store(true, std::memory_order_relaxed);
+                return true;
+            }
+
+            tokens.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Returns a token taken by a drop that was then blocked by something else.
+        void Give()
+        {
+            tokens.fetch_add(1, std::memory_order_relaxed);
+            dirty.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    // A quota bucket waiting to be written to the world database.
+    struct QuotaWrite
+    {
+        std::string quotaKey;
+        int32 tokens = 0;
+        uint32 capacity = 0;
+        std::time_t lastRefill = 0;
+    };
+
+    // Server-wide quota buckets by quota key. Buckets are never freed, so rules can keep a plain
+    // pointer across reloads and the kill path never looks anything up.
+    class QuotaStore
+    {
+    public:
+        static QuotaStore* instance();
+
+        // Returns the bucket for the key, creating an empty one that is not loaded yet. A changed
+        // capacity clamps the tokens to it.
+        QuotaBucket* Bind(std::string const& quotaKey, uint32 capacity);
+
+        // Fills a bucket that is not loaded yet from its database row.
+        void Restore(QuotaBucket& bucket, int32 tokens, std::time_t lastRefill);
+
+        // Tops the bucket back up, at most once per wall-clock minute.
+        void Refill(QuotaBucket& bucket, std::time_t now);
+
+        std::vector<QuotaWrite> TakeWrites();
+
+        LockContention GetContention() const { return _mutex.GetContention("gQuotaMutex"); }
+
+    private:
+        mutable ContentionMutex _mutex;
+        std::unordered_map<std::string, std::unique_ptr<QuotaBucket>> _buckets;
+    };
+
+    // Corpses whose kill hook already ran, so group kill credit or a core that fires the hook more
+    // than once cannot re-roll the same corpse. GUIDs go into the current generation; once per window
+    // the older generation is dropped, so an entry is remembered for one to two windows.
+    class EvaluatedCorpseSet
+    {
+    public:
+        static EvaluatedCorpseSet* instance();
+
+        // Returns true the first time a corpse is seen, false on every repeat. Always true when disabled.
+        bool TryMark(ObjectGuid corpseGuid);
+
+        // Advances the window. Called from the world update loop.
+        void Update(uint32 diff);
+
+        // A window of 0 disables tracking.
+        void SetWindow(uint32 windowMs);
+        void Clear();
+
+        LockContention GetContention() const { return _mutex.GetContention("gCorpseMutex"); }
+
+    private:
+        mutable ContentionMutex _mutex;
+        std::unordered_set<uint64> _current;
+        std::unordered_set<uint64> _previous;
+        std::atomic<uint32> _windowMs{ 0 };
+        uint32 _elapsedMs = 0;
+    };
+}
+
+#define sBossLootOnceState BossLoot::OnceStateStore::instance()
+#define sBossLootPendingDrops BossLoot::PendingDropStore::instance()
+#define sBossLootPreRolls BossLoot::PreRollStore::instance()
+#define sBossLootEvaluatedCorpses BossLoot::EvaluatedCorpseSet::instance()
+#define sBossLootScopedOnce BossLoot::ScopedOnceStore::instance()
+#define sBossLootPity BossLoot::PityStore::instance()
+#define sBossLootQuota BossLoot::QuotaStore::instance()
+
+#endif
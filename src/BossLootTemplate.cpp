@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootTemplate.h"
+#include "Log.h"
+#include "ObjectMgr.h"
+#include "StringConvert.h"
+#include "Tokenize.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace BossLoot
+{
+    std::string GetCreatureName(uint32 entry)
+    {
+        if (CreatureTemplate const* creatureTemplate = sObjectMgr->GetCreatureTemplate(entry))
+            return creatureTemplate->Name;
+
+        return Acore::StringFormat("Creature {}", entry);
+    }
+
+    std::string GetItemName(uint32 entry)
+    {
+        if (ItemTemplate const* itemTemplate = sObjectMgr->GetItemTemplate(entry))
+            return itemTemplate->Name1;
+
+        return Acore::StringFormat("Item {}", entry);
+    }
+
+    std::string Trim(std::string value)
+    {
+        auto notSpace = [](unsigned char ch) { return !std::isspace(ch); };
+
+        value.erase(value.begin(), std::find_if(value.begin(), value.end(), notSpace));
+        value.erase(std::find_if(value.rbegin(), value.rend(), notSpace).base(), value.end());
+
+        return value;
+    }
+
+    std::string SqlSafe(std::string value, std::size_t maxLen)
+    {
+        if (value.size() > maxLen)
+            value.resize(maxLen);
+
+        for (char& ch : value)
+        {
+            if (ch == '\'' || ch == '"' || ch == '\\' || ch == '`')
+                ch = '_';
+        }
+
+        return value;
+    }
+
+    void ReplaceAll(std::string& text, std::string const& from, std::string const& to)
+    {
+        if (from.empty())
+            return;
+
+        std::size_t pos = 0;
+        while ((pos = text.find(from, pos)) != std::string::npos)
+        {
+            text.replace(pos, from.length(), to);
+            pos += to.length();
+        }
+    }
+
+    std::vector<std::pair<uint32, uint32>> ParseEntryPairs(std::string const& text, std::string const& settingName)
+    {
+        std::vector<std::pair<uint32, uint32>> pairs;
+
+        for (std::string_view token : Acore::Tokenize(text, ',', false))
+        {
+            std::string const pair = Trim(std::string(token));
+            if (pair.empty())
+                continue;
+
+            std::size_t const colon = pair.find(':');
+            Optional<uint32> first = colon != std::string::npos ? Acore::StringTo<uint32>(Trim(pair.substr(0, colon))) : std::nullopt;
+            Optional<uint32> second = colon != std::string::npos ? Acore::StringTo<uint32>(Trim(pair.substr(colon + 1))) : std::nullopt;
+
+            if (!first || !second)
+            {
+                LOG_ERROR("module", "[BossLoot] {}: ignoring malformed entry '{}', expected number:number.", settingName, pair);
+                continue;
+            }
+
+            pairs.emplace_back(*first, *second);
+        }
+
+        return pairs;
+    }
+
+    std::vector<std::pair<uint32, uint32>> ParseEntryRanges(std::string const& text, std::string const& settingName)
+    {
+        std::vector<std::pair<uint32, uint32>> ranges;
+
+        for (std::string_view token : Acore::Tokenize(text, ',', false))
+        {
+            std::string const range = Trim(std::string(token));
+            if (range.empty())
+                continue;
+
+            std::size_t const dash = range.find('-');
+            Optional<uint32> low = Acore::StringTo<uint32>(Trim(range.substr(0, dash)));
+            Optional<uint32> high = dash != std::string::npos ? Acore::StringTo<uint32>(Trim(range.substr(dash + 1))) : low;
+
+            if (!low || !high)
+            {
+                LOG_ERROR("module", "[BossLoot] {}: ignoring malformed entry '{}', expected number or number-number.", settingName, range);
+                continue;
+            }
+
+            ranges.emplace_back(std::min(*low, *high), std::max(*low, *high));
+        }
+
+        return ranges;
+    }
+
+    std::string RenderAnnounceMessage(std::string const& format, AnnounceContext const& context)
+    {
+        std::string message = format.empty() ? std::string(DEFAULT_ANNOUNCE_MESSAGE) : format;
+
+        ReplaceAll(message, "{player}", std::string(context.player));
+        ReplaceAll(message, "{boss}", std::string(context.boss));
+        ReplaceAll(message, "{item}", std::string(context.item));
+        ReplaceAll(message, "{itemEntry}", std::to_string(context.itemEntry));
+        ReplaceAll(message, "{npcEntry}", std::to_string(context.npcEntry));
+        ReplaceAll(message, "{count}", std::to_string(context.count));
+
+        return message;
+    }
+}
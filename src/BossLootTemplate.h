@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_TEMPLATE_H
+#define MOD_BOSSLOOT_TEMPLATE_H
+
+#include "Define.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace BossLoot
+{
+    constexpr char const* DEFAULT_ANNOUNCE_MESSAGE = "{player} has looted {item} from {boss}!";
+
+    // Values substituted into an AnnounceMessage. The views must outlive the RenderAnnounceMessage call.
+    struct AnnounceContext
+    {
+        std::string_view player;
+        std::string_view boss;
+        std::string_view item;
+        uint32 itemEntry = 0;
+        uint32 npcEntry = 0;
+        uint32 count = 0;
+    };
+
+    // Template names, or "Creature N" / "Item N" when the entry is unknown.
+    std::string GetCreatureName(uint32 entry);
+    std::string GetItemName(uint32 entry);
+
+    std::string Trim(std::string value);
+    std::string SqlSafe(std::string value, std::size_t maxLen);
+    void ReplaceAll(std::string& text, std::string const& from, std::string const& to);
+
+    // Parses "a:b, a:b ..." lists such as Pool and KillProfile. Malformed pairs are logged against
+    // settingName and skipped.
+    std::vector<std::pair<uint32, uint32>> ParseEntryPairs(std::string const& text, std::string const& settingName);
+
+    // Parses "a, b-c, d ..." into inclusive [low, high] ranges; a single number is a range of one.
+    // Malformed tokens are logged against settingName and skipped.
+    std::vector<std::pair<uint32, uint32>> ParseEntryRanges(std::string const& text, std::string const& settingName);
+
+    // Expands {player}, {boss}, {item}, {itemEntry}, {npcEntry} and {count}. An empty format falls
+    // back to DEFAULT_ANNOUNCE_MESSAGE.
+    std::string RenderAnnounceMessage(std::string const& format, AnnounceContext const& context);
+}
+
+#endif
@@ -1,822 +1,864 @@
-/*
- * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
- * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
- *
- * Configurable Boss Loot
- *
- * Expanded from the original mod_talisman_of_binding_shard behavior.
- * This module allows server owners to inject arbitrary item drops into arbitrary creature corpse loot.
- *
- * Features:
- * - Multiple independent loot rules.
- * - Any creature entry can drop any item entry.
- * - Per-rule chance percentage.
- * - Per-rule stack/count range.
- * - Per-rule once-per-server lockout, or repeatable behavior.
- * - Optional duplicate prevention.
- * - Optional global announcement when the injected item is looted.
- * - Backward-compatible fallback to the old GeddonShard.* config keys when BossLoot.RuleCount = 0.
- */
-
-#include "ScriptMgr.h"
-#include "Config.h"
-#include "Creature.h"
-#include "GameObject.h"
-#include "Item.h"
-#include "Player.h"
-#include "World.h"
-#include "ObjectMgr.h"
-#include "ObjectAccessor.h"
-#include "DatabaseEnv.h"
-#include "Log.h"
-#include "LootMgr.h"
-#include "Chat.h"
-#include "WorldSessionMgr.h"
-
-#include <algorithm>
-#include <cctype>
-#include <ctime>
-#include <mutex>
-#include <string>
-#include <unordered_map>
-#include <vector>
-
-namespace
-{
-    // Original module defaults
-    static constexpr uint32 NPC_BARON_GEDDON = 12056;
-    static constexpr uint32 ITEM_TALISMAN = 17782;
-
-    static constexpr char const* CONF_ENABLE = "BossLoot.Enable";
-    static constexpr char const* CONF_RULE_COUNT = "BossLoot.RuleCount";
-    static constexpr char const* CONF_RESET_ALL_ON_STARTUP = "BossLoot.ResetOnStartup";
-
-    static constexpr char const* LEGACY_CONF_ENABLE = "GeddonShard.Enable";
-    static constexpr char const* LEGACY_CONF_NPC_ENTRY = "GeddonShard.NpcEntry";
-    static constexpr char const* LEGACY_CONF_CHANCE = "GeddonShard.Chance";
-    static constexpr char const* LEGACY_CONF_ALLOW_REPEAT = "GeddonShard.AllowRepeat";
-    static constexpr char const* LEGACY_CONF_RESET = "GeddonShard.ResetOnStartup";
-
-    static constexpr char const* TABLE_NAME = "mod_configurable_boss_loot_once";
-    static constexpr char const* LEGACY_TABLE_NAME = "mod_geddon_once_drop";
-    static constexpr char const* LEGACY_KEY_NAME = "geddon_17782_once";
-
-    struct BossLootRule
-    {
-        uint32 index = 0;
-        bool enable = true;
-        uint32 npcEntry = 0;
-        uint32 itemEntry = 0;
-        double chancePct = 0.0;
-        uint32 minCount = 1;
-        uint32 maxCount = 1;
-        bool allowRepeat = true;
-        bool preventDuplicate = true;
-        bool resetOnStart = false;
-        bool announce = false;
-        std::string onceKey;
-        std::string announceMessage;
-    };
-
-    struct PendingInjectedDrop
-    {
-        ObjectGuid lootGuid;
-        std::string onceKey;
-        uint32 npcEntry = 0;
-        uint32 itemEntry = 0;
-        bool allowRepeat = true;
-        bool announce = false;
-        std::string bossName;
-        std::string announceMessage;
-    };
-
-    static bool gEnabled = true;
-    static std::vector<BossLootRule> gRules;
-
-    // onceKey -> dropped
-    static std::unordered_map<std::string, bool> gDroppedState;
-
-    static std::vector<PendingInjectedDrop> gPendingDrops;
-
-    static std::mutex gConfigMutex;
-    static std::mutex gStateMutex;
-    static std::mutex gPendingMutex;
-    static std::mutex gDbMutex;
-
-    std::string ConfigKey(uint32 index, char const* leaf)
-    {
-        return Acore::StringFormat("BossLoot.Rule.{}.{}", index, leaf);
-    }
-
-    std::string SqlSafe(std::string value, std::size_t maxLen)
-    {
-        if (value.size() > maxLen)
-            value.resize(maxLen);
-
-        for (char& ch : value)
-        {
-            if (ch == '\'' || ch == '"' || ch == '\\' || ch == '`')
-                ch = '_';
-        }
-
-        return value;
-    }
-
-    std::string Trim(std::string value)
-    {
-        auto notSpace = [](unsigned char ch) { return !std::isspace(ch); };
-
-        value.erase(value.begin(), std::find_if(value.begin(), value.end(), notSpace));
-        value.erase(std::find_if(value.rbegin(), value.rend(), notSpace).base(), value.end());
-
-        return value;
-    }
-
-    void ReplaceAll(std::string& text, std::string const& from, std::string const& to)
-    {
-        if (from.empty())
-            return;
-
-        std::size_t pos = 0;
-        while ((pos = text.find(from, pos)) != std::string::npos)
-        {
-            text.replace(pos, from.length(), to);
-            pos += to.length();
-        }
-    }
-
-    double ClampChance(double value)
-    {
-        if (value < 0.0)
-            return 0.0;
-
-        if (value > 100.0)
-            return 100.0;
-
-        return value;
-    }
-
-    std::string MakeAutoOnceKey(uint32 ruleIndex, uint32 npcEntry, uint32 itemEntry)
-    {
-        return Acore::StringFormat("bossloot_rule{}_npc{}_item{}", ruleIndex, npcEntry, itemEntry);
-    }
-
-    std::string GetCreatureName(uint32 entry)
-    {
-        if (CreatureTemplate const* creatureTemplate = sObjectMgr->GetCreatureTemplate(entry))
-            return creatureTemplate->Name;
-
-        return Acore::StringFormat("Creature {}", entry);
-    }
-
-    std::string GetItemName(uint32 entry)
-    {
-        if (ItemTemplate const* itemTemplate = sObjectMgr->GetItemTemplate(entry))
-            return itemTemplate->Name1;
-
-        return Acore::StringFormat("Item {}", entry);
-    }
-
-    std::string GetLootSourceName(Player* player, ObjectGuid lootGuid, uint32 fallbackNpcEntry)
-    {
-        if (player)
-        {
-            if (lootGuid.IsCreature())
-            {
-                if (Creature* creature = ObjectAccessor::GetCreature(*player, lootGuid))
-                    return creature->GetName();
-            }
-            else if (lootGuid.IsGameObject())
-            {
-                if (GameObject* gameObject = ObjectAccessor::GetGameObject(*player, lootGuid))
-                    return gameObject->GetName();
-            }
-        }
-
-        return GetCreatureName(fallbackNpcEntry);
-    }
-
-    std::vector<BossLootRule> GetRulesSnapshot(bool& enabled)
-    {
-        std::lock_guard<std::mutex> guard(gConfigMutex);
-        enabled = gEnabled;
-        return gRules;
-    }
-
-    bool IsAlreadyDropped(std::string const& onceKey)
-    {
-        std::lock_guard<std::mutex> guard(gStateMutex);
-
-        auto itr = gDroppedState.find(onceKey);
-        return itr != gDroppedState.end() && itr->second;
-    }
-
-    bool ReserveOnceDrop(std::string const& onceKey)
-    {
-        std::lock_guard<std::mutex> guard(gStateMutex);
-
-        bool& dropped = gDroppedState[onceKey];
-        if (dropped)
-            return false;
-
-        dropped = true;
-        return true;
-    }
-
-    void MarkDroppedInMemory(std::string const& onceKey, bool dropped)
-    {
-        std::lock_guard<std::mutex> guard(gStateMutex);
-        gDroppedState[onceKey] = dropped;
-    }
-
-    bool RollDrop(double chancePct)
-    {
-        chancePct = ClampChance(chancePct);
-
-        if (chancePct <= 0.0)
-            return false;
-
-        if (chancePct >= 100.0)
-            return true;
-
-        // 100.0000% precision. This keeps tiny legendary rates sane without floating weirdness.
-        uint32 constexpr scale = 1000000;
-        uint32 const roll = urand(1, scale);
-        uint32 const need = static_cast<uint32>((chancePct / 100.0) * static_cast<double>(scale) + 0.5);
-
-        return roll <= need;
-    }
-
-    inline LootStoreItem MakeLootStoreItem(uint32 itemId, uint32 minCount, uint32 maxCount)
-    {
-        return LootStoreItem(itemId,
-            /*reference*/0,
-            /*chance*/100.0f,
-            /*needs_quest*/false,
-            /*lootmode*/LOOT_MODE_DEFAULT,
-            /*groupid*/0,
-            /*mincount*/minCount,
-            /*maxcount*/maxCount);
-    }
-
-    void AddItemToLoot(Loot* loot, uint32 itemId, uint32 minCount, uint32 maxCount)
-    {
-        if (!loot)
-            return;
-
-        loot->AddItem(MakeLootStoreItem(itemId, minCount, maxCount));
-    }
-
-    bool LootHasItem(Loot* loot, uint32 itemId)
-    {
-        if (!loot)
-            return false;
-
-        for (auto const& lootItem : loot->items)
-        {
-            if (lootItem.itemid == itemId)
-                return true;
-        }
-
-        for (auto const& lootItem : loot->quest_items)
-        {
-            if (lootItem.itemid == itemId)
-                return true;
-        }
-
-        return false;
-    }
-
-    void RememberPendingDrop(Creature* killed, BossLootRule const& rule)
-    {
-        if (!killed)
-            return;
-
-        PendingInjectedDrop pending;
-        pending.lootGuid = killed->GetGUID();
-        pending.onceKey = rule.onceKey;
-        pending.npcEntry = rule.npcEntry;
-        pending.itemEntry = rule.itemEntry;
-        pending.allowRepeat = rule.allowRepeat;
-        pending.announce = rule.announce;
-        pending.bossName = killed->GetName();
-        pending.announceMessage = rule.announceMessage;
-
-        std::lock_guard<std::mutex> guard(gPendingMutex);
-        gPendingDrops.push_back(pending);
-    }
-
-    bool TakePendingDrop(ObjectGuid lootGuid, uint32 itemEntry, PendingInjectedDrop& out)
-    {
-        std::lock_guard<std::mutex> guard(gPendingMutex);
-
-        auto itr = std::find_if(gPendingDrops.begin(), gPendingDrops.end(),
-            [&](PendingInjectedDrop const& pending)
-            {
-                return pending.lootGuid == lootGuid && pending.itemEntry == itemEntry;
-            });
-
-        if (itr == gPendingDrops.end())
-            return false;
-
-        out = *itr;
-        gPendingDrops.erase(itr);
-        return true;
-    }
-
-    void ClearPendingDrops()
-    {
-        std::lock_guard<std::mutex> guard(gPendingMutex);
-        gPendingDrops.clear();
-    }
-
-    // Database persistence
-    void EnsureTable()
-    {
-        std::lock_guard<std::mutex> guard(gDbMutex);
-
-        WorldDatabase.DirectExecute(
-            "CREATE TABLE IF NOT EXISTS `mod_configurable_boss_loot_once` ("
-            "  `keyname`        VARCHAR(191)     NOT NULL,"
-            "  `dropped`        TINYINT(1)       NOT NULL DEFAULT 0,"
-            "  `last_drop_time` BIGINT UNSIGNED  NOT NULL DEFAULT 0,"
-            "  `last_killer`    VARCHAR(64)               DEFAULT NULL,"
-            "  `last_looter`    VARCHAR(64)               DEFAULT NULL,"
-            "  `npc_entry`      INT UNSIGNED     NOT NULL DEFAULT 0,"
-            "  `item_entry`     INT UNSIGNED     NOT NULL DEFAULT 0,"
-            "  PRIMARY KEY (`keyname`)"
-            ") ENGINE=InnoDB DEFAULT CHARSET=utf8"
-        );
-    }
-
-    void EnsureRowsForRules(std::vector<BossLootRule> const& rules)
-    {
-        std::lock_guard<std::mutex> guard(gDbMutex);
-
-        for (BossLootRule const& rule : rules)
-        {
-            if (!rule.enable || rule.allowRepeat || rule.onceKey.empty())
-                continue;
-
-            std::string const key = SqlSafe(rule.onceKey, 191);
-
-            WorldDatabase.DirectExecute(
-                Acore::StringFormat(
-                    "INSERT IGNORE INTO `{}` (`keyname`, `dropped`, `last_drop_time`, `last_killer`, `last_looter`, `npc_entry`, `item_entry`) "
-                    "VALUES ('{}', 0, 0, NULL, NULL, {}, {})",
-                    TABLE_NAME, key, rule.npcEntry, rule.itemEntry
-                ).c_str()
-            );
-
-            WorldDatabase.DirectExecute(
-                Acore::StringFormat(
-                    "UPDATE `{}` SET `npc_entry`={}, `item_entry`={} WHERE `keyname`='{}'",
-                    TABLE_NAME, rule.npcEntry, rule.itemEntry, key
-                ).c_str()
-            );
-        }
-    }
-
-    void ResetStatesForRules(std::vector<BossLootRule> const& rules, bool resetAll)
-    {
-        std::lock_guard<std::mutex> guard(gDbMutex);
-
-        for (BossLootRule const& rule : rules)
-        {
-            if (!rule.enable || rule.allowRepeat || rule.onceKey.empty())
-                continue;
-
-            if (!resetAll && !rule.resetOnStart)
-                continue;
-
-            std::string const key = SqlSafe(rule.onceKey, 191);
-
-            WorldDatabase.DirectExecute(
-                Acore::StringFormat(
-                    "UPDATE `{}` SET `dropped`=0, `last_drop_time`=0, `last_killer`=NULL, `last_looter`=NULL WHERE `keyname`='{}'",
-                    TABLE_NAME, key
-                ).c_str()
-            );
-
-            MarkDroppedInMemory(rule.onceKey, false);
-
-            LOG_INFO("module", "[BossLoot] ResetOnStartup cleared once-drop state for key '{}'.", rule.onceKey);
-        }
-    }
-
-    void MigrateLegacyGeddonStateIfNeeded(std::vector<BossLootRule> const& rules)
-    {
-        bool hasLegacyKeyRule = false;
-        for (BossLootRule const& rule : rules)
-        {
-            if (rule.enable && !rule.allowRepeat && rule.onceKey == LEGACY_KEY_NAME)
-            {
-                hasLegacyKeyRule = true;
-                break;
-            }
-        }
-
-        if (!hasLegacyKeyRule)
-            return;
-
-        QueryResult tableExists = WorldDatabase.Query(Acore::StringFormat("SHOW TABLES LIKE '{}'", LEGACY_TABLE_NAME).c_str());
-        if (!tableExists)
-            return;
-
-        QueryResult legacyState = WorldDatabase.Query(
-            Acore::StringFormat("SELECT `dropped`, `last_drop_time`, `last_killer` FROM `{}` WHERE `keyname`='{}' LIMIT 1", LEGACY_TABLE_NAME, LEGACY_KEY_NAME).c_str());
-
-        if (!legacyState)
-            return;
-
-        Field* fields = legacyState->Fetch();
-        bool const dropped = fields[0].Get<uint8>() != 0;
-        if (!dropped)
-            return;
-
-        uint64 const lastDropTime = fields[1].Get<uint64>();
-        std::string lastKiller;
-        if (!fields[2].IsNull())
-            lastKiller = SqlSafe(fields[2].Get<std::string>(), 64);
-
-        std::lock_guard<std::mutex> guard(gDbMutex);
-
-        if (lastKiller.empty())
-        {
-            WorldDatabase.DirectExecute(
-                Acore::StringFormat(
-                    "UPDATE `{}` SET `dropped`=1, `last_drop_time`={} WHERE `keyname`='{}' AND `dropped`=0",
-                    TABLE_NAME, lastDropTime, LEGACY_KEY_NAME
-                ).c_str()
-            );
-        }
-        else
-        {
-            WorldDatabase.DirectExecute(
-                Acore::StringFormat(
-                    "UPDATE `{}` SET `dropped`=1, `last_drop_time`={}, `last_killer`='{}' WHERE `keyname`='{}' AND `dropped`=0",
-                    TABLE_NAME, lastDropTime, lastKiller, LEGACY_KEY_NAME
-                ).c_str()
-            );
-        }
-    }
-
-    std::unordered_map<std::string, bool> LoadDroppedStatesForRules(std::vector<BossLootRule> const& rules)
-    {
-        std::unordered_map<std::string, bool> states;
-
-        std::lock_guard<std::mutex> guard(gDbMutex);
-
-        for (BossLootRule const& rule : rules)
-        {
-            if (!rule.enable || rule.allowRepeat || rule.onceKey.empty())
-                continue;
-
-            std::string const key = SqlSafe(rule.onceKey, 191);
-            bool dropped = false;
-
-            if (QueryResult result = WorldDatabase.Query(
-                Acore::StringFormat("SELECT `dropped` FROM `{}` WHERE `keyname`='{}' LIMIT 1", TABLE_NAME, key).c_str()))
-            {
-                Field* fields = result->Fetch();
-                dropped = fields[0].Get<uint8>() != 0;
-            }
-
-            states[rule.onceKey] = dropped;
-        }
-
-        return states;
-    }
-
-    void PersistDroppedKillPhase(BossLootRule const& rule, Player* killer)
-    {
-        if (rule.allowRepeat || rule.onceKey.empty())
-            return;
-
-        uint64 const now = static_cast<uint64>(std::time(nullptr));
-        std::string killerName = killer ? killer->GetName() : std::string();
-        killerName = SqlSafe(killerName, 64);
-
-        std::string const key = SqlSafe(rule.onceKey, 191);
-
-        std::lock_guard<std::mutex> guard(gDbMutex);
-
-        if (killerName.empty())
-        {
-            WorldDatabase.DirectExecute(
-                Acore::StringFormat(
-                    "UPDATE `{}` SET `dropped`=1, `last_drop_time`={}, `last_killer`=NULL, `npc_entry`={}, `item_entry`={} WHERE `keyname`='{}'",
-                    TABLE_NAME, now, rule.npcEntry, rule.itemEntry, key
-                ).c_str()
-            );
-        }
-        else
-        {
-            WorldDatabase.DirectExecute(
-                Acore::StringFormat(
-                    "UPDATE `{}` SET `dropped`=1, `last_drop_time`={}, `last_killer`='{}', `npc_entry`={}, `item_entry`={} WHERE `keyname`='{}'",
-                    TABLE_NAME, now, killerName, rule.npcEntry, rule.itemEntry, key
-                ).c_str()
-            );
-        }
-    }
-
-    void PersistDroppedLootPhase(PendingInjectedDrop const& pending, Player* looter)
-    {
-        if (pending.allowRepeat || pending.onceKey.empty() || !looter)
-            return;
-
-        uint64 const now = static_cast<uint64>(std::time(nullptr));
-        std::string looterName = SqlSafe(looter->GetName(), 64);
-        std::string const key = SqlSafe(pending.onceKey, 191);
-
-        std::lock_guard<std::mutex> guard(gDbMutex);
-
-        WorldDatabase.DirectExecute(
-            Acore::StringFormat(
-                "UPDATE `{}` SET `last_drop_time`={}, `last_looter`='{}', `npc_entry`={}, `item_entry`={} WHERE `keyname`='{}'",
-                TABLE_NAME, now, looterName, pending.npcEntry, pending.itemEntry, key
-            ).c_str()
-        );
-    }
-
-    // Config loading
-    BossLootRule LoadConfiguredRule(uint32 index)
-    {
-        BossLootRule rule;
-        rule.index = index;
-        rule.enable = sConfigMgr->GetOption<bool>(ConfigKey(index, "Enable"), true);
-        rule.npcEntry = sConfigMgr->GetOption<uint32>(ConfigKey(index, "NpcEntry"), 0);
-        rule.itemEntry = sConfigMgr->GetOption<uint32>(ConfigKey(index, "ItemEntry"), 0);
-        rule.chancePct = ClampChance(sConfigMgr->GetOption<float>(ConfigKey(index, "Chance"), 0.0f));
-        rule.minCount = sConfigMgr->GetOption<uint32>(ConfigKey(index, "MinCount"), 1);
-        rule.maxCount = sConfigMgr->GetOption<uint32>(ConfigKey(index, "MaxCount"), 1);
-        rule.allowRepeat = sConfigMgr->GetOption<bool>(ConfigKey(index, "AllowRepeat"), true);
-        rule.preventDuplicate = sConfigMgr->GetOption<bool>(ConfigKey(index, "PreventDuplicate"), true);
-        rule.resetOnStart = sConfigMgr->GetOption<bool>(ConfigKey(index, "ResetOnStartup"), false);
-        rule.announce = sConfigMgr->GetOption<bool>(ConfigKey(index, "Announce"), false);
-        rule.onceKey = Trim(sConfigMgr->GetOption<std::string>(ConfigKey(index, "OnceKey"), ""));
-        rule.announceMessage = sConfigMgr->GetOption<std::string>(ConfigKey(index, "AnnounceMessage"), "{player} has looted {item} from {boss}!");
-
-        if (rule.minCount == 0)
-            rule.minCount = 1;
-
-        if (rule.maxCount == 0)
-            rule.maxCount = 1;
-
-        if (rule.maxCount < rule.minCount)
-            std::swap(rule.minCount, rule.maxCount);
-
-        if (!rule.allowRepeat && rule.onceKey.empty())
-            rule.onceKey = MakeAutoOnceKey(index, rule.npcEntry, rule.itemEntry);
-
-        return rule;
-    }
-
-    BossLootRule LoadLegacyRule()
-    {
-        BossLootRule rule;
-        rule.index = 1;
-        rule.enable = sConfigMgr->GetOption<bool>(LEGACY_CONF_ENABLE, true);
-        rule.npcEntry = sConfigMgr->GetOption<uint32>(LEGACY_CONF_NPC_ENTRY, NPC_BARON_GEDDON);
-        rule.itemEntry = ITEM_TALISMAN;
-        rule.chancePct = ClampChance(sConfigMgr->GetOption<float>(LEGACY_CONF_CHANCE, 1.0f));
-        rule.minCount = 1;
-        rule.maxCount = 1;
-        rule.allowRepeat = sConfigMgr->GetOption<bool>(LEGACY_CONF_ALLOW_REPEAT, false);
-        rule.preventDuplicate = true;
-        rule.resetOnStart = sConfigMgr->GetOption<bool>(LEGACY_CONF_RESET, false);
-        rule.announce = true;
-        rule.onceKey = LEGACY_KEY_NAME;
-        rule.announceMessage = "{player} has looted the legendary {item} from {boss}!";
-
-        if (rule.npcEntry == 0)
-            rule.npcEntry = NPC_BARON_GEDDON;
-
-        return rule;
-    }
-
-    std::vector<BossLootRule> LoadRulesFromConfig(bool& enabled, bool& resetAllOnStartup)
-    {
-        enabled = sConfigMgr->GetOption<bool>(CONF_ENABLE, true);
-        resetAllOnStartup = sConfigMgr->GetOption<bool>(CONF_RESET_ALL_ON_STARTUP, false);
-
-        uint32 ruleCount = sConfigMgr->GetOption<uint32>(CONF_RULE_COUNT, 0);
-        std::vector<BossLootRule> rules;
-
-        if (ruleCount == 0)
-        {
-            // Backward compatible mode: if the owner has not opted into BossLoot.Rule.*,
-            // the old GeddonShard.* config still behaves like before.
-            enabled = sConfigMgr->GetOption<bool>(LEGACY_CONF_ENABLE, true);
-            rules.push_back(LoadLegacyRule());
-            return rules;
-        }
-
-        // Hard cap prevents an accidental silly config from making startup unpleasant.
-        if (ruleCount > 256)
-        {
-            LOG_WARN("module", "[BossLoot] BossLoot.RuleCount={} is excessive. Clamping to 256 rules.", ruleCount);
-            ruleCount = 256;
-        }
-
-        rules.reserve(ruleCount);
-
-        for (uint32 i = 1; i <= ruleCount; ++i)
-        {
-            BossLootRule rule = LoadConfiguredRule(i);
-
-            if (rule.enable && (rule.npcEntry == 0 || rule.itemEntry == 0))
-            {
-                LOG_WARN("module", "[BossLoot] Skipping active rule {} because NpcEntry or ItemEntry is 0.", i);
-                continue;
-            }
-
-            rules.push_back(rule);
-        }
-
-        return rules;
-    }
-
-    void AnnounceDrop(Player* looter, PendingInjectedDrop const& pending, ObjectGuid lootGuid, uint32 count)
-    {
-        if (!pending.announce)
-            return;
-
-        std::string playerName = looter ? looter->GetName() : std::string("Someone");
-        std::string bossName = pending.bossName.empty() ? GetLootSourceName(looter, lootGuid, pending.npcEntry) : pending.bossName;
-        std::string itemName = GetItemName(pending.itemEntry);
-
-        std::string message = pending.announceMessage.empty()
-            ? std::string("{player} has looted {item} from {boss}!")
-            : pending.announceMessage;
-
-        ReplaceAll(message, "{player}", playerName);
-        ReplaceAll(message, "{boss}", bossName);
-        ReplaceAll(message, "{item}", itemName);
-        ReplaceAll(message, "{itemEntry}", std::to_string(pending.itemEntry));
-        ReplaceAll(message, "{npcEntry}", std::to_string(pending.npcEntry));
-        ReplaceAll(message, "{count}", std::to_string(count));
-
-        WorldPacket data;
-        ChatHandler::BuildChatPacket(
-            data,
-            CHAT_MSG_SYSTEM,
-            LANG_UNIVERSAL,
-            nullptr,
-            nullptr,
-            message
-        );
-
-        sWorldSessionMgr->SendGlobalMessage(&data);
-    }
-}
-
-class ConfigurableBossLoot_World : public WorldScript
-{
-public:
-    ConfigurableBossLoot_World() : WorldScript("ConfigurableBossLoot_World") { }
-
-    void OnAfterConfigLoad(bool reload) override
-    {
-        bool enabled = true;
-        bool resetAllOnStartup = false;
-        std::vector<BossLootRule> rules = LoadRulesFromConfig(enabled, resetAllOnStartup);
-
-        EnsureTable();
-        EnsureRowsForRules(rules);
-
-        // Treat ResetOnStartup literally: reset only on startup, not on .reload config.
-        if (!reload)
-            ResetStatesForRules(rules, resetAllOnStartup);
-
-        MigrateLegacyGeddonStateIfNeeded(rules);
-
-        std::unordered_map<std::string, bool> loadedStates = LoadDroppedStatesForRules(rules);
-
-        {
-            std::lock_guard<std::mutex> guard(gConfigMutex);
-            gEnabled = enabled;
-            gRules = rules;
-        }
-
-        {
-            std::lock_guard<std::mutex> guard(gStateMutex);
-            gDroppedState = loadedStates;
-        }
-
-        ClearPendingDrops();
-
-        LOG_INFO("module", "[BossLoot] Enable={} RulesLoaded={} ResetAllOnStartup={} Reload={}",
-            uint32(enabled), uint32(rules.size()), uint32(resetAllOnStartup), uint32(reload));
-
-        for (BossLootRule const& rule : rules)
-        {
-            bool const alreadyDropped = !rule.allowRepeat && IsAlreadyDropped(rule.onceKey);
-
-            LOG_INFO("module",
-                "[BossLoot] Rule {} Enable={} NPC={}({}) Item={}({}) Chance={:.4f}% Count={}..{} AllowRepeat={} PreventDuplicate={} OnceKey='{}' AlreadyDropped={} Announce={}",
-                rule.index,
-                uint32(rule.enable),
-                rule.npcEntry,
-                GetCreatureName(rule.npcEntry),
-                rule.itemEntry,
-                GetItemName(rule.itemEntry),
-                rule.chancePct,
-                rule.minCount,
-                rule.maxCount,
-                uint32(rule.allowRepeat),
-                uint32(rule.preventDuplicate),
-                rule.onceKey,
-                uint32(alreadyDropped),
-                uint32(rule.announce));
-        }
-    }
-};
-
-class ConfigurableBossLoot_Player : public PlayerScript
-{
-public:
-    ConfigurableBossLoot_Player() : PlayerScript("ConfigurableBossLoot_Player") { }
-
-    void OnPlayerCreatureKill(Player* killer, Creature* killed) override
-    {
-        if (!killer || !killed)
-            return;
-
-        bool enabled = true;
-        std::vector<BossLootRule> rules = GetRulesSnapshot(enabled);
-
-        if (!enabled || rules.empty())
-            return;
-
-        uint32 const killedEntry = killed->GetEntry();
-
-        for (BossLootRule const& rule : rules)
-        {
-            if (!rule.enable)
-                continue;
-
-            if (rule.npcEntry != killedEntry)
-                continue;
-
-            if (rule.preventDuplicate && LootHasItem(&killed->loot, rule.itemEntry))
-            {
-                LOG_DEBUG("module", "[BossLoot] Rule {} skipped: {} already has item {} in corpse loot.",
-                    rule.index, killed->GetName().c_str(), rule.itemEntry);
-                continue;
-            }
-
-            if (!rule.allowRepeat && IsAlreadyDropped(rule.onceKey))
-                continue;
-
-            if (!RollDrop(rule.chancePct))
-                continue;
-
-            // Reserve before adding to loot so two simultaneous kills cannot both win the same once-per-server rule.
-            if (!rule.allowRepeat && !ReserveOnceDrop(rule.onceKey))
-                continue;
-
-            AddItemToLoot(&killed->loot, rule.itemEntry, rule.minCount, rule.maxCount);
-            RememberPendingDrop(killed, rule);
-            PersistDroppedKillPhase(rule, killer);
-
-            LOG_INFO("module", "[BossLoot] Rule {} added item {} x{}..{} to {} ({}) corpse loot{}.",
-                rule.index,
-                rule.itemEntry,
-                rule.minCount,
-                rule.maxCount,
-                killed->GetName().c_str(),
-                killedEntry,
-                rule.allowRepeat ? "" : Acore::StringFormat(" [onceKey='{}']", rule.onceKey).c_str());
-        }
-    }
-
-    void OnPlayerLootItem(Player* looter, Item* item, uint32 count, ObjectGuid lootGuid) override
-    {
-        if (!looter || !item)
-            return;
-
-        bool enabled = true;
-        {
-            std::lock_guard<std::mutex> guard(gConfigMutex);
-            enabled = gEnabled;
-        }
-
-        if (!enabled)
-            return;
-
-        PendingInjectedDrop pending;
-        if (!TakePendingDrop(lootGuid, item->GetEntry(), pending))
-            return;
-
-        AnnounceDrop(looter, pending, lootGuid, count);
-        PersistDroppedLootPhase(pending, looter);
-    }
-};
-
-void AddSC_GeddonBindingShardScripts()
-{
-    new ConfigurableBossLoot_World();
-    new ConfigurableBossLoot_Player();
-}
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ *
+ * Configurable Boss Loot
+ *
+ * Expanded from the original mod_talisman_of_binding_shard behavior.
+ * This module allows server owners to inject arbitrary item drops into arbitrary creature corpse loot.
+ *
+ * Features:
+ * - Multiple independent loot rules.
+ * - Any creature entry can drop any item entry.
+ * - Per-rule chance percentage.
+ * - Per-rule stack/count range.
+ * - Per-rule once-per-server, once-per-character or once-per-account lockout, or repeatable behavior.
+ * - Optional duplicate prevention.
+ * - Per-character bad-luck protection: escalating chance per failed kill, or a guaranteed Nth kill.
+ * - Server-wide drop quotas (N per day/week) backed by token buckets refilled on a cron schedule.
+ * - Optional once-per-server coordination between worldservers sharing a world database.
+ * - Optional POSIX shared memory once-flags for several worldservers on one host.
+ * - Optional global announcement when the injected item is looted.
+ * - Optional rolling when a creature enters combat or spawns, kept in a per-creature side table.
+ * - Backward-compatible fallback to the old GeddonShard.* config keys when BossLoot.RuleCount = 0.
+ * - Per-rule counters, exposed through .bossloot stats and an optional periodic log summary.
+ * - Per-thread latency histograms for the hooks and persistence calls, exposed through .bossloot latency.
+ * - Optional Prometheus text exposition file, written by a background thread for textfile collectors.
+ * - Per-rule activation windows and cron schedules, applied by republishing the rule snapshot.
+ *
+ * Layout:
+ * - BossLootRules       rule config loading, compiled rule snapshots, rolls and corpse loot access.
+ * - BossLootState       in-memory once, pity and quota state and pending injected drops.
+ * - BossLootPersistence world database tables for once-per-server drops and quotas, character
+ *                       database tables for once-per-character/account drops and pity counters.
+ * - BossLootTemplate    announcement templating and string helpers.
+ * - BossLootMetrics     counters, latency histograms and the metrics exporter.
+ * - BossLootEvaluator   the kill loop, shared by the kill hook and the load test.
+ * - BossLootBatchRoll   every roll of a kill in one vectorized pass.
+ * - BossLootLifecycle   what happens to an injected drop after the kill: writes, announcement, expiry.
+ * - BossLootLoadTest    multi-threaded synthetic kill/loot stream for contention measurements.
+ * - BossLootSchedule    cron schedules and dates for timed rules.
+ * - BossLootSharedOnce  claims and polling of once-per-server keys in a shared world database.
+ * - BossLootSharedMemory lock-free once-per-server flags in a POSIX shared memory segment.
+ * - this file           the AzerothCore scripts that glue the pieces to the hooks.
+ */
+
+#include "ScriptMgr.h"
+#include "BossLootEvaluator.h"
+#include "BossLootLifecycle.h"
+#include "BossLootLoadTest.h"
+#include "BossLootMetrics.h"
+#include "BossLootMetricsExporter.h"
+#include "BossLootPersistence.h"
+#include "BossLootRules.h"
+#include "BossLootSharedMemory.h"
+#include "BossLootSharedOnce.h"
+#include "BossLootState.h"
+#include "BossLootTemplate.h"
+#include "Config.h"
+#include "Creature.h"
+#include "Item.h"
+#include "MapMgr.h"
+#include "Player.h"
+#include "Timer.h"
+#include "World.h"
+#include "Log.h"
+#include "Chat.h"
+#include "Optional.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace BossLoot;
+
+namespace
+{
+    static constexpr char const* CONF_STATS_LOG_INTERVAL = "BossLoot.Stats.LogInterval";
+    static constexpr char const* CONF_METRICS_EXPORT_FILE = "BossLoot.Metrics.ExportFile";
+    static constexpr char const* CONF_METRICS_EXPORT_INTERVAL = "BossLoot.Metrics.ExportInterval";
+    static constexpr char const* CONF_CORPSE_DEDUP_WINDOW = "BossLoot.CorpseDedupWindow";
+    static constexpr char const* CONF_PENDING_DROP_EXPIRE_TIME = "BossLoot.PendingDrop.ExpireTime";
+    static constexpr char const* CONF_PREROLL = "BossLoot.PreRoll";
+    static constexpr char const* CONF_ONCE_FLUSH_INTERVAL = "BossLoot.OnceScope.FlushInterval";
+    static constexpr char const* CONF_PITY_FLUSH_INTERVAL = "BossLoot.Pity.FlushInterval";
+    static constexpr char const* CONF_QUOTA_FLUSH_INTERVAL = "BossLoot.Quota.FlushInterval";
+    static constexpr char const* CONF_SHARED_ONCE_ENABLE = "BossLoot.SharedOnceState.Enable";
+    static constexpr char const* CONF_SHARED_ONCE_POLL_INTERVAL = "BossLoot.SharedOnceState.PollInterval";
+    static constexpr char const* CONF_SHARED_MEMORY_NAME = "BossLoot.SharedMemory.Name";
+    static constexpr char const* CONF_LOADTEST_ENABLE = "BossLoot.LoadTest.Enable";
+
+    static uint32 gStatsLogIntervalMs = 0;
+    static uint32 gStatsLogTimerMs = 0;
+    static std::time_t gTimedRulesMinute = 0;
+    static uint32 gPendingDropExpireTime = 0;
+
+    enum PreRollMode : uint32
+    {
+        PREROLL_AT_KILL = 0,
+        PREROLL_AT_ENGAGE,
+        PREROLL_AT_SPAWN
+    };
+
+    // Read by the spawn and engage hooks on map threads, before anything else is looked at.
+    static std::atomic<PreRollMode> gPreRollMode{ PREROLL_AT_KILL };
+    static uint32 gOnceFlushIntervalMs = 0;
+    static uint32 gOnceFlushTimerMs = 0;
+    static uint32 gPityFlushIntervalMs = 0;
+    static uint32 gPityFlushTimerMs = 0;
+    static uint32 gQuotaFlushIntervalMs = 0;
+    static uint32 gQuotaFlushTimerMs = 0;
+    static bool gLoadTestEnabled = false;
+    static std::unique_ptr<OnceFlagSegment> gOnceSegment;
+
+    bool IsOnceDropped(BossLootRule const& rule, Player* killer)
+    {
+        if (rule.onceScope == OnceScope::Server)
+            return sBossLootOnceState->IsDropped(rule);
+
+        return sBossLootScopedOnce->IsDropped(killer->GetGUID().GetCounter(), rule.onceScope, rule.onceBit);
+    }
+
+    // Once-per-character and once-per-account rules are reserved for the killer, who got the kill credit.
+    bool ReserveOnce(BossLootRule const& rule, Player* killer)
+    {
+        if (rule.onceScope == OnceScope::Server)
+            return sBossLootOnceState->Reserve(rule);
+
+        return sBossLootScopedOnce->Reserve(killer->GetGUID().GetCounter(), rule.onceScope, rule.onceBit);
+    }
+
+    // Called once per wall-clock minute with the minutes since the last call, so a world update that
+    // stalled past a refill minute still refills. Shared buckets are refilled once; see QuotaStore::Refill.
+    void RefillQuotas(std::time_t since, std::time_t now)
+    {
+        std::shared_ptr<RuleSet const> ruleSet = GetRuleSet();
+
+        for (BossLootRule const& rule : ruleSet->rules)
+        {
+            if (!rule.enable || !rule.quotaBucket)
+                continue;
+
+            uint32 const periods = rule.quotaRefill.CountMatches(since, now);
+            if (!periods)
+                continue;
+
+            sBossLootQuota->Refill(*rule.quotaBucket, now);
+            LOG_DEBUG(LOG_FILTER_DROPS, "[BossLoot] Quota '{}' refilled to {} ({} refills due).", rule.quotaKey, rule.quota, periods);
+        }
+    }
+
+    OnceClaim MakeOnceClaim(Creature* killed, BossLootRule const& rule, uint32 itemEntry, Player* killer)
+    {
+        OnceClaim claim;
+        claim.onceKey = rule.onceKey;
+        claim.ruleIndex = rule.index;
+        claim.corpseGuid = killed->GetGUID();
+        claim.mapId = killed->GetMapId();
+        claim.instanceId = killed->GetInstanceId();
+        claim.npcEntry = killed->GetEntry();
+        claim.itemEntry = itemEntry;
+        claim.killerId = killer->GetGUID().GetCounter();
+        claim.killerName = killer->GetName();
+        claim.quotaBucket = rule.quotaBucket;
+        claim.pity = rule.HasPity();
+        claim.pityId = rule.pityId;
+        return claim;
+    }
+
+    // EvaluateRules context for a real kill.
+    class KillContext
+    {
+    public:
+        KillContext(std::shared_ptr<RuleSet const> const& ruleSet, Player* killer, Creature* killed, uint32 difficulty)
+            : _ruleSet(ruleSet), _killer(killer), _killed(killed), _difficulty(difficulty) { }
+
+        uint32 MapId() const { return _killed->GetMapId(); }
+        BossLootRuleStats& Stats(BossLootRule const& rule) { return GetRuleStats(rule.index); }
+
+        // Only gathered once the first PreventDuplicate rule needs it, then kept in step with what we inject.
+        bool HasCorpseItem(uint32 itemEntry)
+        {
+            if (!_corpseItemsGathered)
+            {
+                _corpseItems.Gather(&_killed->loot);
+                _corpseItemsGathered = true;
+            }
+
+            return _corpseItems.Contains(itemEntry);
+        }
+
+        void SkippedDuplicate(BossLootRule const& rule, uint32 itemEntry)
+        {
+            LOG_DEBUG(LOG_FILTER_DROPS, "[BossLoot] Rule {} skipped: {} already has item {} in corpse loot.",
+                rule.index, _killed->GetName(), itemEntry);
+        }
+
+        bool IsOnceDropped(BossLootRule const& rule) { return ::IsOnceDropped(rule, _killer); }
+
+        // A shared once-per-server key is queued for its claim together with the reservation; see
+        // ReserveOnceClaim. Map threads are idle while the world update takes the results, so Inject
+        // still remembers the drop before a lost claim can look for it.
+        bool ReserveOnce(BossLootRule const& rule, uint32 itemEntry)
+        {
+            if (rule.IsOnce(OnceScope::Server) && IsSharedOnceStateEnabled())
+            {
+                _claimQueued = ReserveOnceClaim(rule, MakeOnceClaim(_killed, rule, itemEntry, _killer));
+                return _claimQueued;
+            }
+
+            return ::ReserveOnce(rule, _killer);
+        }
+
+        bool RollPity(BossLootRule const& rule)
+        {
+            return sBossLootPity->Roll(_killer->GetGUID().GetCounter(), rule.pityId, rule.pityCurve[_difficulty]);
+        }
+
+        // A drop still waiting for its shared claim resets the counter only once the claim is won;
+        // see SettleOnceClaim.
+        void RecordPityResult(BossLootRule const& rule, bool dropped)
+        {
+            if (dropped && std::exchange(_claimQueued, false))
+                return;
+
+            sBossLootPity->Record(_killer->GetGUID().GetCounter(), rule.pityId, dropped);
+        }
+
+        void Inject(BossLootRule const& rule, uint32 itemEntry)
+        {
+            AddItemToLoot(&_killed->loot, itemEntry, rule.minCount, rule.maxCount);
+            if (_corpseItemsGathered)
+                _corpseItems.Insert(itemEntry);
+
+            PendingInjectedDrop const pending = MakePendingDrop(_killed, rule, itemEntry);
+            sBossLootPendingDrops->Remember(pending);
+
+            // The kill phase write runs from the world update; the hook only queues it.
+            if (HasKillStages(rule))
+            {
+                DropEvent event;
+                event.type = DropEventType::Injected;
+                event.drop = pending;
+                event.ruleSet = _ruleSet;
+                event.playerGuid = _killer->GetGUID();
+                event.playerName = _killer->GetName();
+                sBossLootDropLifecycle->Post(std::move(event));
+            }
+
+            // The LOG_* macros only evaluate their arguments once the filter passes, so keep every
+            // argument a plain reference; no temporary strings are built when the channel is off.
+            if (rule.allowRepeat)
+            {
+                LOG_INFO(LOG_FILTER_DROPS, "[BossLoot] Rule {} added item {} x{}..{} to {} ({}) corpse loot.",
+                    rule.index, itemEntry, rule.minCount, rule.maxCount, _killed->GetName(), _killed->GetEntry());
+            }
+            else
+            {
+                LOG_INFO(LOG_FILTER_DROPS, "[BossLoot] Rule {} added item {} x{}..{} to {} ({}) corpse loot [onceKey='{}'].",
+                    rule.index, itemEntry, rule.minCount, rule.maxCount, _killed->GetName(), _killed->GetEntry(), rule.onceKey);
+            }
+        }
+
+    private:
+        std::shared_ptr<RuleSet const> const& _ruleSet;
+        Player* _killer;
+        Creature* _killed;
+        uint32 _difficulty;
+        CorpseItemSet _corpseItems;
+        bool _corpseItemsGathered = false;
+        bool _claimQueued = false; // the last ReserveOnce queued a shared claim
+    };
+
+    // Every creature spawn and pull on the realm lands here, so both switches are checked with
+    // relaxed loads before the snapshot, and its lock, are touched.
+    bool IsPreRolling(PreRollMode mode)
+    {
+        return gPreRollMode.load(std::memory_order_relaxed) == mode && IsModuleEnabled();
+    }
+
+    // Rolls the creature's repeatable rules ahead of its kill; see BossLoot.PreRoll. Once and pity
+    // rules keep rolling at the kill, and lists too long for one PreRoll word are left to it.
+    void PreRollCreature(Creature* creature)
+    {
+        std::shared_ptr<RuleSet const> ruleSet = GetRuleSet();
+        if (!ruleSet->enabled)
+            return;
+
+        RuleVariantList const* variants = ruleSet->FindRules(creature->GetEntry(), creature->GetMap()->GetDifficulty());
+        if (!variants || variants->size() > PreRollStore::MAX_VARIANTS)
+            return;
+
+        // Nothing to roll ahead.
+        if (std::popcount(variants->killRollMask) == int(variants->size()))
+            return;
+
+        RollBatch rolls;
+        rolls.Roll(variants->rollBounds.data(), variants->size());
+
+        PreRoll preRoll;
+        preRoll.generation = ruleSet->generation;
+        preRoll.hits = rolls.FirstWord() & ~variants->killRollMask;
+        sBossLootPreRolls->Store(creature->GetGUID(), preRoll);
+    }
+
+    // The drop was injected optimistically; take it back out of the corpse, and out of the loot window
+    // of anyone looking at it, unless someone already looted it. A revoked drop hands back the quota
+    // token it took and counts as a miss for the killer's pity counter.
+    void RevokeLostClaim(OnceClaim const& claim)
+    {
+        BumpStat(GetRuleStats(claim.ruleIndex).revoked);
+
+        PendingInjectedDrop pending;
+        if (!sBossLootPendingDrops->Take(claim.corpseGuid, claim.itemEntry, pending))
+        {
+            LOG_ERROR("module", "[BossLoot] Rule {} item {} from {} was looted before once-key '{}' was confirmed; it cannot be revoked.",
+                claim.ruleIndex, claim.itemEntry, claim.corpseGuid.ToString(), claim.onceKey);
+
+            if (claim.pity)
+                sBossLootPity->Record(claim.killerId, claim.pityId, true);
+
+            return;
+        }
+
+        if (claim.quotaBucket)
+            claim.quotaBucket->Give();
+
+        if (claim.pity)
+            sBossLootPity->Record(claim.killerId, claim.pityId, false);
+
+        Map* map = sMapMgr->FindMap(claim.mapId, claim.instanceId);
+        Creature* creature = map ? map->GetCreature(claim.corpseGuid) : nullptr;
+        bool const removed = creature && RemoveItemFromLoot(&creature->loot, claim.itemEntry);
+
+        LOG_INFO(LOG_FILTER_DROPS, "[BossLoot] Rule {} item {} {} from {}: once-key '{}' belongs to another worldserver.",
+            claim.ruleIndex, claim.itemEntry, removed ? "revoked" : "dropped with its corpse", claim.corpseGuid.ToString(), claim.onceKey);
+    }
+
+    void SettleOnceClaim(OnceClaimResult const& result)
+    {
+        if (!result.won)
+        {
+            RevokeLostClaim(result.claim);
+            return;
+        }
+
+        if (result.claim.pity)
+            sBossLootPity->Record(result.claim.killerId, result.claim.pityId, true);
+    }
+
+    // Called once per wall-clock minute. Corpses do not outlive ExpireTime, so neither do their drops.
+    void ExpirePendingDrops(std::time_t now)
+    {
+        if (!gPendingDropExpireTime || now < gPendingDropExpireTime)
+            return;
+
+        std::vector<PendingInjectedDrop> expired;
+        sBossLootPendingDrops->Expire(static_cast<uint32>(now - gPendingDropExpireTime), expired);
+        if (expired.empty())
+            return;
+
+        std::shared_ptr<RuleSet const> ruleSet = GetRuleSet();
+        for (PendingInjectedDrop const& pending : expired)
+        {
+            DropEvent event;
+            event.type = DropEventType::Expired;
+            event.drop = pending;
+            event.ruleSet = ruleSet;
+            sBossLootDropLifecycle->Post(std::move(event));
+        }
+    }
+
+    // Per-rule dump after a (re)load. Looks up creature and item names, so only when INFO is on.
+    void LogLoadedRules(std::vector<BossLootRule> const& rules)
+    {
+        if (!sLog->ShouldLog("module", LOG_LEVEL_INFO))
+            return;
+
+        for (BossLootRule const& rule : rules)
+        {
+            bool const alreadyDropped = rule.IsOnce(OnceScope::Server) && sBossLootOnceState->IsDropped(rule.onceKey);
+
+            LOG_INFO("module",
+                "[BossLoot] Rule {} Enable={} NPC={}({}) MatchedNPCs={} Item={}({}) Chance={:.4f}% Count={}..{} AllowRepeat={} PreventDuplicate={} OnceKey='{}' AlreadyDropped={} Announce={}",
+                rule.index,
+                uint32(rule.enable),
+                rule.npcEntry,
+                GetCreatureName(rule.npcEntry),
+                rule.matchedEntries,
+                rule.itemEntry,
+                GetItemName(rule.itemEntry),
+                rule.chancePct,
+                rule.minCount,
+                rule.maxCount,
+                uint32(rule.allowRepeat),
+                uint32(rule.preventDuplicate),
+                rule.onceKey,
+                uint32(alreadyDropped),
+                uint32(rule.announce));
+
+            for (uint32 i = 0; i < rule.pool.items.size(); ++i)
+                LOG_INFO("module", "[BossLoot] Rule {} Pool Item={}({}) Weight={}",
+                    rule.index, rule.pool.items[i], GetItemName(rule.pool.items[i]), rule.pool.weights[i]);
+        }
+    }
+}
+
+using namespace Acore::ChatCommands;
+
+class ConfigurableBossLoot_World : public WorldScript
+{
+public:
+    ConfigurableBossLoot_World() : WorldScript("ConfigurableBossLoot_World") { }
+
+    void OnAfterConfigLoad(bool reload) override
+    {
+        ScopedLatencyTimer latency(TIMER_CONFIG_LOAD);
+
+        bool enabled = true;
+        bool resetAllOnStartup = false;
+        std::vector<BossLootRule> rules = LoadRulesFromConfig(enabled, resetAllOnStartup);
+
+        // The segment is shared with running processes, so it is only picked up at startup.
+        if (!reload)
+        {
+            std::string const segmentName = Trim(sConfigMgr->GetOption<std::string>(CONF_SHARED_MEMORY_NAME, ""));
+            if (!segmentName.empty() && (gOnceSegment = OnceFlagSegment::Open(segmentName)))
+            {
+                sBossLootOnceState->AttachSegment(gOnceSegment.get());
+                LOG_INFO("module", "[BossLoot] Once-per-server flags are in shared memory segment '{}'{}.",
+                    gOnceSegment->Name(), gOnceSegment->Created() ? " (created)" : "");
+            }
+        }
+
+        EnsureTable();
+        EnsureRowsForRules(rules);
+        EnsureScopedOnceTables();
+        EnsurePityTable();
+        EnsureQuotaTable();
+
+        // Treat ResetOnStartup literally: reset only on startup, not on .reload config.
+        if (!reload)
+        {
+            ResetStatesForRules(rules, resetAllOnStartup);
+            ResetScopedOnceForRules(rules, resetAllOnStartup);
+        }
+
+        // Bits are interned for the life of the process, so a reload keeps every online character's bitset valid.
+        // Segment flags likewise stay put while it is mapped.
+        for (BossLootRule& rule : rules)
+        {
+            if (rule.IsOnce(OnceScope::Character) || rule.IsOnce(OnceScope::Account))
+                rule.onceBit = sBossLootScopedOnce->Intern(rule.onceKey);
+
+            if (rule.IsOnce(OnceScope::Server))
+                rule.onceFlag = sBossLootOnceState->FindFlag(rule.onceKey);
+
+            if (rule.HasPity())
+                rule.pityId = sBossLootPity->Intern(rule.pityKey);
+        }
+
+        MigrateLegacyGeddonStateIfNeeded(rules);
+        LoadQuotaBuckets(rules, std::time(nullptr));
+
+        if (sConfigMgr->GetOption<bool>(CONF_SHARED_ONCE_ENABLE, false))
+        {
+            std::vector<std::string> onceKeys;
+            for (BossLootRule const& rule : rules)
+            {
+                if (rule.enable && rule.IsOnce(OnceScope::Server))
+                    onceKeys.push_back(rule.onceKey);
+            }
+
+            StartSharedOnceState(std::move(onceKeys), sConfigMgr->GetOption<uint32>(CONF_SHARED_ONCE_POLL_INTERVAL, 5));
+        }
+        else
+            StopSharedOnceState();
+
+        sBossLootOnceState->Merge(LoadDroppedStatesForRules(rules));
+        sBossLootPendingDrops->Clear();
+        sBossLootPreRolls->Clear();
+        sBossLootEvaluatedCorpses->SetWindow(sConfigMgr->GetOption<uint32>(CONF_CORPSE_DEDUP_WINDOW, 30) * IN_MILLISECONDS);
+        gPendingDropExpireTime = sConfigMgr->GetOption<uint32>(CONF_PENDING_DROP_EXPIRE_TIME, 7200);
+
+        uint32 const preRoll = sConfigMgr->GetOption<uint32>(CONF_PREROLL, PREROLL_AT_KILL);
+        if (preRoll > PREROLL_AT_SPAWN)
+            LOG_ERROR("module", "[BossLoot] {} = {} is not 0, 1 or 2; rolling at kill time.", CONF_PREROLL, preRoll);
+
+        gPreRollMode.store(preRoll > PREROLL_AT_SPAWN ? PREROLL_AT_KILL : static_cast<PreRollMode>(preRoll), std::memory_order_relaxed);
+
+        // Rule indices can point at different rules after a reload, so old numbers would be misleading.
+        ResetRuleStats();
+        SetMetricsRuleLabels(rules);
+        gStatsLogIntervalMs = sConfigMgr->GetOption<uint32>(CONF_STATS_LOG_INTERVAL, 0) * IN_MILLISECONDS;
+        gStatsLogTimerMs = 0;
+        gOnceFlushIntervalMs = std::max<uint32>(1, sConfigMgr->GetOption<uint32>(CONF_ONCE_FLUSH_INTERVAL, 5)) * IN_MILLISECONDS;
+        gPityFlushIntervalMs = std::max<uint32>(1, sConfigMgr->GetOption<uint32>(CONF_PITY_FLUSH_INTERVAL, 60)) * IN_MILLISECONDS;
+        gQuotaFlushIntervalMs = std::max<uint32>(1, sConfigMgr->GetOption<uint32>(CONF_QUOTA_FLUSH_INTERVAL, 10)) * IN_MILLISECONDS;
+        gLoadTestEnabled = sConfigMgr->GetOption<bool>(CONF_LOADTEST_ENABLE, false);
+
+        StartMetricsExporter(
+            Trim(sConfigMgr->GetOption<std::string>(CONF_METRICS_EXPORT_FILE, "")),
+            sConfigMgr->GetOption<uint32>(CONF_METRICS_EXPORT_INTERVAL, 15));
+
+        LOG_INFO("module", "[BossLoot] Enable={} RulesLoaded={} ResetAllOnStartup={} Reload={}",
+            uint32(enabled), uint32(rules.size()), uint32(resetAllOnStartup), uint32(reload));
+
+        std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(enabled, std::move(rules), std::time(nullptr));
+        LogLoadedRules(ruleSet->rules);
+        PublishRuleSet(std::move(ruleSet));
+    }
+
+    // The first config load runs before creature_template is loaded, so NpcEntry ranges and
+    // Rank/Family filters are expanded again once the world is up.
+    void OnStartup() override
+    {
+        std::shared_ptr<RuleSet const> current = GetRuleSet();
+        std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(current->enabled, current->rules, std::time(nullptr));
+
+        for (BossLootRule const& rule : ruleSet->rules)
+        {
+            if (rule.enable && rule.matchedEntries != 1)
+                LOG_INFO("module", "[BossLoot] Rule {} matches {} creature entries.", rule.index, rule.matchedEntries);
+        }
+
+        PublishRuleSet(std::move(ruleSet));
+    }
+
+    void OnShutdown() override
+    {
+        StopLoadTest();
+        StopMetricsExporter();
+        StopSharedOnceState();
+        sBossLootDropLifecycle->Drain(std::chrono::seconds(5));
+        FlushScopedOnceWrites(true);
+        WritePityCounters(sBossLootPity->TakeWrites(), true);
+        WriteQuotaStates(sBossLootQuota->TakeWrites(), true);
+    }
+
+    void OnUpdate(uint32 diff) override
+    {
+        sBossLootEvaluatedCorpses->Update(diff);
+
+        for (OnceClaimResult const& result : TakeOnceClaimResults())
+            SettleOnceClaim(result);
+
+        gOnceFlushTimerMs += diff;
+        if (gOnceFlushTimerMs >= gOnceFlushIntervalMs)
+        {
+            gOnceFlushTimerMs = 0;
+            FlushScopedOnceWrites();
+        }
+
+        gPityFlushTimerMs += diff;
+        if (gPityFlushTimerMs >= gPityFlushIntervalMs)
+        {
+            gPityFlushTimerMs = 0;
+            WritePityCounters(sBossLootPity->TakeWrites());
+        }
+
+        gQuotaFlushTimerMs += diff;
+        if (gQuotaFlushTimerMs >= gQuotaFlushIntervalMs)
+        {
+            gQuotaFlushTimerMs = 0;
+            WriteQuotaStates(sBossLootQuota->TakeWrites());
+        }
+
+        // Windows and schedules have minute resolution, so look at them once per wall-clock minute.
+        std::time_t const now = std::time(nullptr);
+        if (gOnceSegment)
+            gOnceSegment->Heartbeat(now);
+
+        if (now / MINUTE != gTimedRulesMinute)
+        {
+            // The first tick only looks at the current minute, as startup applied earlier refills. A
+            // clock jump is scanned back a day at most.
+            std::time_t const since = gTimedRulesMinute ? gTimedRulesMinute * MINUTE : now - MINUTE;
+            gTimedRulesMinute = now / MINUTE;
+            RefreshTimedRules(now);
+            RefillQuotas(std::clamp<std::time_t>(since, now - DAY, now - MINUTE), now);
+            ExpirePendingDrops(now);
+        }
+
+        sBossLootDropLifecycle->Update();
+
+        if (!gStatsLogIntervalMs)
+            return;
+
+        gStatsLogTimerMs += diff;
+        if (gStatsLogTimerMs < gStatsLogIntervalMs)
+            return;
+
+        gStatsLogTimerMs = 0;
+
+        // Building the summary takes gConfigMutex and formats every rule; skip it when nobody reads it.
+        if (!sLog->ShouldLog("module", LOG_LEVEL_INFO))
+            return;
+
+        for (std::string const& line : BuildStatsSummary())
+            LOG_INFO("module", "{}", line);
+
+        for (std::string const& line : BuildLatencySummary())
+            LOG_INFO("module", "{}", line);
+    }
+};
+
+class ConfigurableBossLoot_Player : public PlayerScript
+{
+public:
+    ConfigurableBossLoot_Player() : PlayerScript("ConfigurableBossLoot_Player") { }
+
+    // Until the query comes back every once-per-character and once-per-account rule counts as
+    // dropped for this character, so a kill right after login cannot hand out a second copy.
+    void OnPlayerLogin(Player* player) override
+    {
+        if (!player)
+            return;
+
+        LoadScopedOnceAsync(player);
+        LoadPityAsync(player);
+    }
+
+    // Reserved drops stay queued for the next batch flush after the character is evicted; pity
+    // counters are written straight away so the next login reads them back.
+    void OnPlayerLogout(Player* player) override
+    {
+        if (!player)
+            return;
+
+        uint32 const characterId = player->GetGUID().GetCounter();
+        sBossLootScopedOnce->Evict(characterId);
+        WritePityCounters(sBossLootPity->Evict(characterId));
+    }
+
+    void OnPlayerCreatureKill(Player* killer, Creature* killed) override
+    {
+        if (!killer || !killed)
+            return;
+
+        ScopedLatencyTimer latency(TIMER_KILL_HOOK);
+
+        std::shared_ptr<RuleSet const> ruleSet = GetRuleSet();
+        if (!ruleSet->enabled)
+            return;
+
+        uint32 const killedEntry = killed->GetEntry();
+        uint32 const difficulty = killed->GetMap()->GetDifficulty();
+
+        RuleVariantList const* variants = ruleSet->FindRules(killedEntry, difficulty);
+        if (!variants)
+            return;
+
+        if (!sBossLootEvaluatedCorpses->TryMark(killed->GetGUID()))
+        {
+            LOG_DEBUG(LOG_FILTER_DROPS, "[BossLoot] {} ({}) corpse already evaluated, skipping repeated kill hook.",
+                killed->GetName(), killedEntry);
+            return;
+        }
+
+        KillContext context(ruleSet, killer, killed, difficulty);
+
+        // A roll made under an older snapshot may be for a different variant list, so it is dropped.
+        PreRoll preRoll;
+        if (gPreRollMode.load(std::memory_order_relaxed) != PREROLL_AT_KILL && sBossLootPreRolls->Take(killed->GetGUID(), preRoll)
+            && preRoll.generation == ruleSet->generation)
+        {
+            // Once and pity variants were left out of the pre-roll and roll now.
+            RollBatch rolls;
+            uint64 hits = preRoll.hits;
+            if (variants->killRollMask)
+            {
+                rolls.Roll(variants->rollBounds.data(), variants->size());
+                hits |= rolls.FirstWord() & variants->killRollMask;
+            }
+
+            rolls.AssignFirstWord(hits);
+            EvaluateRules(context, *ruleSet, *variants, rolls);
+            return;
+        }
+
+        EvaluateRules(context, *ruleSet, *variants);
+    }
+
+    void OnPlayerLootItem(Player* looter, Item* item, uint32 count, ObjectGuid lootGuid) override
+    {
+        if (!looter || !item)
+            return;
+
+        if (!IsModuleEnabled())
+            return;
+
+        PendingInjectedDrop pending;
+        if (!sBossLootPendingDrops->Take(lootGuid, item->GetEntry(), pending))
+            return;
+
+        // Only injected items are timed; the filtered-out path above is two relaxed loads, and timing
+        // it would cost every other loot on the realm two clock reads.
+        ScopedLatencyTimer latency(TIMER_LOOT_HOOK);
+
+        // A reload clears the pending drops, so the snapshot is the one the drop was made with.
+        std::shared_ptr<RuleSet const> ruleSet = GetRuleSet();
+        BossLootRule const* rule = ruleSet->GetRule(pending.ruleId);
+        if (!rule)
+            return;
+
+        LOG_DEBUG(LOG_FILTER_DROPS, "[BossLoot] Rule {} item {} x{} looted by {} from {}.",
+            rule->index, pending.itemEntry, count, looter->GetName(), lootGuid.ToString());
+
+        // Announcement and the loot phase write run from the world update.
+        if (!HasLootStages(*rule))
+            return;
+
+        DropEvent event;
+        event.type = DropEventType::Looted;
+        event.drop = pending;
+        event.ruleSet = std::move(ruleSet);
+        event.playerGuid = looter->GetGUID();
+        event.playerName = looter->GetName();
+        event.count = count;
+        sBossLootDropLifecycle->Post(std::move(event));
+    }
+};
+
+class ConfigurableBossLoot_Creature : public AllCreatureScript
+{
+public:
+    ConfigurableBossLoot_Creature() : AllCreatureScript("ConfigurableBossLoot_Creature") { }
+
+    void OnCreatureAddWorld(Creature* creature) override
+    {
+        if (creature && IsPreRolling(PREROLL_AT_SPAWN))
+            PreRollCreature(creature);
+    }
+
+    // Creatures that leave the map alive would otherwise keep their roll until the next reload.
+    void OnCreatureRemoveWorld(Creature* creature) override
+    {
+        if (creature && gPreRollMode.load(std::memory_order_relaxed) != PREROLL_AT_KILL && IsModuleEnabled())
+            sBossLootPreRolls->Forget(creature->GetGUID());
+    }
+};
+
+class ConfigurableBossLoot_Unit : public UnitScript
+{
+public:
+    ConfigurableBossLoot_Unit() : UnitScript("ConfigurableBossLoot_Unit") { }
+
+    // Rolled again on every pull, so an evade and re-pull does not keep an old roll.
+    void OnUnitEnterCombat(Unit* unit, Unit* /*victim*/) override
+    {
+        if (!unit || !IsPreRolling(PREROLL_AT_ENGAGE))
+            return;
+
+        if (Creature* creature = unit->ToCreature())
+            PreRollCreature(creature);
+    }
+};
+
+class ConfigurableBossLoot_Command : public CommandScript
+{
+public:
+    ConfigurableBossLoot_Command() : CommandScript("ConfigurableBossLoot_Command") { }
+
+    ChatCommandTable GetCommands() const override
+    {
+        static ChatCommandTable bossLootStatsCommandTable =
+        {
+            { "",      HandleBossLootStatsCommand,      SEC_GAMEMASTER,    Console::Yes },
+            { "reset", HandleBossLootStatsResetCommand, SEC_ADMINISTRATOR, Console::Yes }
+        };
+
+        static ChatCommandTable bossLootLatencyCommandTable =
+        {
+            { "",      HandleBossLootLatencyCommand,      SEC_GAMEMASTER,    Console::Yes },
+            { "reset", HandleBossLootLatencyResetCommand, SEC_ADMINISTRATOR, Console::Yes }
+        };
+
+        static ChatCommandTable bossLootCommandTable =
+        {
+            { "stats",    bossLootStatsCommandTable },
+            { "latency",  bossLootLatencyCommandTable },
+            { "loadtest", HandleBossLootLoadTestCommand, SEC_ADMINISTRATOR, Console::Yes }
+        };
+
+        static ChatCommandTable commandTable =
+        {
+            { "bossloot", bossLootCommandTable }
+        };
+
+        return commandTable;
+    }
+
+    static bool HandleBossLootStatsCommand(ChatHandler* handler)
+    {
+        for (std::string const& line : BuildStatsSummary())
+            handler->SendSysMessage(line);
+
+        return true;
+    }
+
+    static bool HandleBossLootStatsResetCommand(ChatHandler* handler)
+    {
+        ResetRuleStats();
+        handler->SendSysMessage("[BossLoot] Rule counters reset.");
+        return true;
+    }
+
+    static bool HandleBossLootLatencyCommand(ChatHandler* handler)
+    {
+        for (std::string const& line : BuildLatencySummary())
+            handler->SendSysMessage(line);
+
+        return true;
+    }
+
+    static bool HandleBossLootLatencyResetCommand(ChatHandler* handler)
+    {
+        ResetLatency();
+        handler->SendSysMessage("[BossLoot] Latency histograms reset.");
+        return true;
+    }
+
+    static bool HandleBossLootLoadTestCommand(ChatHandler* handler, Optional<uint32> maxThreads, Optional<uint32> killsPerThread,
+        Optional<uint32> ruleCount, Optional<uint32> bossKillPct)
+    {
+        if (!gLoadTestEnabled)
+        {
+            handler->SendSysMessage("[BossLoot] The load test is disabled. Set BossLoot.LoadTest.Enable = 1 to allow it.");
+            handler->SetSentErrorMessage(true);
+            return false;
+        }
+
+        LoadTestOptions options;
+        options.maxThreads = maxThreads.value_or(std::max<uint32>(1, std::thread::hardware_concurrency()));
+        options.killsPerThread = killsPerThread.value_or(options.killsPerThread);
+        options.ruleCount = ruleCount.value_or(options.ruleCount);
+        options.bossKillPct = bossKillPct.value_or(options.bossKillPct);
+
+        if (!StartLoadTest(options))
+        {
+            handler->SendSysMessage("[BossLoot] A load test is already running.");
+            handler->SetSentErrorMessage(true);
+            return false;
+        }
+
+        handler->SendSysMessage("[BossLoot] Load test started. Results are written to the server log.");
+        return true;
+    }
+};
+
+void AddSC_GeddonBindingShardScripts()
+{
+    new ConfigurableBossLoot_World();
+    new ConfigurableBossLoot_Player();
+    new ConfigurableBossLoot_Creature();
+    new ConfigurableBossLoot_Unit();
+    new ConfigurableBossLoot_Command();
+}
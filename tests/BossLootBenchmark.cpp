@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootBatchRoll.h"
+#include "BossLootEvaluator.h"
+#include "BossLootMetrics.h"
+#include "BossLootMutex.h"
+#include "BossLootRules.h"
+#include "BossLootState.h"
+#include "LootMgr.h"
+#include "ObjectGuid.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace BossLoot;
+
+namespace
+{
+    // Synthetic entries well above anything in a 3.3.5 world database.
+    static constexpr uint32 BENCHMARK_BOSS_ENTRY = 9000000;
+    static constexpr uint32 BENCHMARK_TRASH_ENTRY = 9100000;
+    static constexpr uint32 BENCHMARK_ITEM_ENTRY_BASE = 9200000;
+    static constexpr uint32 BENCHMARK_OTHER_ITEM_ENTRY_BASE = 9300000;
+
+    // Items the core itself puts on a boss corpse, gathered by every kill.
+    static constexpr uint32 CORPSE_LOOT_ITEMS = 4;
+
+    // Drops outstanding in the pending drop table while the loot path is timed.
+    static constexpr uint32 OUTSTANDING_DROPS = 64;
+
+    enum BenchmarkMix : uint8
+    {
+        BENCHMARK_MIX_UNIFORM,  // every rule repeatable without PreventDuplicate
+        BENCHMARK_MIX_MIXED     // flags vary from rule to rule
+    };
+
+    // All on one boss entry, chances between 0.5% and 20%. The mixed rules cover PreventDuplicate,
+    // once, pool and pity rules, so all branches of the kill loop are exercised.
+    std::vector<BossLootRule> MakeBenchmarkRules(uint32 ruleCount, BenchmarkMix mix)
+    {
+        std::vector<BossLootRule> rules;
+        rules.reserve(ruleCount);
+
+        for (uint32 i = 0; i < ruleCount; ++i)
+        {
+            BossLootRule rule;
+            rule.index = i + 1;
+            rule.npcEntry = BENCHMARK_BOSS_ENTRY;
+            rule.itemEntry = BENCHMARK_ITEM_ENTRY_BASE + i;
+            rule.chancePct = 0.5 + static_cast<double>((i * 7) % 196) / 10.0;
+            rule.preventDuplicate = false;
+
+            if (mix != BENCHMARK_MIX_UNIFORM)
+            {
+                rule.allowRepeat = (i % 5) != 0;
+                rule.preventDuplicate = (i % 2) == 0;
+
+                if (!rule.allowRepeat)
+                    rule.onceKey = Acore::StringFormat("benchmark_rule{}", rule.index);
+
+                if (i % 3 == 1)
+                {
+                    rule.pool = BuildItemPool({ { rule.itemEntry, 3 }, { BENCHMARK_OTHER_ITEM_ENTRY_BASE + i, 1 } });
+                    rule.itemEntry = 0;
+                }
+
+                if (i % 7 == 3)
+                    rule.pityStepPct = 1.0;
+            }
+
+            rules.push_back(std::move(rule));
+        }
+
+        return rules;
+    }
+
+    // The pending drop table as it was before sharding, one lock and one list, as the baseline.
+    class SingleLockPendingDrops
+    {
+    public:
+        void Remember(PendingInjectedDrop const& pending)
+        {
+            std::lock_guard<ContentionMutex> guard(_mutex);
+            _drops.push_back(pending);
+        }
+
+        bool Take(ObjectGuid lootGuid, uint32 itemEntry, PendingInjectedDrop& out)
+        {
+            std::lock_guard<ContentionMutex> guard(_mutex);
+
+            auto itr = std::find_if(_drops.begin(), _drops.end(),
+                [&](PendingInjectedDrop const& pending) { return pending.lootGuid == lootGuid && pending.itemEntry == itemEntry; });
+
+            if (itr == _drops.end())
+                return false;
+
+            out = *itr;
+            _drops.erase(itr);
+            return true;
+        }
+
+        LockContention GetContention() const { return _mutex.GetContention("gPendingMutex"); }
+
+    private:
+        mutable ContentionMutex _mutex;
+        std::vector<PendingInjectedDrop> _drops;
+    };
+
+    // The module state a kill and a loot event touch, private to the benchmark.
+    class BossLootFixture : public benchmark::Fixture
+    {
+    public:
+        // Rules per boss and their BenchmarkMix come from the first two arguments. Threads share one
+        // set of stores, which the first thread builds; the others wait for it at the start of the
+        // timed loop.
+        void SetUp(benchmark::State const& state) override
+        {
+            if (state.thread_index() != 0)
+                return;
+
+            ruleSet = CompileRuleSet(true, MakeBenchmarkRules(static_cast<uint32>(state.range(0)), static_cast<BenchmarkMix>(state.range(1))),
+                std::time(nullptr));
+            variants = ruleSet->FindRules(BENCHMARK_BOSS_ENTRY, REGULAR_DIFFICULTY);
+            rules = std::make_unique<RuleSetHolder>();
+            rules->Publish(ruleSet);
+            onceState = std::make_unique<OnceStateStore>();
+            pendingDrops = std::make_unique<PendingDropStore>();
+            singleLockDrops = std::make_unique<SingleLockPendingDrops>();
+            stats = std::make_unique<std::array<BossLootRuleStats, MAX_RULES + 1>>();
+
+            corpseLoot = Loot();
+            for (uint32 i = 0; i < CORPSE_LOOT_ITEMS; ++i)
+                AddItemToLoot(&corpseLoot, BENCHMARK_OTHER_ITEM_ENTRY_BASE + i, 1, 1);
+        }
+
+        void TearDown(benchmark::State const& state) override
+        {
+            if (state.thread_index() != 0)
+                return;
+
+            ruleSet.reset();
+            variants = nullptr;
+            rules.reset();
+            onceState.reset();
+            pendingDrops.reset();
+            singleLockDrops.reset();
+            stats.reset();
+        }
+
+        // Drops on other corpses, waiting for their looters while a loot event is timed.
+        void RememberOutstandingDrops()
+        {
+            for (uint32 i = 0; i < OUTSTANDING_DROPS; ++i)
+            {
+                PendingInjectedDrop pending;
+                pending.lootGuid = ObjectGuid(HighGuid::Unit, BENCHMARK_BOSS_ENTRY, i + 1);
+                pending.itemEntry = BENCHMARK_ITEM_ENTRY_BASE + i;
+                pendingDrops->Remember(pending);
+            }
+        }
+
+        // EvaluateRules context for a synthetic kill, mirroring the kill hook minus the database.
+        // Pending drops are only remembered when a store is given, so rule evaluation can be timed alone.
+        class Kill
+        {
+        public:
+            Kill(BossLootFixture& fixture, ObjectGuid corpseGuid, CorpseItemSet& corpseItems, PendingDropStore* pendingDrops)
+                : _fixture(fixture), _corpseGuid(corpseGuid), _corpseItems(corpseItems), _pendingDrops(pendingDrops) { }
+
+            uint32 MapId() const { return 0; }
+            BossLootRuleStats& Stats(BossLootRule const& rule) { return (*_fixture.stats)[rule.index]; }
+            bool HasCorpseItem(uint32 itemEntry) { return _corpseItems.Contains(itemEntry); }
+            void SkippedDuplicate(BossLootRule const& /*rule*/, uint32 /*itemEntry*/) { }
+            bool IsOnceDropped(BossLootRule const& rule) { return _fixture.onceState->IsDropped(rule.onceKey); }
+            bool ReserveOnce(BossLootRule const& rule, uint32 /*itemEntry*/) { return _fixture.onceState->Reserve(rule.onceKey); }
+
+            // No characters here, so every kill rolls the first step of the curve.
+            bool RollPity(BossLootRule const& rule) { return RollThreshold(GetPityThreshold(rule.pityCurve[REGULAR_DIFFICULTY], 0)); }
+            void RecordPityResult(BossLootRule const& /*rule*/, bool /*dropped*/) { }
+
+            void Inject(BossLootRule const& rule, uint32 itemEntry)
+            {
+                _corpseItems.Insert(itemEntry);
+
+                if (!_pendingDrops)
+                    return;
+
+                PendingInjectedDrop pending;
+                pending.lootGuid = _corpseGuid;
+                pending.ruleId = rule.ruleId;
+                pending.npcEntry = rule.npcEntry;
+                pending.itemEntry = itemEntry;
+                _pendingDrops->Remember(pending);
+            }
+
+        private:
+            BossLootFixture& _fixture;
+            ObjectGuid _corpseGuid;
+            CorpseItemSet& _corpseItems;
+            PendingDropStore* _pendingDrops;
+        };
+
+        std::shared_ptr<RuleSet const> ruleSet;
+        RuleVariantList const* variants = nullptr;
+        std::unique_ptr<RuleSetHolder> rules;   // published ruleSet, for the loot hook's enabled check
+        std::unique_ptr<OnceStateStore> onceState;
+        std::unique_ptr<PendingDropStore> pendingDrops;
+        std::unique_ptr<SingleLockPendingDrops> singleLockDrops;
+        std::unique_ptr<std::array<BossLootRuleStats, MAX_RULES + 1>> stats;
+        Loot corpseLoot;
+    };
+}
+
+// The kill hook on a boss: gather the corpse loot, evaluate every rule, remember what was injected.
+// Nobody loots, so the table is emptied every 1024 kills to keep it at a realistic size.
+BENCHMARK_DEFINE_F(BossLootFixture, KillPath)(benchmark::State& state)
+{
+    CorpseItemSet corpseItems;
+    uint32 kill = 0;
+
+    for (auto _ : state)
+    {
+        if ((++kill & 1023) == 0)
+            pendingDrops->Clear();
+
+        corpseItems.Gather(&corpseLoot);
+
+        Kill context(*this, ObjectGuid(HighGuid::Unit, BENCHMARK_BOSS_ENTRY, kill), corpseItems, pendingDrops.get());
+        EvaluateRules(context, *ruleSet, *variants);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BossLootFixture, KillPath)
+    ->ArgsProduct({ benchmark::CreateRange(1, MAX_RULES, 2), { BENCHMARK_MIX_MIXED } })
+    ->ArgNames({ "rules", "mix" });
+
+// The kill loop alone, without the corpse loot or pending drops, for a uniform and a mixed rule list.
+BENCHMARK_DEFINE_F(BossLootFixture, EvaluateRules)(benchmark::State& state)
+{
+    CorpseItemSet corpseItems;
+    uint32 kill = 0;
+
+    for (auto _ : state)
+    {
+        corpseItems.Clear();
+
+        Kill context(*this, ObjectGuid(HighGuid::Unit, BENCHMARK_BOSS_ENTRY, ++kill), corpseItems, nullptr);
+        EvaluateRules(context, *ruleSet, *variants);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BossLootFixture, EvaluateRules)
+    ->ArgsProduct({ { 8, 32 }, { BENCHMARK_MIX_UNIFORM, BENCHMARK_MIX_MIXED } })
+    ->ArgNames({ "rules", "mix" });
+
+// One RollThreshold call per rule, as the kill loop rolled before RollBatch, against one batch per
+// kill, for 1, 2, 4 ... MAX_RULES rules. The hit rate counters of both should agree.
+BENCHMARK_DEFINE_F(BossLootFixture, RollPerRule)(benchmark::State& state)
+{
+    std::vector<uint32> thresholds;
+    for (RuleVariant const& variant : variants->variants)
+        thresholds.push_back(GetRollThreshold(ruleSet->rules[variant.ruleId].chancePct));
+
+    uint64 hits = 0;
+
+    for (auto _ : state)
+    {
+        for (uint32 threshold : thresholds)
+            hits += RollThreshold(threshold);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hitRate"] = static_cast<double>(hits) * 100.0 / static_cast<double>(state.iterations() * thresholds.size());
+}
+
+BENCHMARK_DEFINE_F(BossLootFixture, RollBatch)(benchmark::State& state)
+{
+    RollBatch batch;
+    uint64 hits = 0;
+
+    for (auto _ : state)
+    {
+        batch.Roll(variants->rollBounds.data(), variants->size());
+        for (uint32 i = 0; i < variants->size(); ++i)
+            hits += batch.Hit(i);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hitRate"] = static_cast<double>(hits) * 100.0 / static_cast<double>(state.iterations() * variants->size());
+}
+
+static void RollArguments(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgsProduct({ benchmark::CreateRange(1, MAX_RULES, 2), { BENCHMARK_MIX_UNIFORM } })->ArgNames({ "rules", "mix" });
+}
+
+BENCHMARK_REGISTER_F(BossLootFixture, RollPerRule)->Apply(RollArguments);
+BENCHMARK_REGISTER_F(BossLootFixture, RollBatch)->Apply(RollArguments);
+
+// What OnPlayerLootItem costs with drops outstanding. First, what every loot event on the realm
+// pays: an item the module did not inject, answered by the enabled flag and the shard's item filter.
+BENCHMARK_DEFINE_F(BossLootFixture, LootPathOther)(benchmark::State& state)
+{
+    RememberOutstandingDrops();
+
+    ObjectGuid const corpseGuid(HighGuid::Unit, BENCHMARK_TRASH_ENTRY, OUTSTANDING_DROPS + 1);
+    PendingInjectedDrop taken;
+    uint32 event = 0;
+
+    for (auto _ : state)
+    {
+        bool found = false;
+        if (rules->IsEnabled())
+            found = pendingDrops->Take(corpseGuid, BENCHMARK_OTHER_ITEM_ENTRY_BASE + (event++ & 15), taken);
+
+        benchmark::DoNotOptimize(found);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BossLootFixture, LootPathOther)->Args({ 8, BENCHMARK_MIX_MIXED })->ArgNames({ "rules", "mix" });
+
+// A loot event that takes an injected drop, timed together with remembering it at the kill.
+BENCHMARK_DEFINE_F(BossLootFixture, LootPathInjected)(benchmark::State& state)
+{
+    RememberOutstandingDrops();
+
+    ObjectGuid const corpseGuid(HighGuid::Unit, BENCHMARK_TRASH_ENTRY, OUTSTANDING_DROPS + 1);
+
+    PendingInjectedDrop injected;
+    injected.lootGuid = corpseGuid;
+    injected.itemEntry = BENCHMARK_ITEM_ENTRY_BASE + OUTSTANDING_DROPS;
+
+    PendingInjectedDrop taken;
+
+    for (auto _ : state)
+    {
+        pendingDrops->Remember(injected);
+
+        bool found = false;
+        if (rules->IsEnabled())
+            found = pendingDrops->Take(corpseGuid, injected.itemEntry, taken);
+
+        benchmark::DoNotOptimize(found);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BossLootFixture, LootPathInjected)->Args({ 8, BENCHMARK_MIX_MIXED })->ArgNames({ "rules", "mix" });
+
+// Every thread stands in for one map: it remembers drops on its own corpses and takes each one back
+// eight drops later. The sharded table against a single lock, from 1, 2, 4 ... all hardware threads;
+// the contended counter is the share of lock acquisitions that had to wait.
+template <typename Store>
+void RunPendingDropBenchmark(Store& store, benchmark::State& state)
+{
+    static constexpr uint32 WINDOW = 8;
+    static constexpr uint32 GUID_MASK = 0xFFFFF;
+
+    uint32 const entry = BENCHMARK_BOSS_ENTRY + static_cast<uint32>(state.thread_index());
+
+    PendingInjectedDrop pending;
+    pending.itemEntry = BENCHMARK_ITEM_ENTRY_BASE;
+    PendingInjectedDrop taken;
+    uint32 i = 0;
+
+    for (auto _ : state)
+    {
+        pending.lootGuid = ObjectGuid(HighGuid::Unit, entry, (i & GUID_MASK) + 1);
+        store.Remember(pending);
+
+        if (i >= WINDOW)
+            store.Take(ObjectGuid(HighGuid::Unit, entry, ((i - WINDOW) & GUID_MASK) + 1), BENCHMARK_ITEM_ENTRY_BASE, taken);
+
+        ++i;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0)
+    {
+        LockContention const lock = store.GetContention();
+        state.counters["contendedPct"] = lock.acquired ? static_cast<double>(lock.contended) * 100.0 / static_cast<double>(lock.acquired) : 0.0;
+    }
+}
+
+BENCHMARK_DEFINE_F(BossLootFixture, PendingDropsSharded)(benchmark::State& state)
+{
+    RunPendingDropBenchmark(*pendingDrops, state);
+}
+
+BENCHMARK_DEFINE_F(BossLootFixture, PendingDropsSingleLock)(benchmark::State& state)
+{
+    RunPendingDropBenchmark(*singleLockDrops, state);
+}
+
+static void PendingDropArguments(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->Args({ 8, BENCHMARK_MIX_MIXED })->ArgNames({ "rules", "mix" })
+        ->ThreadRange(1, static_cast<int>(std::max<uint32>(1, std::thread::hardware_concurrency())))->UseRealTime();
+}
+
+BENCHMARK_REGISTER_F(BossLootFixture, PendingDropsSharded)->Apply(PendingDropArguments);
+BENCHMARK_REGISTER_F(BossLootFixture, PendingDropsSingleLock)->Apply(PendingDropArguments);
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootSimulator.h"
+#include "BossLootTemplate.h"
+#include "Random.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace BossLoot;
+
+namespace
+{
+    // A once-rule trial that has not dropped after this many kills is cut off and counted as censored.
+    static constexpr uint64 SIMULATOR_MAX_KILLS_PER_TRIAL = 100000000;
+    static constexpr uint32 SIMULATOR_MAX_TRIALS = 2000000;
+
+    // Quota refills are laid out over this many weeks of the calendar, and the simulated weeks
+    // cycle through them.
+    static constexpr uint32 SIMULATOR_REFILL_CYCLE_WEEKS = 52;
+
+    uint64 SplitMix64(uint64& state)
+    {
+        uint64 z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // xoshiro256**, one per worker. urand() is far too slow for billions of rolls.
+    class SimulatorRng
+    {
+    public:
+        explicit SimulatorRng(uint64 seed)
+        {
+            for (uint64& word : _state)
+                word = SplitMix64(seed);
+        }
+
+        uint64 Next()
+        {
+            uint64 const result = Rotl(_state[1] * 5, 7) * 9;
+            uint64 const t = _state[1] << 17;
+
+            _state[2] ^= _state[0];
+            _state[3] ^= _state[1];
+            _state[1] ^= _state[2];
+            _state[0] ^= _state[3];
+            _state[2] ^= t;
+            _state[3] = Rotl(_state[3], 45);
+
+            return result;
+        }
+
+        // Uniform in [1, ROLL_SCALE], the range RollDrop draws from.
+        uint32 Roll()
+        {
+            return static_cast<uint32>(((Next() >> 32) * ROLL_SCALE) >> 32) + 1;
+        }
+
+        uint32 Range(uint32 min, uint32 max)
+        {
+            if (max <= min)
+                return min;
+
+            return min + static_cast<uint32>(((Next() >> 32) * (static_cast<uint64>(max - min) + 1)) >> 32);
+        }
+
+    private:
+        static uint64 Rotl(uint64 x, int k) { return (x << k) | (x >> (64 - k)); }
+
+        uint64 _state[4];
+    };
+
+    // Sorts the samples in place.
+    SampleSummary Summarize(std::vector<uint64>& samples)
+    {
+        SampleSummary summary;
+        if (samples.empty())
+            return summary;
+
+        std::sort(samples.begin(), samples.end());
+
+        double sum = 0.0;
+        for (uint64 sample : samples)
+            sum += static_cast<double>(sample);
+
+        summary.mean = sum / static_cast<double>(samples.size());
+
+        double squares = 0.0;
+        for (uint64 sample : samples)
+        {
+            double const delta = static_cast<double>(sample) - summary.mean;
+            squares += delta * delta;
+        }
+
+        summary.stddev = samples.size() > 1 ? std::sqrt(squares / static_cast<double>(samples.size() - 1)) : 0.0;
+
+        auto percentile = [&samples](double q)
+        {
+            std::size_t rank = static_cast<std::size_t>(std::ceil(q * static_cast<double>(samples.size())));
+            return samples[std::clamp<std::size_t>(rank, 1, samples.size()) - 1];
+        };
+
+        summary.p50 = percentile(0.50);
+        summary.p90 = percentile(0.90);
+        summary.p99 = percentile(0.99);
+        summary.max = samples.back();
+        return summary;
+    }
+
+    struct SimulatorWorkerResult
+    {
+        uint64 kills = 0;
+        uint64 censored = 0;
+        uint64 blockedQuota = 0;
+    };
+
+    // What a repeatable rule does each kill. Without a quota, refillKills is empty and quota is 0.
+    struct WeeklyModel
+    {
+        std::vector<uint32> curve;
+        uint32 killsPerWeek = 0;
+        uint32 minCount = 1;
+        uint32 maxCount = 1;
+        uint32 quota = 0;
+        std::vector<uint64> refillKills; // sorted kills of the refill cycle that find the bucket topped up
+    };
+
+    // Kills are spread evenly over the week, the first one at the start of it. A refill reaches the
+    // first kill at or after its minute; one past the end of the cycle wraps to its first kill.
+    std::vector<uint64> GetRefillKills(CronSchedule const& schedule, std::time_t start, uint32 killsPerWeek)
+    {
+        uint64 const cycleKills = uint64(SIMULATOR_REFILL_CYCLE_WEEKS) * killsPerWeek;
+        std::time_t const end = start + std::time_t(SIMULATOR_REFILL_CYCLE_WEEKS) * WEEK;
+
+        std::vector<uint64> refillKills;
+        for (std::time_t minute = (start / MINUTE + 1) * MINUTE; minute <= end; minute += MINUTE)
+        {
+            if (!schedule.Matches(Acore::Time::TimeBreakdown(minute)))
+                continue;
+
+            uint64 const kill = (uint64(minute - start) * killsPerWeek + WEEK - 1) / WEEK;
+            refillKills.push_back(kill < cycleKills ? kill : 0);
+        }
+
+        std::sort(refillKills.begin(), refillKills.end());
+        refillKills.erase(std::unique(refillKills.begin(), refillKills.end()), refillKills.end());
+        return refillKills;
+    }
+
+    // Kills until the first drop, one sample per trial. curve is the roll threshold after 0, 1, 2 ...
+    // failed kills; rules without pity pass a single step.
+    void RunOnceTrials(std::vector<uint32> const& curve, uint64 seed, uint64* samples, uint32 count, SimulatorWorkerResult& result)
+    {
+        SimulatorRng rng(seed);
+
+        for (uint32 trial = 0; trial < count; ++trial)
+        {
+            uint64 kills = 1;
+            while (rng.Roll() > curve[std::min<uint64>(kills - 1, curve.size() - 1)])
+            {
+                if (++kills > SIMULATOR_MAX_KILLS_PER_TRIAL)
+                {
+                    ++result.censored;
+                    break;
+                }
+            }
+
+            samples[trial] = kills;
+            result.kills += std::min(kills, SIMULATOR_MAX_KILLS_PER_TRIAL);
+        }
+    }
+
+    // Items dropped in one week of killsPerWeek kills, one sample per simulated week. A worker runs
+    // its weeks back to back, so pity counters and the quota bucket carry over from week to week.
+    // The bucket starts full, as a new one does on the server, and an empty one skips the roll.
+    void RunWeeklyTrials(WeeklyModel const& model, uint64 seed, uint64* samples, uint32 count, SimulatorWorkerResult& result)
+    {
+        SimulatorRng rng(seed);
+
+        std::vector<uint32> const& curve = model.curve;
+        std::size_t misses = 0;
+        uint32 tokens = model.quota;
+        std::size_t nextRefill = 0;
+
+        for (uint32 week = 0; week < count; ++week)
+        {
+            uint64 items = 0;
+            uint64 cycleKill = uint64(week % SIMULATOR_REFILL_CYCLE_WEEKS) * model.killsPerWeek;
+            if (!cycleKill)
+                nextRefill = 0;
+
+            for (uint32 kill = 0; kill < model.killsPerWeek; ++kill, ++cycleKill)
+            {
+                if (model.quota)
+                {
+                    if (nextRefill < model.refillKills.size() && model.refillKills[nextRefill] == cycleKill)
+                    {
+                        tokens = model.quota;
+                        ++nextRefill;
+                    }
+
+                    if (!tokens)
+                    {
+                        ++result.blockedQuota;
+                        continue;
+                    }
+                }
+
+                if (rng.Roll() <= curve[std::min(misses, curve.size() - 1)])
+                {
+                    items += rng.Range(model.minCount, model.maxCount);
+                    misses = 0;
+
+                    if (model.quota)
+                        --tokens;
+                }
+                else
+                    ++misses;
+            }
+
+            samples[week] = items;
+            result.kills += model.killsPerWeek;
+        }
+    }
+
+    // Splits the trials evenly across the workers, each writing its own slice of samples. Worker
+    // seeds are drawn from seed, so a fixed seed and thread count repeat the same run.
+    template<typename TrialFn>
+    SimulatorWorkerResult RunParallel(uint32 threads, uint64 seed, std::vector<uint64>& samples, TrialFn trialFn)
+    {
+        std::vector<SimulatorWorkerResult> results(threads);
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+
+        uint32 const trials = static_cast<uint32>(samples.size());
+        uint32 begin = 0;
+
+        for (uint32 i = 0; i < threads; ++i)
+        {
+            uint32 const count = trials / threads + (i < trials % threads ? 1 : 0);
+            workers.emplace_back(trialFn, SplitMix64(seed), samples.data() + begin, count, std::ref(results[i]));
+            begin += count;
+        }
+
+        for (std::thread& worker : workers)
+            worker.join();
+
+        SimulatorWorkerResult total;
+        for (SimulatorWorkerResult const& result : results)
+        {
+            total.kills += result.kills;
+            total.censored += result.censored;
+            total.blockedQuota += result.blockedQuota;
+        }
+
+        return total;
+    }
+}
+
+namespace BossLoot
+{
+    std::unordered_map<uint32, uint32> ParseKillProfile(std::string const& profile)
+    {
+        std::unordered_map<uint32, uint32> killsPerWeek;
+
+        for (auto const& [entry, kills] : ParseEntryPairs(profile, "BossLoot.Simulate.KillProfile"))
+            killsPerWeek[entry] = kills;
+
+        return killsPerWeek;
+    }
+
+    std::vector<uint32> GetKillsPerWeek(RuleSet const& ruleSet, SimulatorOptions const& options)
+    {
+        std::vector<uint32> killsPerWeek(ruleSet.rules.size(), 0);
+        uint32 const difficulty = std::min<uint32>(options.difficulty, MAX_DIFFICULTY - 1);
+
+        for (auto const& [entry, byDifficulty] : ruleSet.rulesByEntry)
+        {
+            auto const profile = options.killsPerWeek.find(entry);
+            uint32 const kills = profile != options.killsPerWeek.end() ? profile->second : options.defaultKillsPerWeek;
+
+            for (RuleVariant const& variant : byDifficulty[difficulty].variants)
+                killsPerWeek[variant.ruleId] += kills;
+        }
+
+        return killsPerWeek;
+    }
+
+    RuleSimulation SimulateRule(BossLootRule const& rule, uint32 killsPerWeek, SimulatorOptions const& options)
+    {
+        uint32 const threads = std::clamp<uint32>(options.threads ? options.threads : std::thread::hardware_concurrency(), 1, 256);
+        uint32 const trials = std::clamp<uint32>(options.trials, 1, SIMULATOR_MAX_TRIALS);
+        uint32 const difficulty = std::min<uint32>(options.difficulty, MAX_DIFFICULTY - 1);
+        uint64 const seed = options.seed ? options.seed : (static_cast<uint64>(rand32()) << 32) | rand32();
+
+        RuleSimulation simulation;
+        simulation.chancePct = rule.GetChance(difficulty);
+        simulation.killsPerWeek = killsPerWeek;
+
+        uint32 const need = GetRollThreshold(simulation.chancePct);
+        if (!need && !rule.HasPity())
+            return simulation;
+
+        std::vector<uint32> const& pityCurve = rule.pityCurve[difficulty];
+        std::vector<uint32> const curve = rule.HasPity() && !pityCurve.empty() ? pityCurve : std::vector<uint32>{ need };
+        std::vector<uint64> samples(trials);
+
+        if (!rule.allowRepeat)
+        {
+            SimulatorWorkerResult const total = RunParallel(threads, seed, samples,
+                [&curve](uint64 workerSeed, uint64* slice, uint32 count, SimulatorWorkerResult& result)
+                {
+                    RunOnceTrials(curve, workerSeed, slice, count, result);
+                });
+
+            simulation.kind = SimulationKind::Once;
+            simulation.kills = total.kills;
+            simulation.censored = total.censored;
+            simulation.samples = Summarize(samples);
+
+            // Summarize left the samples sorted: trials that dropped within the first week form a prefix.
+            uint64 const firstWeek = static_cast<uint64>(std::upper_bound(samples.begin(), samples.end(), uint64(killsPerWeek)) - samples.begin());
+            simulation.firstWeekPct = static_cast<double>(firstWeek) * 100.0 / static_cast<double>(trials);
+            return simulation;
+        }
+
+        if (!killsPerWeek)
+        {
+            simulation.kind = SimulationKind::NoKills;
+            return simulation;
+        }
+
+        WeeklyModel model;
+        model.curve = curve;
+        model.killsPerWeek = killsPerWeek;
+        model.minCount = rule.minCount;
+        model.maxCount = rule.maxCount;
+
+        if (rule.HasQuota())
+        {
+            model.quota = rule.quota;
+            model.refillKills = GetRefillKills(rule.quotaRefill, options.start ? options.start : std::time(nullptr), killsPerWeek);
+        }
+
+        SimulatorWorkerResult const total = RunParallel(threads, seed, samples,
+            [&model](uint64 workerSeed, uint64* slice, uint32 count, SimulatorWorkerResult& result)
+            {
+                RunWeeklyTrials(model, workerSeed, slice, count, result);
+            });
+
+        simulation.kind = SimulationKind::Weekly;
+        simulation.kills = total.kills;
+        simulation.blockedQuota = total.blockedQuota;
+        simulation.samples = Summarize(samples);
+        return simulation;
+    }
+}
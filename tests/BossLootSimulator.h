@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#ifndef MOD_BOSSLOOT_SIMULATOR_H
+#define MOD_BOSSLOOT_SIMULATOR_H
+
+#include "BossLootRules.h"
+#include "Define.h"
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace BossLoot
+{
+    // Monte Carlo run over a compiled rule set. Once-per-server rules report how many kills (and
+    // weeks, given the kill profile) it takes until the item first drops; repeatable rules report
+    // how many items enter the economy per simulated week, within their Quota. Rolls use
+    // GetRollThreshold, the same threshold as RollDrop, from a fast per-thread generator.
+    struct SimulatorOptions
+    {
+        uint32 trials = 100000;  // per rule: once-rule trials, or simulated weeks for repeatable rules
+        uint32 threads = 0;      // 0 = hardware concurrency
+        uint32 difficulty = 0;   // map difficulty whose DifficultyMask and Chance.N apply
+        uint64 seed = 0;         // 0 = a random seed per run
+        std::time_t start = 0;   // first simulated week, for the QuotaRefill calendar; 0 = now
+        uint32 defaultKillsPerWeek = 1;
+        std::unordered_map<uint32, uint32> killsPerWeek;  // creature entry -> kills per week
+    };
+
+    enum class SimulationKind
+    {
+        Once,        // samples are kills until the first drop
+        Weekly,      // samples are items dropped per week
+        NeverDrops,  // chance 0 without pity, nothing was run
+        NoKills      // repeatable rule with no kills in the profile, nothing was run
+    };
+
+    // Percentiles are nearest-rank.
+    struct SampleSummary
+    {
+        double mean = 0.0;
+        double stddev = 0.0;
+        uint64 p50 = 0;
+        uint64 p90 = 0;
+        uint64 p99 = 0;
+        uint64 max = 0;
+    };
+
+    struct RuleSimulation
+    {
+        SimulationKind kind = SimulationKind::NeverDrops;
+        double chancePct = 0.0;
+        uint32 killsPerWeek = 0;
+        SampleSummary samples;
+        uint64 kills = 0;        // kills simulated for this rule
+        uint64 censored = 0;     // once trials cut off before the item dropped
+        uint64 blockedQuota = 0; // weekly kills skipped because the rule's quota bucket was empty
+        double firstWeekPct = 0.0; // once trials that dropped within the first week of the profile
+    };
+
+    // Parses "entry:kills, entry:kills ...". Malformed pairs are logged and skipped.
+    std::unordered_map<uint32, uint32> ParseKillProfile(std::string const& profile);
+
+    // Kills per week every rule sees under the profile, by rule id. A rule that covers several
+    // creatures sees the kills of all of them.
+    std::vector<uint32> GetKillsPerWeek(RuleSet const& ruleSet, SimulatorOptions const& options);
+
+    // Runs the trials for one rule on options.threads threads and waits for them.
+    RuleSimulation SimulateRule(BossLootRule const& rule, uint32 killsPerWeek, SimulatorOptions const& options);
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Offline drop-rate simulator. Loads the module's .conf through the stub ConfigMgr, compiles the
+// rules as the worldserver would and runs the Monte Carlo trials of BossLootSimulator over them:
+//
+//   bossloot_simulator <mod-talisman-of-binding-shard.conf> [trials] [threads] [difficulty] [seed]
+//
+// creature_template is not available here, so NpcEntry ranges and Rank/Family filters match no
+// creature and only plain NpcEntry values pick up kills from the profile.
+
+#include "BossLootRules.h"
+#include "BossLootSimulator.h"
+#include "Config.h"
+#include "StringConvert.h"
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace BossLoot;
+
+namespace
+{
+    static constexpr char const* CONF_SIMULATE_KILL_PROFILE = "BossLoot.Simulate.KillProfile";
+    static constexpr char const* CONF_SIMULATE_DEFAULT_KILLS = "BossLoot.Simulate.DefaultKillsPerWeek";
+
+    uint64 WeeksFor(uint64 kills, uint32 killsPerWeek)
+    {
+        return (kills + killsPerWeek - 1) / killsPerWeek;
+    }
+
+    void PrintSimulation(BossLootRule const& rule, RuleSimulation const& simulation, uint32 trials)
+    {
+        SampleSummary const& samples = simulation.samples;
+
+        switch (simulation.kind)
+        {
+            case SimulationKind::NeverDrops:
+                fmt::print("Rule {} NPC={} Item={} Chance={:.4f}% never drops, skipped.\n",
+                    rule.index, rule.npcEntry, rule.itemEntry, simulation.chancePct);
+                break;
+            case SimulationKind::NoKills:
+                fmt::print("Rule {} NPC={} Item={} has no kills in the profile, skipped.\n",
+                    rule.index, rule.npcEntry, rule.itemEntry);
+                break;
+            case SimulationKind::Once:
+                fmt::print("Rule {} NPC={} Item={} Chance={:.4f}% Once Trials={} KillsToDrop mean={:.1f} stddev={:.1f} p50={} p90={} p99={} max={} Censored={}\n",
+                    rule.index, rule.npcEntry, rule.itemEntry, simulation.chancePct, trials, samples.mean, samples.stddev,
+                    samples.p50, samples.p90, samples.p99, samples.max, simulation.censored);
+
+                if (uint32 const killsPerWeek = simulation.killsPerWeek)
+                    fmt::print("Rule {} KillsPerWeek={} WeeksToDrop mean={:.2f} p50={} p90={} p99={} FirstWeek={:.2f}%\n",
+                        rule.index, killsPerWeek, samples.mean / static_cast<double>(killsPerWeek),
+                        WeeksFor(samples.p50, killsPerWeek), WeeksFor(samples.p90, killsPerWeek), WeeksFor(samples.p99, killsPerWeek),
+                        simulation.firstWeekPct);
+                break;
+            case SimulationKind::Weekly:
+                fmt::print("Rule {} NPC={} Item={} Chance={:.4f}% Repeat Weeks={} KillsPerWeek={} ItemsPerWeek mean={:.3f} stddev={:.3f} p50={} p90={} p99={} max={}\n",
+                    rule.index, rule.npcEntry, rule.itemEntry, simulation.chancePct, trials, simulation.killsPerWeek, samples.mean, samples.stddev,
+                    samples.p50, samples.p90, samples.p99, samples.max);
+
+                if (rule.HasQuota())
+                    fmt::print("Rule {} Quota={} KillsBlockedByQuota={:.2f}%\n", rule.index, rule.quota,
+                        static_cast<double>(simulation.blockedQuota) * 100.0 / static_cast<double>(simulation.kills));
+                break;
+        }
+    }
+
+    bool ParseArgument(int argc, char* argv[], int index, uint32& value)
+    {
+        if (index >= argc)
+            return true;
+
+        Optional<uint32> const parsed = Acore::StringTo<uint32>(argv[index]);
+        if (!parsed)
+            return false;
+
+        value = *parsed;
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    SimulatorOptions options;
+    uint32 seed = 0;
+
+    if (argc < 2 || !ParseArgument(argc, argv, 2, options.trials) || !ParseArgument(argc, argv, 3, options.threads)
+        || !ParseArgument(argc, argv, 4, options.difficulty) || !ParseArgument(argc, argv, 5, seed))
+    {
+        std::fprintf(stderr, "Usage: %s <mod-talisman-of-binding-shard.conf> [trials] [threads] [difficulty] [seed]\n", argv[0]);
+        return 2;
+    }
+
+    if (!sConfigMgr->LoadFile(argv[1]))
+    {
+        std::fprintf(stderr, "Cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    options.seed = seed;
+    options.defaultKillsPerWeek = sConfigMgr->GetOption<uint32>(CONF_SIMULATE_DEFAULT_KILLS, 1);
+    options.killsPerWeek = ParseKillProfile(sConfigMgr->GetOption<std::string>(CONF_SIMULATE_KILL_PROFILE, ""));
+
+    bool enabled = true;
+    bool resetAllOnStartup = false;
+    std::vector<BossLootRule> rules = LoadRulesFromConfig(enabled, resetAllOnStartup);
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(enabled, std::move(rules), std::time(nullptr));
+    std::vector<uint32> const killsPerWeek = GetKillsPerWeek(*ruleSet, options);
+
+    fmt::print("Simulation: Rules={} Trials={} Threads={} Difficulty={} DefaultKillsPerWeek={} ProfileEntries={}\n",
+        uint32(ruleSet->rules.size()), options.trials, options.threads, options.difficulty, options.defaultKillsPerWeek,
+        uint32(options.killsPerWeek.size()));
+
+    auto const start = std::chrono::steady_clock::now();
+    uint64 kills = 0;
+
+    for (uint32 i = 0; i < ruleSet->rules.size(); ++i)
+    {
+        BossLootRule const& rule = ruleSet->rules[i];
+        if (!rule.enable || !rule.AllowsDifficulty(options.difficulty))
+            continue;
+
+        // Timed rules are only in the index, and so in the kill profile, while they are active.
+        if (!ruleSet->active[i])
+        {
+            fmt::print("Rule {} is outside its activation window, skipped.\n", rule.index);
+            continue;
+        }
+
+        RuleSimulation const simulation = SimulateRule(rule, killsPerWeek[i], options);
+        PrintSimulation(rule, simulation, options.trials);
+        kills += simulation.kills;
+    }
+
+    double const elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fmt::print("Simulation finished: SimulatedKills={} Elapsed={:.3f}s Throughput={:.0f} kills/s\n",
+        kills, elapsedSec, elapsedSec > 0.0 ? static_cast<double>(kills) / elapsedSec : 0.0);
+
+    return 0;
+}
@@ -0,0 +1,870 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+#include "BossLootEvaluator.h"
+#include "BossLootRules.h"
+#include "BossLootSchedule.h"
+#include "BossLootSharedMemory.h"
+#include "BossLootSimulator.h"
+#include "BossLootState.h"
+#include "Config.h"
+#include "LootMgr.h"
+#include "ObjectGuid.h"
+#include "ObjectMgr.h"
+#include "Timer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace BossLoot;
+
+namespace
+{
+    static constexpr uint32 BOSS_ENTRY = 12056;
+    static constexpr uint32 OTHER_BOSS_ENTRY = 11502;
+    static constexpr uint32 ITEM_ENTRY = 17782;
+    static constexpr uint32 OTHER_ITEM_ENTRY = 17204;
+
+    BossLootRule MakeRule(uint32 index, uint32 npcEntry, uint32 itemEntry, double chancePct)
+    {
+        BossLootRule rule;
+        rule.index = index;
+        rule.npcEntry = npcEntry;
+        rule.itemEntry = itemEntry;
+        rule.chancePct = chancePct;
+        return rule;
+    }
+
+    BossLootRule MakeOnceRule(uint32 index, uint32 npcEntry, uint32 itemEntry, double chancePct)
+    {
+        BossLootRule rule = MakeRule(index, npcEntry, itemEntry, chancePct);
+        rule.allowRepeat = false;
+        rule.onceKey = Acore::StringFormat("test_rule{}", index);
+        return rule;
+    }
+
+    // Local time, as the cron fields and the activation window are read in it.
+    std::time_t MakeLocalTime(int year, int month, int day, int hour, int minute)
+    {
+        std::tm local{};
+        local.tm_year = year - 1900;
+        local.tm_mon = month - 1;
+        local.tm_mday = day;
+        local.tm_hour = hour;
+        local.tm_min = minute;
+        local.tm_isdst = -1;
+        return std::mktime(&local);
+    }
+
+    // EvaluateRules context for one corpse, with its own stores, that records what it was asked.
+    class TestKill
+    {
+    public:
+        TestKill(OnceStateStore& onceState, CorpseItemSet& corpseItems, uint32 mapId = 0)
+            : _onceState(onceState), _corpseItems(corpseItems), _mapId(mapId) { }
+
+        uint32 MapId() const { return _mapId; }
+        BossLootRuleStats& Stats(BossLootRule const& rule) { return stats[rule.index]; }
+        bool HasCorpseItem(uint32 itemEntry) { return _corpseItems.Contains(itemEntry); }
+        void SkippedDuplicate(BossLootRule const& /*rule*/, uint32 itemEntry) { skipped.push_back(itemEntry); }
+        bool IsOnceDropped(BossLootRule const& rule) { return _onceState.IsDropped(rule.onceKey); }
+        bool ReserveOnce(BossLootRule const& rule, uint32 /*itemEntry*/) { return _onceState.Reserve(rule.onceKey); }
+
+        bool RollPity(BossLootRule const& rule) { return RollThreshold(GetPityThreshold(rule.pityCurve[REGULAR_DIFFICULTY], pityMisses)); }
+
+        void RecordPityResult(BossLootRule const& /*rule*/, bool dropped)
+        {
+            pityMisses = dropped ? 0 : pityMisses + 1;
+        }
+
+        void Inject(BossLootRule const& rule, uint32 itemEntry)
+        {
+            _corpseItems.Insert(itemEntry);
+            injected.emplace_back(rule.index, itemEntry);
+        }
+
+        std::array<BossLootRuleStats, MAX_RULES + 1> stats;
+        std::vector<std::pair<uint32, uint32>> injected; // rule index, item entry
+        std::vector<uint32> skipped;
+        uint32 pityMisses = 0;
+
+    private:
+        OnceStateStore& _onceState;
+        CorpseItemSet& _corpseItems;
+        uint32 _mapId;
+    };
+
+    // Fixed seed, so a failure reproduces.
+    SimulatorOptions MakeSimulatorOptions(uint32 trials)
+    {
+        SimulatorOptions options;
+        options.trials = trials;
+        options.threads = 4;
+        options.seed = 0x5EED;
+        return options;
+    }
+
+    RuleVariantList const& FindBossRules(RuleSet const& ruleSet, uint32 difficulty = REGULAR_DIFFICULTY)
+    {
+        RuleVariantList const* list = ruleSet.FindRules(BOSS_ENTRY, difficulty);
+        EXPECT_NE(list, nullptr);
+        return *list;
+    }
+
+    class ConfigTest : public ::testing::Test
+    {
+    protected:
+        void TearDown() override
+        {
+            sConfigMgr->Clear();
+            sObjectMgr->Clear();
+        }
+    };
+}
+
+TEST(CompileRuleSetTest, IndexesRulesByEntryInConfigOrder)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 5.0));
+    rules.push_back(MakeRule(2, OTHER_BOSS_ENTRY, ITEM_ENTRY, 5.0));
+    rules.push_back(MakeRule(3, BOSS_ENTRY, OTHER_ITEM_ENTRY, 5.0));
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+    ASSERT_EQ(list.size(), 2u);
+    EXPECT_EQ(list.variants[0].ruleId, 0u);
+    EXPECT_EQ(list.variants[1].ruleId, 2u);
+    EXPECT_EQ(list.rollBounds.size(), list.size());
+
+    EXPECT_EQ(ruleSet->rules[2].ruleId, 2u);
+    EXPECT_EQ(ruleSet->FindRules(OTHER_BOSS_ENTRY, REGULAR_DIFFICULTY)->size(), 1u);
+    EXPECT_EQ(ruleSet->FindRules(BOSS_ENTRY + 1, REGULAR_DIFFICULTY), nullptr);
+    EXPECT_EQ(ruleSet->FindRules(BOSS_ENTRY, MAX_DIFFICULTY), nullptr);
+}
+
+TEST(CompileRuleSetTest, LeavesDisabledRulesOutOfTheIndex)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 5.0));
+    rules.back().enable = false;
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+
+    EXPECT_EQ(ruleSet->FindRules(BOSS_ENTRY, REGULAR_DIFFICULTY), nullptr);
+    EXPECT_EQ(ruleSet->rules.size(), 1u);
+}
+
+TEST(CompileRuleSetTest, SplitsVariantsByDifficulty)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 5.0));
+    rules.back().difficultyMask = (1 << RAID_DIFFICULTY_25MAN_NORMAL) | (1 << RAID_DIFFICULTY_25MAN_HEROIC);
+    rules.back().difficultyChancePct[RAID_DIFFICULTY_25MAN_HEROIC] = 100.0;
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+
+    EXPECT_EQ(ruleSet->FindRules(BOSS_ENTRY, RAID_DIFFICULTY_10MAN_NORMAL), nullptr);
+    EXPECT_EQ(ruleSet->FindRules(BOSS_ENTRY, RAID_DIFFICULTY_10MAN_HEROIC), nullptr);
+
+    RuleVariantList const& normal = FindBossRules(*ruleSet, RAID_DIFFICULTY_25MAN_NORMAL);
+    RuleVariantList const& heroic = FindBossRules(*ruleSet, RAID_DIFFICULTY_25MAN_HEROIC);
+    EXPECT_EQ(normal.rollBounds[0], GetRollBound(GetRollThreshold(5.0)));
+    EXPECT_EQ(heroic.rollBounds[0], GetRollBound(GetRollThreshold(100.0)));
+}
+
+TEST(CompileRuleSetTest, MarksOnceAndPityVariantsToRollAtTheKill)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 5.0));
+    rules.push_back(MakeOnceRule(2, BOSS_ENTRY, ITEM_ENTRY + 1, 5.0));
+    rules.push_back(MakeRule(3, BOSS_ENTRY, ITEM_ENTRY + 2, 5.0));
+    rules.back().pityStepPct = 1.0;
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+    EXPECT_EQ(list.killRollMask, 0b110u);
+    EXPECT_FALSE(ruleSet->rules[2].pityCurve[REGULAR_DIFFICULTY].empty());
+}
+
+TEST(CompileRuleSetTest, GivesEverySetANewGeneration)
+{
+    std::shared_ptr<RuleSet const> first = CompileRuleSet(true, {}, std::time(nullptr));
+    std::shared_ptr<RuleSet const> second = CompileRuleSet(true, {}, std::time(nullptr));
+
+    EXPECT_NE(first->generation, second->generation);
+}
+
+TEST(CompileRuleSetTest, LeavesRulesOutsideTheirWindowOutOfTheIndex)
+{
+    std::time_t const now = MakeLocalTime(2026, 12, 24, 20, 0);
+
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 5.0));
+    rules.back().activeFrom = MakeLocalTime(2026, 12, 25, 0, 0);
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), now);
+
+    EXPECT_TRUE(ruleSet->timed);
+    EXPECT_FALSE(ruleSet->active[0]);
+    EXPECT_EQ(ruleSet->FindRules(BOSS_ENTRY, REGULAR_DIFFICULTY), nullptr);
+}
+
+TEST_F(ConfigTest, LoadsConfiguredRules)
+{
+    sConfigMgr->SetOption("BossLoot.RuleCount", "2");
+    sConfigMgr->SetOption("BossLoot.Rule.1.NpcEntry", "12056, 11502");
+    sConfigMgr->SetOption("BossLoot.Rule.1.ItemEntry", "17782");
+    sConfigMgr->SetOption("BossLoot.Rule.1.Chance", "2.5");
+    sConfigMgr->SetOption("BossLoot.Rule.1.AllowRepeat", "0");
+    sConfigMgr->SetOption("BossLoot.Rule.1.Difficulty", "1,3");
+    sConfigMgr->SetOption("BossLoot.Rule.1.MinCount", "3");
+    sConfigMgr->SetOption("BossLoot.Rule.1.MaxCount", "2");
+    sConfigMgr->SetOption("BossLoot.Rule.2.NpcEntry", "12056");
+
+    bool enabled = false;
+    bool resetAllOnStartup = true;
+    std::vector<BossLootRule> rules = LoadRulesFromConfig(enabled, resetAllOnStartup);
+
+    EXPECT_TRUE(enabled);
+    EXPECT_FALSE(resetAllOnStartup);
+
+    // Rule 2 has no ItemEntry or Pool, so it is skipped.
+    ASSERT_EQ(rules.size(), 1u);
+
+    BossLootRule const& rule = rules[0];
+    EXPECT_EQ(rule.npcEntry, BOSS_ENTRY);
+    EXPECT_EQ(rule.npcEntries.size(), 2u);
+    EXPECT_EQ(rule.itemEntry, ITEM_ENTRY);
+    EXPECT_DOUBLE_EQ(rule.chancePct, 2.5);
+    EXPECT_EQ(rule.difficultyMask, 0b1010u);
+    EXPECT_EQ(rule.minCount, 2u);
+    EXPECT_EQ(rule.maxCount, 3u);
+    EXPECT_TRUE(rule.IsOnce(OnceScope::Server));
+    EXPECT_EQ(rule.onceKey, "bossloot_rule1_npc12056_item17782");
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(enabled, std::move(rules), std::time(nullptr));
+    EXPECT_NE(ruleSet->FindRules(OTHER_BOSS_ENTRY, DUNGEON_DIFFICULTY_HEROIC), nullptr);
+    EXPECT_EQ(ruleSet->FindRules(OTHER_BOSS_ENTRY, DUNGEON_DIFFICULTY_NORMAL), nullptr);
+}
+
+TEST_F(ConfigTest, FallsBackToTheLegacyRule)
+{
+    bool enabled = false;
+    bool resetAllOnStartup = false;
+    std::vector<BossLootRule> rules = LoadRulesFromConfig(enabled, resetAllOnStartup);
+
+    ASSERT_EQ(rules.size(), 1u);
+    EXPECT_EQ(rules[0].npcEntry, BOSS_ENTRY);
+    EXPECT_EQ(rules[0].itemEntry, ITEM_ENTRY);
+    EXPECT_EQ(rules[0].onceKey, LEGACY_KEY_NAME);
+}
+
+TEST_F(ConfigTest, ExpandsRankFiltersAgainstCreatureTemplates)
+{
+    sObjectMgr->AddCreatureTemplate({ BOSS_ENTRY, "Baron Geddon", 3, 0 });
+    sObjectMgr->AddCreatureTemplate({ OTHER_BOSS_ENTRY, "Garr", 3, 0 });
+    sObjectMgr->AddCreatureTemplate({ 11666, "Firelord", 1, 0 });
+
+    sConfigMgr->SetOption("BossLoot.RuleCount", "1");
+    sConfigMgr->SetOption("BossLoot.Rule.1.Rank", "3");
+    sConfigMgr->SetOption("BossLoot.Rule.1.ItemEntry", "17782");
+
+    bool enabled = false;
+    bool resetAllOnStartup = false;
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, LoadRulesFromConfig(enabled, resetAllOnStartup), std::time(nullptr));
+
+    EXPECT_EQ(ruleSet->rules[0].matchedEntries, 2u);
+    EXPECT_NE(ruleSet->FindRules(BOSS_ENTRY, REGULAR_DIFFICULTY), nullptr);
+    EXPECT_NE(ruleSet->FindRules(OTHER_BOSS_ENTRY, REGULAR_DIFFICULTY), nullptr);
+    EXPECT_EQ(ruleSet->FindRules(11666, REGULAR_DIFFICULTY), nullptr);
+}
+
+TEST(EvaluateRulesTest, InjectsCertainDropsAndNeverImpossibleOnes)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+    rules.push_back(MakeRule(2, BOSS_ENTRY, OTHER_ITEM_ENTRY, 0.0));
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+
+    OnceStateStore onceState;
+
+    for (uint32 kill = 0; kill < 100; ++kill)
+    {
+        CorpseItemSet corpseItems;
+        TestKill context(onceState, corpseItems);
+        EvaluateRules(context, *ruleSet, list);
+
+        ASSERT_EQ(context.injected.size(), 1u);
+        EXPECT_EQ(context.injected[0].second, ITEM_ENTRY);
+        EXPECT_EQ(context.stats[1].hits.load(), 1u);
+        EXPECT_EQ(context.stats[2].rolled.load(), 1u);
+        EXPECT_EQ(context.stats[2].hits.load(), 0u);
+    }
+}
+
+TEST(EvaluateRulesTest, DropsAOnceRuleOnlyOnce)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeOnceRule(1, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+
+    OnceStateStore onceState;
+    uint32 drops = 0;
+
+    for (uint32 kill = 0; kill < 10; ++kill)
+    {
+        CorpseItemSet corpseItems;
+        TestKill context(onceState, corpseItems);
+        EvaluateRules(context, *ruleSet, list);
+        drops += context.injected.size();
+    }
+
+    EXPECT_EQ(drops, 1u);
+    EXPECT_TRUE(onceState.IsDropped("test_rule1"));
+}
+
+TEST(EvaluateRulesTest, SkipsItemsAlreadyOnTheCorpse)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+    rules.push_back(MakeRule(2, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+    rules.push_back(MakeRule(3, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+    rules.back().preventDuplicate = false;
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+
+    OnceStateStore onceState;
+    CorpseItemSet corpseItems;
+    TestKill context(onceState, corpseItems);
+    EvaluateRules(context, *ruleSet, list);
+
+    // Rule 2 sees the item rule 1 injected; rule 3 does not look.
+    ASSERT_EQ(context.injected.size(), 2u);
+    EXPECT_EQ(context.injected[0].first, 1u);
+    EXPECT_EQ(context.injected[1].first, 3u);
+    EXPECT_EQ(context.skipped, std::vector<uint32>{ ITEM_ENTRY });
+    EXPECT_EQ(context.stats[2].skippedDuplicate.load(), 1u);
+}
+
+TEST(EvaluateRulesTest, StopsAtTheQuota)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+    rules.back().quota = 3;
+    rules.back().quotaKey = "test_quota";
+
+    QuotaStore quotas;
+    QuotaBucket* bucket = quotas.Bind("test_quota", 3);
+    quotas.Restore(*bucket, 3, std::time(nullptr));
+    rules.back().quotaBucket = bucket;
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+
+    OnceStateStore onceState;
+    uint32 drops = 0;
+    uint64 blocked = 0;
+
+    for (uint32 kill = 0; kill < 5; ++kill)
+    {
+        CorpseItemSet corpseItems;
+        TestKill context(onceState, corpseItems);
+        EvaluateRules(context, *ruleSet, list);
+        drops += context.injected.size();
+        blocked += context.stats[1].blockedQuota.load();
+    }
+
+    EXPECT_EQ(drops, 3u);
+    EXPECT_EQ(blocked, 2u);
+    EXPECT_EQ(bucket->tokens.load(), 0);
+}
+
+TEST(EvaluateRulesTest, GivesTheQuotaTokenBackWhenTheOnceKeyIsTaken)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeOnceRule(1, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+    rules.back().quota = 1;
+    rules.back().quotaKey = "test_quota_once";
+
+    QuotaStore quotas;
+    QuotaBucket* bucket = quotas.Bind("test_quota_once", 1);
+    quotas.Restore(*bucket, 1, std::time(nullptr));
+    rules.back().quotaBucket = bucket;
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+
+    // Another kill reserved the key between the IsOnceDropped check and the reservation.
+    class RacingKill : public TestKill
+    {
+    public:
+        using TestKill::TestKill;
+        bool IsOnceDropped(BossLootRule const& /*rule*/) { return false; }
+    };
+
+    OnceStateStore onceState;
+    onceState.Reserve("test_rule1");
+
+    CorpseItemSet corpseItems;
+    RacingKill context(onceState, corpseItems);
+    EvaluateRules(context, *ruleSet, list);
+
+    EXPECT_TRUE(context.injected.empty());
+    EXPECT_EQ(context.stats[1].blockedOnce.load(), 1u);
+    EXPECT_EQ(bucket->tokens.load(), 1);
+}
+
+TEST(EvaluateRulesTest, RunsRulesWithDifferentFlagsInConfigOrder)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+    rules.push_back(MakeOnceRule(2, BOSS_ENTRY, ITEM_ENTRY + 1, 100.0));
+    rules.push_back(MakeRule(3, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+    rules.push_back(MakeRule(4, BOSS_ENTRY, 0, 100.0));
+    rules.back().pool = BuildItemPool({ { OTHER_ITEM_ENTRY, 1 } });
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+
+    OnceStateStore onceState;
+    CorpseItemSet corpseItems;
+    TestKill context(onceState, corpseItems);
+    EvaluateRules(context, *ruleSet, list);
+
+    std::vector<std::pair<uint32, uint32>> const expected = { { 1, ITEM_ENTRY }, { 2, ITEM_ENTRY + 1 }, { 4, OTHER_ITEM_ENTRY } };
+    EXPECT_EQ(context.injected, expected);
+    EXPECT_EQ(context.skipped, std::vector<uint32>{ ITEM_ENTRY });
+}
+
+TEST(EvaluateRulesTest, GuaranteesAPityDrop)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 0.0));
+    rules.back().pityGuarantee = 5;
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+
+    OnceStateStore onceState;
+    CorpseItemSet corpseItems;
+    TestKill context(onceState, corpseItems);
+
+    for (uint32 kill = 0; kill < 5; ++kill)
+    {
+        corpseItems.Clear();
+        EvaluateRules(context, *ruleSet, list);
+    }
+
+    ASSERT_EQ(context.injected.size(), 1u);
+    EXPECT_EQ(context.pityMisses, 0u);
+}
+
+TEST(EvaluateRulesTest, SkipsRulesForOtherMaps)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+    rules.back().maps = { { 409, 409 } };
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+
+    OnceStateStore onceState;
+
+    CorpseItemSet elsewhereItems;
+    TestKill elsewhere(onceState, elsewhereItems, 469);
+    EvaluateRules(elsewhere, *ruleSet, list);
+    EXPECT_TRUE(elsewhere.injected.empty());
+
+    CorpseItemSet moltenCoreItems;
+    TestKill moltenCore(onceState, moltenCoreItems, 409);
+    EvaluateRules(moltenCore, *ruleSet, list);
+    EXPECT_EQ(moltenCore.injected.size(), 1u);
+}
+
+TEST(OnceStateStoreTest, KeepsAReservationAcrossAReloadWhileItsWriteIsPending)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeOnceRule(1, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+    RuleVariantList const& list = FindBossRules(*ruleSet);
+
+    OnceStateStore onceState;
+    onceState.Merge({ { "test_rule1", false } });
+
+    CorpseItemSet firstItems;
+    TestKill first(onceState, firstItems);
+    EvaluateRules(first, *ruleSet, list);
+    ASSERT_EQ(first.injected.size(), 1u);
+
+    // The kill phase write has not reached the database yet, so the reload still reads it as free.
+    onceState.Merge({ { "test_rule1", false }, { "test_rule2", true } });
+
+    EXPECT_TRUE(onceState.IsDropped("test_rule1"));
+    EXPECT_TRUE(onceState.IsDropped("test_rule2"));
+
+    CorpseItemSet secondItems;
+    TestKill second(onceState, secondItems);
+    EvaluateRules(second, *ruleSet, list);
+    EXPECT_TRUE(second.injected.empty());
+    EXPECT_EQ(second.stats[1].blockedOnce.load(), 1u);
+}
+
+TEST(PityStoreTest, KeepsProgressAcrossDifficultiesWithShorterCurves)
+{
+    static constexpr uint32 CHARACTER_ID = 1;
+
+    // Only the seventh kill on the long curve can drop; the short one guarantees the second.
+    std::vector<uint32> longCurve(10, 0);
+    longCurve[6] = ROLL_SCALE;
+    std::vector<uint32> const shortCurve = { 0, ROLL_SCALE };
+
+    PityStore store;
+    uint32 const pityId = store.Intern("test_pity");
+    store.BeginLoad(CHARACTER_ID);
+    store.Load(CHARACTER_ID, {});
+
+    for (uint32 kill = 0; kill < 5; ++kill)
+    {
+        EXPECT_FALSE(store.Roll(CHARACTER_ID, pityId, longCurve));
+        store.Record(CHARACTER_ID, pityId, false);
+    }
+
+    // A miss on the short curve's difficulty must not cut the count back to its length.
+    store.Record(CHARACTER_ID, pityId, false);
+
+    EXPECT_TRUE(store.Roll(CHARACTER_ID, pityId, longCurve));
+    EXPECT_TRUE(store.Roll(CHARACTER_ID, pityId, shortCurve));
+
+    std::vector<PityWrite> const writes = store.TakeWrites();
+    ASSERT_EQ(writes.size(), 1u);
+    EXPECT_EQ(writes[0].misses, 6u);
+}
+
+TEST(PendingDropStoreTest, TakesEachDropOnce)
+{
+    PendingDropStore store;
+
+    PendingInjectedDrop pending;
+    pending.lootGuid = ObjectGuid(HighGuid::Unit, BOSS_ENTRY, 1);
+    pending.ruleId = 4;
+    pending.itemEntry = ITEM_ENTRY;
+    store.Remember(pending);
+
+    EXPECT_EQ(store.Size(), 1u);
+    EXPECT_TRUE(store.MayHold(pending.lootGuid, ITEM_ENTRY));
+
+    PendingInjectedDrop taken;
+    EXPECT_FALSE(store.Take(pending.lootGuid, OTHER_ITEM_ENTRY, taken));
+    EXPECT_FALSE(store.Take(ObjectGuid(HighGuid::Unit, BOSS_ENTRY, 2), ITEM_ENTRY, taken));
+
+    ASSERT_TRUE(store.Take(pending.lootGuid, ITEM_ENTRY, taken));
+    EXPECT_EQ(taken.ruleId, 4u);
+    EXPECT_FALSE(store.Take(pending.lootGuid, ITEM_ENTRY, taken));
+
+    EXPECT_EQ(store.Size(), 0u);
+    EXPECT_FALSE(store.MayHold(pending.lootGuid, ITEM_ENTRY));
+}
+
+TEST(PendingDropStoreTest, KeepsTheFilterBitWhileAnotherDropSharesTheSlot)
+{
+    PendingDropStore store;
+
+    PendingInjectedDrop first;
+    first.lootGuid = ObjectGuid(HighGuid::Unit, BOSS_ENTRY, 1);
+    first.itemEntry = ITEM_ENTRY;
+
+    PendingInjectedDrop second = first;
+    second.itemEntry = ITEM_ENTRY + PendingDropStore::ITEM_FILTER_SLOTS;
+
+    store.Remember(first);
+    store.Remember(second);
+
+    PendingInjectedDrop taken;
+    ASSERT_TRUE(store.Take(first.lootGuid, first.itemEntry, taken));
+    EXPECT_TRUE(store.MayHold(second.lootGuid, second.itemEntry));
+    ASSERT_TRUE(store.Take(second.lootGuid, second.itemEntry, taken));
+    EXPECT_FALSE(store.MayHold(second.lootGuid, second.itemEntry));
+}
+
+TEST(PendingDropStoreTest, ExpiresOnlyOldDrops)
+{
+    PendingDropStore store;
+
+    for (uint32 i = 0; i < 64; ++i)
+    {
+        PendingInjectedDrop pending;
+        pending.lootGuid = ObjectGuid(HighGuid::Unit, BOSS_ENTRY, i + 1);
+        pending.itemEntry = ITEM_ENTRY;
+        pending.injectedAt = 1000 + i;
+        store.Remember(pending);
+    }
+
+    std::vector<PendingInjectedDrop> expired;
+    store.Expire(1032, expired);
+
+    EXPECT_EQ(expired.size(), 32u);
+    EXPECT_EQ(store.Size(), 32u);
+
+    for (PendingInjectedDrop const& pending : expired)
+        EXPECT_LT(pending.injectedAt, 1032u);
+
+    PendingInjectedDrop taken;
+    EXPECT_FALSE(store.Take(ObjectGuid(HighGuid::Unit, BOSS_ENTRY, 1), ITEM_ENTRY, taken));
+    EXPECT_TRUE(store.Take(ObjectGuid(HighGuid::Unit, BOSS_ENTRY, 64), ITEM_ENTRY, taken));
+
+    store.Clear();
+    EXPECT_EQ(store.Size(), 0u);
+}
+
+TEST(CronScheduleTest, ParsesFieldsAndMatchesLocalTime)
+{
+    CronSchedule schedule;
+    ASSERT_TRUE(schedule.Parse("*/15 18-23 * 12 1-5"));
+
+    // 2026-12-24 is a Thursday.
+    std::tm match = Acore::Time::TimeBreakdown(MakeLocalTime(2026, 12, 24, 20, 45));
+    EXPECT_TRUE(schedule.Matches(match));
+
+    std::tm offMinute = Acore::Time::TimeBreakdown(MakeLocalTime(2026, 12, 24, 20, 44));
+    EXPECT_FALSE(schedule.Matches(offMinute));
+
+    std::tm offHour = Acore::Time::TimeBreakdown(MakeLocalTime(2026, 12, 24, 17, 45));
+    EXPECT_FALSE(schedule.Matches(offHour));
+
+    std::tm weekend = Acore::Time::TimeBreakdown(MakeLocalTime(2026, 12, 26, 20, 45));
+    EXPECT_FALSE(schedule.Matches(weekend));
+}
+
+TEST(CronScheduleTest, MatchesEitherRestrictedDayField)
+{
+    CronSchedule schedule;
+    ASSERT_TRUE(schedule.Parse("0 0 1 * 0"));
+
+    // The 1st of the month, a Tuesday, and a Sunday that is not the 1st.
+    std::tm first = Acore::Time::TimeBreakdown(MakeLocalTime(2026, 12, 1, 0, 0));
+    std::tm sunday = Acore::Time::TimeBreakdown(MakeLocalTime(2026, 12, 6, 0, 0));
+    std::tm monday = Acore::Time::TimeBreakdown(MakeLocalTime(2026, 12, 7, 0, 0));
+
+    EXPECT_TRUE(schedule.Matches(first));
+    EXPECT_TRUE(schedule.Matches(sunday));
+    EXPECT_FALSE(schedule.Matches(monday));
+
+    CronSchedule sundaySeven;
+    ASSERT_TRUE(sundaySeven.Parse("0 0 * * 7"));
+    EXPECT_TRUE(sundaySeven.Matches(sunday));
+}
+
+TEST(CronScheduleTest, RejectsMalformedExpressions)
+{
+    CronSchedule schedule;
+    ASSERT_TRUE(schedule.Parse("30 6 * * 3"));
+
+    EXPECT_FALSE(schedule.Parse(""));
+    EXPECT_FALSE(schedule.Parse("* * * *"));
+    EXPECT_FALSE(schedule.Parse("* * * * * *"));
+    EXPECT_FALSE(schedule.Parse("60 * * * *"));
+    EXPECT_FALSE(schedule.Parse("* 24 * * *"));
+    EXPECT_FALSE(schedule.Parse("* * 0 * *"));
+    EXPECT_FALSE(schedule.Parse("* * * 13 *"));
+    EXPECT_FALSE(schedule.Parse("5-1 * * * *"));
+    EXPECT_FALSE(schedule.Parse("*/0 * * * *"));
+    EXPECT_FALSE(schedule.Parse("a * * * *"));
+
+    // A failed parse leaves the schedule as it was.
+    std::tm wednesday = Acore::Time::TimeBreakdown(MakeLocalTime(2026, 12, 23, 6, 30));
+    EXPECT_TRUE(schedule.Matches(wednesday));
+}
+
+TEST(CronScheduleTest, CountsMatchingMinutesInARange)
+{
+    CronSchedule hourly;
+    ASSERT_TRUE(hourly.Parse("0 * * * *"));
+
+    std::time_t const start = MakeLocalTime(2026, 12, 24, 12, 0);
+
+    // (after, until]: the start itself is not counted, the end is.
+    EXPECT_EQ(hourly.CountMatches(start, start + 3 * HOUR), 3u);
+    EXPECT_EQ(hourly.CountMatches(start, start + 3 * HOUR - 1), 2u);
+    EXPECT_EQ(hourly.CountMatches(start - 1, start), 1u);
+    EXPECT_EQ(hourly.CountMatches(start, start), 0u);
+
+    CronSchedule everyMinute;
+    ASSERT_TRUE(everyMinute.Parse("* * * * *"));
+    EXPECT_EQ(everyMinute.CountMatches(start, start + HOUR), 60u);
+}
+
+TEST(LootTest, RemovesTheItemFromOpenLootWindows)
+{
+    Loot loot;
+    AddItemToLoot(&loot, OTHER_ITEM_ENTRY, 1, 1);
+    AddItemToLoot(&loot, ITEM_ENTRY, 1, 1);
+    loot.quest_items.push_back({ ITEM_ENTRY + 1, 1, false });
+
+    ASSERT_TRUE(RemoveItemFromLoot(&loot, ITEM_ENTRY));
+    EXPECT_TRUE(loot.items[1].is_looted);
+    EXPECT_EQ(loot.unlootedCount, 1u);
+    EXPECT_EQ(loot.removedItems, std::vector<uint8>{ 1 });
+    EXPECT_FALSE(RemoveItemFromLoot(&loot, ITEM_ENTRY));
+
+    ASSERT_TRUE(RemoveItemFromLoot(&loot, ITEM_ENTRY + 1));
+    EXPECT_EQ(loot.removedQuestItems, std::vector<uint8>{ 0 });
+
+    EXPECT_FALSE(RemoveItemFromLoot(nullptr, ITEM_ENTRY));
+}
+
+TEST(LootTest, GathersTheCorpseItemsSorted)
+{
+    Loot loot;
+    for (uint32 i = CorpseItemSet::INLINE_CAPACITY * 2; i > 0; --i)
+        AddItemToLoot(&loot, ITEM_ENTRY + i, 1, 1);
+
+    AddItemToLoot(&loot, ITEM_ENTRY + 1, 1, 1);
+
+    CorpseItemSet corpseItems;
+    corpseItems.Gather(&loot);
+
+    EXPECT_EQ(corpseItems.Size(), CorpseItemSet::INLINE_CAPACITY * 2);
+    EXPECT_TRUE(std::is_sorted(corpseItems.begin(), corpseItems.end()));
+    EXPECT_TRUE(corpseItems.Contains(ITEM_ENTRY + 1));
+    EXPECT_FALSE(corpseItems.Contains(ITEM_ENTRY));
+
+    corpseItems.Insert(ITEM_ENTRY);
+    EXPECT_TRUE(corpseItems.Contains(ITEM_ENTRY));
+}
+
+TEST(OnceFlagSegmentTest, SharesFlagsBetweenSessions)
+{
+    std::string const name = Acore::StringFormat("/bossloot_test_{}", getpid());
+
+    std::unique_ptr<OnceFlagSegment> first = OnceFlagSegment::Open(name);
+    std::unique_ptr<OnceFlagSegment> second = OnceFlagSegment::Open(name);
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    EXPECT_TRUE(first->Created());
+    EXPECT_FALSE(second->Created());
+
+    std::atomic<uint32>* firstFlag = first->Find("test_once");
+    std::atomic<uint32>* secondFlag = second->Find("test_once");
+    ASSERT_NE(firstFlag, nullptr);
+    ASSERT_NE(secondFlag, nullptr);
+
+    firstFlag->store(1);
+    EXPECT_EQ(secondFlag->load(), 1u);
+    EXPECT_EQ(second->Find(std::string(OnceFlagSegment::MAX_KEY_LENGTH + 1, 'k')), nullptr);
+
+    // Every mapping holds a session until it is closed.
+    std::vector<std::unique_ptr<OnceFlagSegment>> sessions;
+    while (std::unique_ptr<OnceFlagSegment> segment = OnceFlagSegment::Open(name))
+        sessions.push_back(std::move(segment));
+
+    EXPECT_EQ(sessions.size(), OnceFlagSegment::MAX_SESSIONS - 2);
+
+    sessions.pop_back();
+    EXPECT_NE(OnceFlagSegment::Open(name), nullptr);
+
+    shm_unlink(name.c_str());
+}
+
+TEST(SimulatorTest, MatchesTheChanceOfARepeatableRule)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 25.0));
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+
+    SimulatorOptions options = MakeSimulatorOptions(200000);
+    options.killsPerWeek[BOSS_ENTRY] = 4;
+
+    std::vector<uint32> const killsPerWeek = GetKillsPerWeek(*ruleSet, options);
+    ASSERT_EQ(killsPerWeek[0], 4u);
+
+    // Four kills at 25% drop one item a week on average; the standard error is about 0.002.
+    RuleSimulation const simulation = SimulateRule(ruleSet->rules[0], killsPerWeek[0], options);
+    EXPECT_EQ(simulation.kind, SimulationKind::Weekly);
+    EXPECT_EQ(simulation.kills, 800000u);
+    EXPECT_NEAR(simulation.samples.mean, 1.0, 0.02);
+    EXPECT_LE(simulation.samples.max, 4u);
+}
+
+TEST(SimulatorTest, MatchesTheChanceOfAOnceRule)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeOnceRule(1, BOSS_ENTRY, ITEM_ENTRY, 2.0));
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+
+    // Kills until the first drop are geometric with mean 1 / 2% = 50; the standard error is about 0.16.
+    RuleSimulation const simulation = SimulateRule(ruleSet->rules[0], 1, MakeSimulatorOptions(100000));
+    EXPECT_EQ(simulation.kind, SimulationKind::Once);
+    EXPECT_NEAR(simulation.samples.mean, 50.0, 1.0);
+    EXPECT_NEAR(simulation.firstWeekPct, 2.0, 0.3);
+    EXPECT_EQ(simulation.censored, 0u);
+}
+
+TEST(SimulatorTest, NeverNeedsMoreKillsThanThePityGuarantee)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeOnceRule(1, BOSS_ENTRY, ITEM_ENTRY, 1.0));
+    rules.back().pityGuarantee = 10;
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+
+    // Nine misses at 1% leave 0.99^9 of the trials for the guaranteed tenth kill.
+    RuleSimulation const simulation = SimulateRule(ruleSet->rules[0], 1, MakeSimulatorOptions(100000));
+    EXPECT_EQ(simulation.samples.max, 10u);
+    EXPECT_NEAR(simulation.samples.mean, (1.0 - std::pow(0.99, 10)) / 0.01, 0.05);
+}
+
+TEST(SimulatorTest, SkipsRulesThatCannotDrop)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 0.0));
+    rules.push_back(MakeRule(2, BOSS_ENTRY, OTHER_ITEM_ENTRY, 50.0));
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+    SimulatorOptions const options = MakeSimulatorOptions(1000);
+
+    EXPECT_EQ(SimulateRule(ruleSet->rules[0], 1, options).kind, SimulationKind::NeverDrops);
+    EXPECT_EQ(SimulateRule(ruleSet->rules[1], 0, options).kind, SimulationKind::NoKills);
+}
+
+TEST(SimulatorTest, CapsWeeklyDropsAtTheQuota)
+{
+    std::vector<BossLootRule> rules;
+    rules.push_back(MakeRule(1, BOSS_ENTRY, ITEM_ENTRY, 100.0));
+    rules.back().quota = 3;
+    ASSERT_TRUE(rules.back().quotaRefill.Parse("0 0 * * 1"));
+
+    std::shared_ptr<RuleSet const> ruleSet = CompileRuleSet(true, std::move(rules), std::time(nullptr));
+
+    // The simulated weeks start on a Monday at midnight, so every week begins with a refill.
+    SimulatorOptions options = MakeSimulatorOptions(1000);
+    options.start = MakeLocalTime(2026, 1, 5, 0, 0);
+
+    RuleSimulation const simulation = SimulateRule(ruleSet->rules[0], 10, options);
+    EXPECT_EQ(simulation.kind, SimulationKind::Weekly);
+    EXPECT_DOUBLE_EQ(simulation.samples.mean, 3.0);
+    EXPECT_EQ(simulation.samples.max, 3u);
+    EXPECT_EQ(simulation.blockedQuota, 7000u);
+}
@@ -0,0 +1,22 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's Common.h. The core reaches it through most headers, so Define.h pulls it in.
+
+#ifndef BOSSLOOT_STUB_COMMON_H
+#define BOSSLOOT_STUB_COMMON_H
+
+enum TimeConstants
+{
+    MINUTE          = 60,
+    HOUR            = MINUTE * 60,
+    DAY             = HOUR * 24,
+    WEEK            = DAY * 7,
+    MONTH           = DAY * 30,
+    YEAR            = MONTH * 12,
+    IN_MILLISECONDS = 1000
+};
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's CompilerDefs.h.
+
+#ifndef BOSSLOOT_STUB_COMPILERDEFS_H
+#define BOSSLOOT_STUB_COMPILERDEFS_H
+
+#define AC_PLATFORM_WINDOWS 0
+#define AC_PLATFORM_UNIX    1
+#define AC_PLATFORM_APPLE   2
+
+#if defined(_WIN64) || defined(_WIN32)
+#  define AC_PLATFORM AC_PLATFORM_WINDOWS
+#elif defined(__APPLE__)
+#  define AC_PLATFORM AC_PLATFORM_APPLE
+#else
+#  define AC_PLATFORM AC_PLATFORM_UNIX
+#endif
+
+#endif
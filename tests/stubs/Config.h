@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's Config.h. Options are set by the tests with SetOption or read from a
+// .conf file with LoadFile; anything unset reads as its default, as a missing key does in the core.
+
+#ifndef BOSSLOOT_STUB_CONFIG_H
+#define BOSSLOOT_STUB_CONFIG_H
+
+#include "Define.h"
+#include "StringConvert.h"
+
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+class ConfigMgr
+{
+public:
+    static ConfigMgr* instance()
+    {
+        static ConfigMgr instance;
+        return &instance;
+    }
+
+    template <class T>
+    T GetOption(std::string const& name, T const& def, bool /*showLogs*/ = true) const
+    {
+        auto itr = _options.find(name);
+        if (itr == _options.end())
+            return def;
+
+        std::string const& value = itr->second;
+        if constexpr (std::is_same_v<T, std::string>)
+            return value;
+        else if constexpr (std::is_same_v<T, bool>)
+            return value == "1" || value == "true";
+        else if constexpr (std::is_floating_point_v<T>)
+            return static_cast<T>(std::stod(value));
+        else
+            return Acore::StringTo<T>(value).value_or(def);
+    }
+
+    // Stub only.
+    void SetOption(std::string const& name, std::string value) { _options[name] = std::move(value); }
+    void Clear() { _options.clear(); }
+
+    // Stub only. Reads "Key = Value" lines as the core does: '#' starts a comment line, [section]
+    // headers are skipped and a value in double quotes loses them. Returns false if the file
+    // cannot be opened.
+    bool LoadFile(std::string const& file)
+    {
+        std::ifstream in(file);
+        if (!in)
+            return false;
+
+        auto trim = [](std::string const& text)
+        {
+            std::size_t const first = text.find_first_not_of(" \t\r");
+            return first == std::string::npos ? std::string() : text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+        };
+
+        std::string line;
+        while (std::getline(in, line))
+        {
+            line = trim(line);
+            if (line.empty() || line[0] == '#' || line[0] == '[')
+                continue;
+
+            std::size_t const equals = line.find('=');
+            if (equals == std::string::npos)
+                continue;
+
+            std::string value = trim(line.substr(equals + 1));
+            if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+                value = value.substr(1, value.size() - 2);
+
+            _options[trim(line.substr(0, equals))] = std::move(value);
+        }
+
+        return true;
+    }
+
+private:
+    std::unordered_map<std::string, std::string> _options;
+};
+
+#define sConfigMgr ConfigMgr::instance()
+
+#endif
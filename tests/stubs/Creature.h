@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's Creature.h: a corpse with an identity, a map and its loot.
+
+#ifndef BOSSLOOT_STUB_CREATURE_H
+#define BOSSLOOT_STUB_CREATURE_H
+
+#include "DBCEnums.h"
+#include "Define.h"
+#include "LootMgr.h"
+#include "ObjectGuid.h"
+
+#include <string>
+
+class Map
+{
+public:
+    explicit Map(Difficulty difficulty = REGULAR_DIFFICULTY) : _difficulty(difficulty) { }
+
+    Difficulty GetDifficulty() const { return _difficulty; }
+
+private:
+    Difficulty _difficulty;
+};
+
+class Creature
+{
+public:
+    Creature(uint32 entry, uint32 counter, uint32 mapId = 0, Difficulty difficulty = REGULAR_DIFFICULTY)
+        : _guid(HighGuid::Unit, entry, counter), _mapId(mapId), _map(difficulty) { }
+
+    ObjectGuid GetGUID() const { return _guid; }
+    uint32 GetEntry() const { return _guid.GetEntry(); }
+    std::string const& GetName() const { return _name; }
+    uint32 GetMapId() const { return _mapId; }
+    uint32 GetInstanceId() const { return 0; }
+    Map* GetMap() { return &_map; }
+    Map const* GetMap() const { return &_map; }
+
+    Loot loot;
+
+private:
+    ObjectGuid _guid;
+    std::string _name = "Creature";
+    uint32 _mapId;
+    Map _map;
+};
+
+#endif
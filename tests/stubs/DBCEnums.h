@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's DBCEnums.h.
+
+#ifndef BOSSLOOT_STUB_DBCENUMS_H
+#define BOSSLOOT_STUB_DBCENUMS_H
+
+enum Difficulty : unsigned char
+{
+    REGULAR_DIFFICULTY           = 0,
+
+    DUNGEON_DIFFICULTY_NORMAL    = 0,
+    DUNGEON_DIFFICULTY_HEROIC    = 1,
+    DUNGEON_DIFFICULTY_EPIC      = 2,
+
+    RAID_DIFFICULTY_10MAN_NORMAL = 0,
+    RAID_DIFFICULTY_25MAN_NORMAL = 1,
+    RAID_DIFFICULTY_10MAN_HEROIC = 2,
+    RAID_DIFFICULTY_25MAN_HEROIC = 3
+};
+
+#define MAX_DUNGEON_DIFFICULTY 3
+#define MAX_RAID_DIFFICULTY    4
+#define MAX_DIFFICULTY         4
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's Log.h. Every logger is filtered out: as in the core, the arguments are
+// only evaluated once the filter passes, so here they are type checked but never evaluated.
+
+#ifndef BOSSLOOT_STUB_LOG_H
+#define BOSSLOOT_STUB_LOG_H
+
+#include "StringFormat.h"
+
+#define BOSSLOOT_STUB_LOG(filterType__, ...) \
+    do { if (false) { (void)(filterType__); (void)Acore::StringFormat(__VA_ARGS__); } } while (0)
+
+#define LOG_FATAL(filterType__, ...) BOSSLOOT_STUB_LOG(filterType__, __VA_ARGS__)
+#define LOG_ERROR(filterType__, ...) BOSSLOOT_STUB_LOG(filterType__, __VA_ARGS__)
+#define LOG_WARN(filterType__, ...)  BOSSLOOT_STUB_LOG(filterType__, __VA_ARGS__)
+#define LOG_INFO(filterType__, ...)  BOSSLOOT_STUB_LOG(filterType__, __VA_ARGS__)
+#define LOG_DEBUG(filterType__, ...) BOSSLOOT_STUB_LOG(filterType__, __VA_ARGS__)
+#define LOG_TRACE(filterType__, ...) BOSSLOOT_STUB_LOG(filterType__, __VA_ARGS__)
+
+#endif
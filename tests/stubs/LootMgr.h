@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's LootMgr.h: the loot item and corpse loot fields the module touches.
+// Loot records the slots it was told to remove, so tests can check the open window is updated.
+
+#ifndef BOSSLOOT_STUB_LOOTMGR_H
+#define BOSSLOOT_STUB_LOOTMGR_H
+
+#include "Define.h"
+
+#include <vector>
+
+enum LootModes
+{
+    LOOT_MODE_DEFAULT = 0x1
+};
+
+struct LootStoreItem
+{
+    uint32 itemid;
+    uint32 reference;
+    float chance;
+    bool needs_quest;
+    uint16 lootmode;
+    uint8 groupid;
+    int32 mincount;
+    int32 maxcount;
+
+    LootStoreItem(uint32 _itemid, uint32 _reference, float _chance, bool _needs_quest, uint16 _lootmode, uint8 _groupid, int32 _mincount, int32 _maxcount)
+        : itemid(_itemid), reference(_reference), chance(_chance), needs_quest(_needs_quest), lootmode(_lootmode), groupid(_groupid),
+          mincount(_mincount), maxcount(_maxcount) { }
+};
+
+struct LootItem
+{
+    uint32 itemid = 0;
+    uint8 count = 1;
+    bool is_looted = false;
+};
+
+struct Loot
+{
+    std::vector<LootItem> items;
+    std::vector<LootItem> quest_items;
+    uint32 unlootedCount = 0;
+
+    void AddItem(LootStoreItem const& item)
+    {
+        LootItem lootItem;
+        lootItem.itemid = item.itemid;
+        lootItem.count = static_cast<uint8>(item.mincount);
+        (item.needs_quest ? quest_items : items).push_back(lootItem);
+        ++unlootedCount;
+    }
+
+    void NotifyItemRemoved(uint8 lootIndex) { removedItems.push_back(lootIndex); }
+    void NotifyQuestItemRemoved(uint8 questIndex) { removedQuestItems.push_back(questIndex); }
+
+    // Stub only.
+    std::vector<uint8> removedItems;
+    std::vector<uint8> removedQuestItems;
+};
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's ObjectGuid.h, with the core's bit layout for map objects:
+// high guid in bits 48..63, entry in bits 24..47, counter in bits 0..23.
+
+#ifndef BOSSLOOT_STUB_OBJECTGUID_H
+#define BOSSLOOT_STUB_OBJECTGUID_H
+
+#include "Define.h"
+#include "StringFormat.h"
+
+#include <functional>
+#include <string>
+
+enum class HighGuid : uint32
+{
+    Item       = 0x4000,
+    Player     = 0x0000,
+    GameObject = 0xF110,
+    Unit       = 0xF130
+};
+
+class ObjectGuid
+{
+public:
+    static ObjectGuid const Empty;
+
+    ObjectGuid() = default;
+    explicit ObjectGuid(uint64 guid) : _guid(guid) { }
+    ObjectGuid(HighGuid hi, uint32 entry, uint32 counter)
+        : _guid(counter ? uint64(counter) | (uint64(entry) << 24) | (uint64(hi) << 48) : 0) { }
+
+    uint64 GetRawValue() const { return _guid; }
+    HighGuid GetHigh() const { return HighGuid((_guid >> 48) & 0x0000FFFF); }
+    uint32 GetEntry() const { return uint32((_guid >> 24) & ENTRY_MASK); }
+    uint32 GetCounter() const { return uint32(_guid & COUNTER_MASK); }
+
+    bool IsEmpty() const { return _guid == 0; }
+    bool IsCreature() const { return GetHigh() == HighGuid::Unit; }
+    bool IsGameObject() const { return GetHigh() == HighGuid::GameObject; }
+
+    std::string ToString() const { return Acore::StringFormat("GUID Full: 0x{:016X}", _guid); }
+
+    bool operator==(ObjectGuid const& guid) const { return _guid == guid._guid; }
+    bool operator!=(ObjectGuid const& guid) const { return _guid != guid._guid; }
+    bool operator<(ObjectGuid const& guid) const { return _guid < guid._guid; }
+
+private:
+    static constexpr uint64 ENTRY_MASK = 0x0000000000FFFFFFULL;
+    static constexpr uint64 COUNTER_MASK = 0x0000000000FFFFFFULL;
+
+    uint64 _guid = 0;
+};
+
+inline ObjectGuid const ObjectGuid::Empty = ObjectGuid();
+
+namespace std
+{
+    template <>
+    struct hash<ObjectGuid>
+    {
+        std::size_t operator()(ObjectGuid const& key) const { return std::hash<uint64>()(key.GetRawValue()); }
+    };
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's ObjectMgr.h: creature and item templates the tests register.
+
+#ifndef BOSSLOOT_STUB_OBJECTMGR_H
+#define BOSSLOOT_STUB_OBJECTMGR_H
+
+#include "Define.h"
+
+#include <string>
+#include <unordered_map>
+
+struct CreatureTemplate
+{
+    uint32 Entry = 0;
+    std::string Name;
+    uint32 rank = 0;
+    uint32 family = 0;
+};
+
+typedef std::unordered_map<uint32, CreatureTemplate> CreatureTemplateContainer;
+
+struct ItemTemplate
+{
+    uint32 ItemId = 0;
+    std::string Name1;
+};
+
+class ObjectMgr
+{
+public:
+    static ObjectMgr* instance()
+    {
+        static ObjectMgr instance;
+        return &instance;
+    }
+
+    CreatureTemplateContainer const* GetCreatureTemplates() const { return &_creatureTemplateStore; }
+
+    CreatureTemplate const* GetCreatureTemplate(uint32 entry) const
+    {
+        auto itr = _creatureTemplateStore.find(entry);
+        return itr != _creatureTemplateStore.end() ? &itr->second : nullptr;
+    }
+
+    ItemTemplate const* GetItemTemplate(uint32 entry) const
+    {
+        auto itr = _itemTemplateStore.find(entry);
+        return itr != _itemTemplateStore.end() ? &itr->second : nullptr;
+    }
+
+    // Stub only.
+    void AddCreatureTemplate(CreatureTemplate creature) { _creatureTemplateStore[creature.Entry] = std::move(creature); }
+    void AddItemTemplate(ItemTemplate item) { _itemTemplateStore[item.ItemId] = std::move(item); }
+    void Clear() { _creatureTemplateStore.clear(); _itemTemplateStore.clear(); }
+
+private:
+    CreatureTemplateContainer _creatureTemplateStore;
+    std::unordered_map<uint32, ItemTemplate> _itemTemplateStore;
+};
+
+#define sObjectMgr ObjectMgr::instance()
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's Optional.h.
+
+#ifndef BOSSLOOT_STUB_OPTIONAL_H
+#define BOSSLOOT_STUB_OPTIONAL_H
+
+#include <optional>
+
+template <class T>
+using Optional = std::optional<T>;
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's Player.h.
+
+#ifndef BOSSLOOT_STUB_PLAYER_H
+#define BOSSLOOT_STUB_PLAYER_H
+
+#include "Define.h"
+#include "ObjectGuid.h"
+
+#include <string>
+
+class Player
+{
+public:
+    Player(uint32 counter, std::string name) : _guid(HighGuid::Player, 0, counter), _name(std::move(name)) { }
+
+    ObjectGuid GetGUID() const { return _guid; }
+    std::string const& GetName() const { return _name; }
+
+private:
+    ObjectGuid _guid;
+    std::string _name;
+};
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's Random.h: one generator per thread, as in the core.
+
+#ifndef BOSSLOOT_STUB_RANDOM_H
+#define BOSSLOOT_STUB_RANDOM_H
+
+#include "Define.h"
+
+#include <random>
+
+inline std::mt19937& GetStubRandomEngine()
+{
+    thread_local std::mt19937 engine{ std::random_device{}() };
+    return engine;
+}
+
+// Returns a number in the range min .. max.
+inline uint32 urand(uint32 min, uint32 max)
+{
+    return std::uniform_int_distribution<uint32>(min, max)(GetStubRandomEngine());
+}
+
+inline uint32 rand32()
+{
+    return static_cast<uint32>(GetStubRandomEngine()());
+}
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's StringConvert.h, integers only.
+
+#ifndef BOSSLOOT_STUB_STRINGCONVERT_H
+#define BOSSLOOT_STUB_STRINGCONVERT_H
+
+#include "Optional.h"
+
+#include <charconv>
+#include <string_view>
+#include <type_traits>
+
+namespace Acore
+{
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    Optional<T> StringTo(std::string_view str, int base = 10)
+    {
+        T value{};
+        char const* end = str.data() + str.size();
+        auto [ptr, error] = std::from_chars(str.data(), end, value, base);
+        if (error != std::errc() || ptr != end)
+            return std::nullopt;
+
+        return value;
+    }
+}
+
+#endif
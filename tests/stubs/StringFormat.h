@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's StringFormat.h, on the same fmt library.
+
+#ifndef BOSSLOOT_STUB_STRINGFORMAT_H
+#define BOSSLOOT_STUB_STRINGFORMAT_H
+
+#include <fmt/format.h>
+
+#include <string>
+#include <utility>
+
+namespace Acore
+{
+    template <typename Format, typename... Args>
+    inline std::string StringFormat(Format&& fmt, Args&&... args)
+    {
+        return fmt::format(fmt::runtime(std::forward<Format>(fmt)), std::forward<Args>(args)...);
+    }
+}
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's Timer.h.
+
+#ifndef BOSSLOOT_STUB_TIMER_H
+#define BOSSLOOT_STUB_TIMER_H
+
+#include "Define.h"
+
+#include <ctime>
+
+namespace Acore::Time
+{
+    inline std::tm TimeBreakdown(time_t time = 0)
+    {
+        if (!time)
+            time = std::time(nullptr);
+
+        std::tm timeLocal{};
+        localtime_r(&time, &timeLocal);
+        return timeLocal;
+    }
+}
+
+#endif
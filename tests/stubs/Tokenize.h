@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>
+ * Released under GNU AGPL v3: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+// Test stub of the core's Tokenize.h.
+
+#ifndef BOSSLOOT_STUB_TOKENIZE_H
+#define BOSSLOOT_STUB_TOKENIZE_H
+
+#include <string_view>
+#include <vector>
+
+namespace Acore
+{
+    inline std::vector<std::string_view> Tokenize(std::string_view str, char sep, bool keepEmpty)
+    {
+        std::vector<std::string_view> tokens;
+
+        std::size_t start = 0;
+        for (std::size_t end = str.find(sep); end != std::string_view::npos; end = str.find(sep, start))
+        {
+            if (keepEmpty || start < end)
+                tokens.push_back(str.substr(start, end - start));
+
+            start = end + 1;
+        }
+
+        if (keepEmpty || start < str.length())
+            tokens.push_back(str.substr(start));
+
+        return tokens;
+    }
+}
+
+#endif